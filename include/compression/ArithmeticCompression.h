@@ -4,6 +4,7 @@
 #include <vector>
 #include "../config/types.h"
 #include "../utilities/bitstream.h"
+#include "../utilities/ByteHistogram.h"
 
 namespace cch::compression
 {
@@ -28,8 +29,7 @@ namespace cch::compression
         void buildModel(std::span<cch::byte> data);
         void initializeArithmeticEncoder();
         void flushEncoder();
-        std::array<unsigned long, 256> countBytes(std::span<cch::byte> data);
-        std::array<cch::byte, 256> scaleCounts(std::array<unsigned long, 256> const& counts);
+        std::array<cch::byte, 256> scaleCounts(ByteHistogram::Counts const& counts);
         void buildTotals(std::array<cch::byte, 256> const& scaled);
         Symbol intToSymbol(int num);
         void getSymbolScale(Symbol &s);
@@ -1,10 +1,12 @@
 #pragma once
 #include <vector>
 #include <span>
-#include <unordered_map>
-#include <string>
 #include <future>
+#include <cstdint>
+#include <array>
+#include <functional>
 #include "../config/types.h"
+#include "../utilities/ByteHistogram.h"
 
 namespace cch
 {
@@ -13,13 +15,38 @@ namespace cch
         class HuffmanCompression
         {
         public:
+            struct Options
+            {
+                /// Bytes per independently decodable block, 0 to compress the data as a single stream
+                /// Blocks of about 1 MiB let large inputs be compressed and decompressed on all cores
+                size_t blockSize = 0;
+                /// Threads compressing or decompressing the blocks (counting the bytes of a single stream), 0 to use
+                /// all hardware threads
+                size_t threadCount = 0;
+                /// Split every block (or the whole data) into four streams sharing one code table
+                /// A single thread decodes the four streams together, about twice as fast as one stream
+                bool interleaved = false;
+                /// Code every byte with the table of its previous byte (order-1 context), contexts seen rarely share
+                /// tables. Better ratio on text and logs, takes precedence over interleaved
+                bool order1 = false;
+            };
+
+            static size_t const inline MIN_BLOCK_SIZE = 4 * 1024;
+            static size_t const inline MAX_BLOCK_SIZE = 1024 * 1024 * 1024;
+
+            HuffmanCompression() = default;
+
+            /// \param options block size and threads
+            /// \throw std::invalid_argument if the block size is not 0 or in [MIN_BLOCK_SIZE; MAX_BLOCK_SIZE]
+            explicit HuffmanCompression(Options const &options);
+
             /// Compress the data
             /// \param data data to compress
             /// \param launchPolicy launch policy (async, sync)
             /// \return {Compression binary information to perform decompression, compressed data}
             std::future<std::pair<std::vector<cch::byte>, std::vector<cch::byte>>> compress(std::span<cch::byte> data, std::launch launchPolicy);
 
-            /// Decompress the data
+            /// Decompress the data, the block format is recognized from the compression information
             /// \param data {Compression binary information, compressed data}
             /// \param launchPolicy launch policy (async, sync)
             /// \return decompressed data
@@ -33,63 +60,144 @@ namespace cch
             std::pair<std::vector<cch::byte>, std::vector<cch::byte>> compressData(std::span<cch::byte> data);
             std::vector<cch::byte> decompressData(std::pair<std::span<cch::byte>,std::span<cch::byte>> data);
 
-            /// Calcalate frequency of each byte in a given buffer
-            /// @param data buffer
-            /// @return returns hash table where a[byte] = percentageOfEntries
-            std::unordered_map<cch::byte, cch::byte> calculateCharFrequency(std::span<cch::byte> data);
+            /// Compress the data as a single stream with one code table
+            std::pair<std::vector<cch::byte>, std::vector<cch::byte>> compressStream(std::span<cch::byte> data);
+            std::vector<cch::byte> decompressStream(std::pair<std::span<cch::byte>,std::span<cch::byte>> data);
 
-            /// Huffman Three Node structure
-            /// Designed To be stored as an array
-            /// Nodes with indices [0; 255] are sym nodes (their index is equal to their value), the rest of the nodes are "immediate" nodes to generate the compression tree
-            struct TreeNode
-            {
-                TreeNode() = default;
-                TreeNode(unsigned int const weigth, int const left, int const right) : weigth(weigth), left(left), right(right) {}
+            /// Compress the data as four streams, each coding a quarter of it with the same code table
+            /// The compressed data starts with the data size and the sizes of the first three streams (u64 each)
+            std::pair<std::vector<cch::byte>, std::vector<cch::byte>> compressFourStreams(std::span<cch::byte> data);
+            std::vector<cch::byte> decompressFourStreams(std::pair<std::span<cch::byte>,std::span<cch::byte>> data);
+
+            /// Compress the data as a single stream coding every byte with the table of its previous byte
+            /// The information holds the data size, the context to table map and the code lengths of every table
+            std::pair<std::vector<cch::byte>, std::vector<cch::byte>> compressOrder1(std::span<cch::byte> data);
+            std::vector<cch::byte> decompressOrder1(std::pair<std::span<cch::byte>,std::span<cch::byte>> data);
+
+            /// Compress a block (or the whole data) as one or four streams or with order-1 tables, as set by the options
+            std::pair<std::vector<cch::byte>, std::vector<cch::byte>> compressBlock(std::span<cch::byte> data);
+            std::vector<cch::byte> decompressBlock(std::pair<std::span<cch::byte>,std::span<cch::byte>> data);
 
-                /// Weight
-                unsigned int weigth = 0;
-                int left = -1;
-                int right = -1;
+            /// Compress every block with its own code table, in parallel
+            /// The information holds the block offset index, the compressed data the blocks one after another
+            std::pair<std::vector<cch::byte>, std::vector<cch::byte>> compressBlocks(std::span<cch::byte> data);
+            std::vector<cch::byte> decompressBlocks(std::pair<std::span<cch::byte>,std::span<cch::byte>> data);
+
+            /// Runs task(0), ..., task(count - 1) on the worker threads
+            /// \param count number of tasks
+            /// \param task task to run
+            void runParallel(size_t count, std::function<void(size_t)> const &task) const;
+
+            /// \return threads counting the bytes of a stream
+            size_t histogramThreads() const noexcept;
+
+            /// Number of bits of a code, 0 for unused bytes
+            using CodeLengths = std::array<std::uint8_t, 256>;
+
+            /// Canonical code of a byte, written from the most significant of its length bits down
+            struct Code
+            {
+                std::uint16_t bits = 0;
+                std::uint8_t length = 0;
             };
 
-            /// Builds the Huffman compression tree
-            /// \param nodes vector of byte nodes [0, 255]
-            /// \return an index of the tree root
-            short buildTree(std::vector<TreeNode> &nodes);
-
-            /// Creates and initializes the Huffman tree's nodes by their frequencies
-            /// \param frequencyTable Frequency of each byte
-            /// \return vector of nodes [0, 255]
-            std::vector<TreeNode> initializeNodes(std::unordered_map<cch::byte, cch::byte> const &frequencyTable);
-
-            /// Converts tree into a hash table to speed-up the lookup process
-            /// \param codeTable Resulting code table
-            /// \param nodes Huffman tree in array form
-            /// \param nodeIdx index of a root node
-            /// \param code Starting prefix
-            void generateCodeTable(std::unordered_map<cch::byte, std::string> &codeTable, std::vector<TreeNode> const& nodes, short nodeIdx, std::string code = "");
-
-            /// Generate ranges of used bytes (bytes that have non-zero frequency)
-            /// \param frequencyTable
+            /// Computes the optimal code lengths not exceeding MAX_CODE_LENGTH (package-merge)
+            /// \param frequencies number of occurrences of each byte
+            /// \return code length of each byte, a single used byte gets a one bit code
+            CodeLengths buildCodeLengths(ByteHistogram::Counts const &frequencies);
+
+            /// Assigns the canonical codes: shorter codes first, bytes of the same length in increasing order
+            /// \param lengths code lengths, must satisfy the Kraft inequality
+            /// \return code of each byte
+            std::array<Code, 256> buildCanonicalCodes(CodeLengths const &lengths);
+
+            /// Generate ranges of used bytes (bytes that have a non-zero code length)
+            /// \param lengths code lengths
             /// \return Vector of ranges of used bytes (startOfRange, endOfRange)
-            std::vector<std::pair<cch::byte, cch::byte>> generateCodeRanges(std::unordered_map<cch::byte, cch::byte> const &frequencyTable);
-
-            /// Serialize byte frequencies, this data is being used for decompression
-            /// \param rangesOfUsedBytes ranges of used bytes
-            /// \param frequencyTable
-            /// \return binary representation of used bytes and their frequencies
-            std::vector<cch::byte> serializeBytesFrequencies(std::vector<std::pair<cch::byte, cch::byte>> const &rangesOfUsedBytes, std::unordered_map<cch::byte, cch::byte> const &frequencyTable);
-
-            /// Deserialize frequency table
-            /// \param data serialized frequency table
-            /// \return frequency table
-            std::unordered_map<cch::byte, cch::byte> restoreFrequencyTable(std::span<cch::byte> data);
-
-            /// Helper function to invert code table used for compression (it has the following format {byte, compressedCode})
-            /// to a table can be used for decompression ({compressedCode, originalByte})
-            /// \param codeTable code table used for compression
-            /// \return code table can be used for decompression
-            std::unordered_map<size_t, cch::byte> inverseCodeTable(std::unordered_map<cch::byte, std::string> codeTable);
+            std::vector<std::pair<cch::byte, cch::byte>> generateCodeRanges(CodeLengths const &lengths);
+
+            /// Serialize the code lengths, this data is being used for decompression
+            /// Every range of used bytes is stored as (start, end) followed by the lengths packed two per byte,
+            /// the canonical codes are rebuilt from the lengths alone
+            /// \param lengths code lengths
+            /// \param serializedLengths receives the binary representation of used bytes and their code lengths
+            void serializeCodeLengths(CodeLengths const &lengths, std::vector<cch::byte> &serializedLengths);
+
+            /// Deserialize the code lengths
+            /// \param data serialized code lengths
+            /// \return code lengths
+            /// \throw std::runtime_error if the data is corrupted or the lengths do not form a complete prefix code
+            CodeLengths restoreCodeLengths(std::span<cch::byte const> data);
+
+            /// Code tables of the order-1 contexts
+            struct ContextMap
+            {
+                /// Table of every previous byte
+                std::array<std::uint8_t, 256> tableOf{};
+                size_t tableCount = 0;
+            };
+
+            /// Groups the contexts into tables: a context whose own table saves more than the table costs keeps it,
+            /// the others are moved to the table that codes them in the fewest bits
+            /// \param contextFrequencies frequencies of the bytes following every byte
+            /// \return table of every context
+            ContextMap clusterContexts(std::vector<ByteHistogram::Counts> const &contextFrequencies);
+
+            /// Entry of the single symbol decoding table
+            struct SymbolEntry
+            {
+                cch::byte symbol = 0;
+                std::uint8_t length = 0;
+            };
+
+            /// Builds the single symbol decoding table, indexed by the next DECODE_TABLE_BITS bits of the compressed data
+            /// A single used byte has the one bit code "0", the indices starting with 1 decode the same byte
+            /// \param lengths code lengths
+            /// \param table receives 2^DECODE_TABLE_BITS entries
+            void buildSymbolTable(CodeLengths const &lengths, std::span<SymbolEntry> table);
+
+            /// Entry of the decoding table, indexed by the next DECODE_TABLE_BITS bits of the compressed data
+            struct DecodeEntry
+            {
+                /// Symbols whose codes fit in the index, in the order of the data
+                std::array<cch::byte, 4> symbols{};
+                std::uint8_t count = 0;
+                /// Bits taken by all the symbols of the entry
+                std::uint8_t length = 0;
+                /// Bits taken by the first symbol
+                std::uint8_t firstLength = 0;
+            };
+
+            /// Builds the decoding table, every entry holds as many whole codes as fit in its index
+            /// \param lengths code lengths of a complete prefix code
+            /// \return table of 2^DECODE_TABLE_BITS entries
+            std::vector<DecodeEntry> buildDecodeTable(CodeLengths const &lengths);
+
+            /// Longest code, the limit costs a fraction of a percent of the ratio and lets every code fit in one
+            /// table lookup
+            static size_t const inline MAX_CODE_LENGTH = 12;
+            /// Bits of the compressed data decoded by one table lookup
+            static size_t const inline DECODE_TABLE_BITS = MAX_CODE_LENGTH;
+            /// Most symbols stored in a table entry
+            static size_t const inline MAX_ENTRY_SYMBOLS = 4;
+
+            /// First byte of the information of the block format, a single stream stores the bits used in its last
+            /// byte (0 to 8) there
+            static cch::byte const inline BLOCK_FORMAT = 0x80;
+            /// First byte of the information of four streams, followed by the code lengths
+            static cch::byte const inline FOUR_STREAMS_FORMAT = 0x40;
+            static size_t const inline STREAM_COUNT = 4;
+            static size_t const inline FOUR_STREAMS_HEADER_SIZE = 32;
+            /// First byte of the information of order-1 tables
+            static cch::byte const inline ORDER1_FORMAT = 0x20;
+            /// Passes moving the rare contexts between the tables
+            static size_t const inline CLUSTER_PASSES = 2;
+            /// Block format information: format, data size (u64), block size (u32), then for every block the
+            /// size of its information (u32) and of its compressed data (u64), little endian
+            static size_t const inline BLOCK_HEADER_SIZE = 13;
+            static size_t const inline BLOCK_INDEX_ENTRY_SIZE = 12;
+
+            Options options;
         };
     }
 }
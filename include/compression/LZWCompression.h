@@ -4,6 +4,7 @@
 #include <span>
 #include <unordered_map>
 #include "../config/types.h"
+#include "../hash/Adler32.h"
 
 namespace cch
 {
@@ -54,9 +55,7 @@ namespace cch
             size_t currentHash = 0;
             size_t prevHash = 0;
 
-            std::uint32_t a = 1;
-            std::uint32_t b = 0;
-            static const inline uint32_t MOD_ADLER = 65521;
+            hash::Adler32 adler;
         };
     }
 }
\ No newline at end of file
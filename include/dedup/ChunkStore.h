@@ -0,0 +1,199 @@
+#pragma once
+#include <span>
+#include <array>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <fstream>
+#include <filesystem>
+#include <cstdint>
+#include "config/types.h"
+#include "hash/SHA256.h"
+#include "dedup/FastCDC.h"
+#include "utilities/MappedFile.h"
+
+namespace cch::dedup
+{
+    /// Chunk of a stored object
+    struct ChunkReference
+    {
+        hash::SHA256Hash digest;
+        std::uint32_t length = 0;
+    };
+
+    /// Everything needed to read an object back from the store: its chunks in order
+    struct ObjectRecipe
+    {
+        std::vector<ChunkReference> chunks;
+
+        /// \return size of the object in bytes
+        std::uint64_t size() const;
+    };
+
+    struct ChunkStoreStatistics
+    {
+        /// Bytes passed to put()
+        std::uint64_t logicalBytes = 0;
+        /// Chunks written to the packs
+        std::uint64_t newChunks = 0;
+        /// Chunks replaced by a reference to an already stored chunk
+        std::uint64_t dedupedChunks = 0;
+        /// Bytes appended to the packs, including the record headers
+        std::uint64_t writtenBytes = 0;
+        /// Distinct chunks in the store
+        std::uint64_t uniqueChunks = 0;
+    };
+
+    struct CompactionResult
+    {
+        std::uint64_t removedChunks = 0;
+        std::uint64_t reclaimedBytes = 0;
+        std::uint64_t rewrittenPacks = 0;
+    };
+
+    /// Content-addressed deduplicating chunk store
+    /// Objects are split by FastCDC and every distinct chunk is stored once, keyed by its SHA256.
+    /// New chunks are compressed and appended to pack files in the store directory, an in-memory index maps digests
+    /// to their records and is rebuilt from the packs when the store is opened.
+    /// put(), putFile(), read(), contains() and statistics() can be called from any number of threads,
+    /// compact() waits for the running calls to finish and blocks the new ones until it is done
+    class ChunkStore
+    {
+    public:
+        /// Codec of the stored chunks, a chunk that does not get smaller is stored raw
+        enum class Codec : std::uint8_t
+        {
+            None = 0,
+            RLE = 1,
+            /// Only read from existing packs, the LZSS codec does not reproduce compressible input
+            LZSS = 2,
+            Huffman = 3
+        };
+
+        struct Options
+        {
+            /// Codec of the new chunks, chunks written with other codecs stay readable
+            Codec codec = Codec::Huffman;
+            ChunkingParameters chunking;
+            /// A new pack is started once the current one reaches that size
+            std::uint64_t maxPackSize = 256 * 1024 * 1024;
+        };
+
+        /// Open the store, creating the directory if it does not exist
+        /// \param directory directory of the pack files
+        /// \param options codec, chunking and pack options
+        /// \throw std::invalid_argument if the chunking parameters are invalid or allow chunks of 4 GiB or more,
+        /// or the codec is LZSS
+        /// \throw std::runtime_error if the directory or a pack cannot be read
+        explicit ChunkStore(std::filesystem::path directory, Options const &options);
+        explicit ChunkStore(std::filesystem::path directory);
+
+        ChunkStore(ChunkStore const &) = delete;
+        ChunkStore &operator=(ChunkStore const &) = delete;
+
+        /// Store an object, only its chunks not present in the store are written
+        /// \param data object contents
+        /// \return recipe to read the object back, every chunk of it is in the store when put() returns
+        ObjectRecipe put(std::span<cch::byte const> data);
+
+        /// Store a file through a memory mapping
+        /// \param path file to store
+        /// \return recipe to read the file back
+        /// \throw std::runtime_error if the file cannot be mapped
+        ObjectRecipe putFile(std::filesystem::path const &path);
+
+        /// Reconstruct an object
+        /// \param recipe recipe returned by put()
+        /// \return object contents
+        /// \throw std::out_of_range if a chunk is not in the store
+        /// \throw std::runtime_error if a pack record is corrupted or a chunk does not match its digest
+        std::vector<cch::byte> read(ObjectRecipe const &recipe) const;
+
+        /// \param digest digest of a chunk
+        /// \return true if the chunk is in the store
+        bool contains(hash::SHA256Hash const &digest) const;
+
+        /// Drop the chunks not referenced by any live object and rewrite the packs that contained them
+        /// \param liveObjects recipes of all the objects to keep, chunks of other objects are deleted
+        /// \return what was removed
+        CompactionResult compact(std::span<ObjectRecipe const> liveObjects);
+
+        ChunkStoreStatistics statistics() const;
+
+    private:
+        /// Location of a chunk record in the packs
+        struct IndexEntry
+        {
+            std::uint32_t pack = 0;
+            std::uint64_t offset = 0;
+            std::uint32_t storedLength = 0;
+            /// The chunk is being written by another writer
+            bool pending = true;
+        };
+
+        struct DigestHash
+        {
+            size_t operator()(hash::SHA256Hash const &digest) const noexcept
+            {
+                // The digest is already uniformly distributed
+                return (static_cast<size_t>(digest.parts[0]) << 32) | digest.parts[1];
+            }
+        };
+
+        /// Compress a chunk with the configured codec, falling back to raw storage
+        std::pair<Codec, std::vector<cch::byte>> encode(std::span<cch::byte const> chunk) const;
+        static std::vector<cch::byte> decode(Codec codec, std::span<cch::byte const> payload, std::uint32_t rawLength);
+
+        /// Write a new chunk and publish it in the index
+        void writeChunk(hash::SHA256Hash const &digest, std::span<cch::byte const> chunk);
+        /// Append a complete record to the current pack, starting a new pack when needed
+        /// \return pack and offset of the record
+        std::pair<std::uint32_t, std::uint64_t> appendRecord(std::span<cch::byte const> record);
+        void startPack();
+
+        /// Mapping of a pack covering at least minSize bytes, remapped if the pack has grown since it was mapped
+        std::shared_ptr<MappedFile const> mapPack(std::uint32_t pack, std::uint64_t minSize) const;
+        /// Record of a chunk, checked against the index entry and its checksum
+        std::span<cch::byte const> recordAt(MappedFile const &file, hash::SHA256Hash const &digest, IndexEntry const &entry) const;
+
+        /// Add the records of an existing pack to the index
+        void scanPack(std::uint32_t pack);
+        std::filesystem::path packPath(std::uint32_t pack) const;
+
+        static std::array<char, 4> const PACK_MAGIC;
+        static cch::byte const inline PACK_VERSION = 1;
+        static size_t const inline PACK_HEADER_SIZE = 8;
+        /// Digest, codec, reserved, raw length, stored length, CRC32C of the payload
+        static size_t const inline RECORD_HEADER_SIZE = 32 + 4 + 4 + 4 + 4;
+
+        std::filesystem::path directory;
+        Options options;
+        FastCDC chunker;
+
+        /// put(), read(), contains() and statistics() hold it shared, compact() exclusively
+        mutable std::shared_mutex compactionMutex;
+
+        mutable std::mutex indexMutex;
+        std::condition_variable chunkWritten;
+        std::unordered_map<hash::SHA256Hash, IndexEntry, DigestHash> index;
+
+        /// Guards the pack being appended to
+        std::mutex packMutex;
+        std::ofstream packStream;
+        std::uint32_t currentPack = 0;
+        std::uint64_t currentPackSize = 0;
+        std::uint32_t nextPack = 0;
+
+        mutable std::mutex mappingMutex;
+        mutable std::unordered_map<std::uint32_t, std::shared_ptr<MappedFile const>> mappings;
+
+        std::atomic<std::uint64_t> logicalBytes = 0;
+        std::atomic<std::uint64_t> newChunks = 0;
+        std::atomic<std::uint64_t> dedupedChunks = 0;
+        std::atomic<std::uint64_t> writtenBytes = 0;
+    };
+}
@@ -0,0 +1,167 @@
+#pragma once
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <filesystem>
+#include <unordered_map>
+#include "config/types.h"
+
+namespace cch::dedup
+{
+    /// Strong digest confirming a weak checksum match
+    enum class StrongHash : std::uint8_t
+    {
+        MD5 = 1,
+        SHA256 = 2
+    };
+
+    /// Checksums of a block of the basis file
+    struct BlockSignature
+    {
+        /// Adler-32 of the block
+        std::uint32_t weak = 0;
+        /// Digest bytes in the standard order, only the first strongSize() bytes are used
+        std::array<cch::byte, 32> strong{};
+    };
+
+    /// Signature of the basis file, everything the sender needs to find the data the receiver already has
+    struct Signature
+    {
+        std::uint32_t blockSize = 0;
+        StrongHash strongHash = StrongHash::SHA256;
+        std::uint64_t fileSize = 0;
+        /// Blocks in the order of the file, the last one may be shorter
+        std::vector<BlockSignature> blocks;
+
+        /// \return size of the strong digests in bytes
+        size_t strongSize() const noexcept
+        {
+            return strongHash == StrongHash::MD5 ? 16 : 32;
+        }
+
+        /// Serialize the signature to send it to the other host
+        /// \param out stream to write to
+        /// \throw std::runtime_error if the stream fails
+        void write(std::ostream &out) const;
+
+        /// \param in stream written by write()
+        /// \return deserialized signature
+        /// \throw std::invalid_argument if the data is not a signature
+        static Signature read(std::istream &in);
+    };
+
+    /// rsync-style delta synchronization
+    /// The receiver sends the signature of its (old) basis file: a weak rolling checksum and a strong digest of every block.
+    /// The sender slides a window over its (new) file, looks the rolling checksum of every position up in the signature
+    /// and confirms a hit with the strong digest. Matched blocks are sent as references, everything else as literal data,
+    /// so only the changed regions cross the network wherever they moved to.
+    /// All three steps stream their inputs: memory is bounded by the signature and a few blocks, not by the file sizes
+    class DeltaSync
+    {
+    public:
+        /// Block size used when none is given
+        static size_t const inline DEFAULT_BLOCK_SIZE = 2048;
+
+        /// Block size for a basis file, grows with the square root of its size like in rsync
+        /// \param fileSize size of the basis file
+        /// \return block size balancing the signature size against the granularity of matches
+        static size_t blockSizeFor(std::uint64_t fileSize);
+
+        /// Compute the signature of the basis
+        /// \param basis basis contents, read once from the current position to the end
+        /// \param blockSize size of the signature blocks
+        /// \param strongHash strong digest of the blocks
+        /// \return signature of the basis
+        /// \throw std::invalid_argument if blockSize is 0 or does not fit 32 bits
+        static Signature signature(std::istream &basis, size_t blockSize = DEFAULT_BLOCK_SIZE, StrongHash strongHash = StrongHash::SHA256);
+
+        /// Compute the signature of a basis file with the block size chosen by blockSizeFor()
+        /// \param path basis file
+        /// \param strongHash strong digest of the blocks
+        /// \return signature of the file
+        /// \throw std::runtime_error if the file cannot be read
+        static Signature signatureFile(std::filesystem::path const &path, StrongHash strongHash = StrongHash::SHA256);
+
+        /// Encode the new contents as references to the basis blocks and literal data
+        /// \param signature signature of the basis
+        /// \param target new contents, read once from the current position to the end
+        /// \param delta receives the delta
+        /// \throw std::runtime_error if a stream fails
+        static void delta(Signature const &signature, std::istream &target, std::ostream &delta);
+
+        /// \param signature signature of the basis
+        /// \param targetPath new file
+        /// \param deltaPath delta file to create
+        /// \throw std::runtime_error if a file cannot be read or written
+        static void deltaFile(Signature const &signature, std::filesystem::path const &targetPath, std::filesystem::path const &deltaPath);
+
+        /// Rebuild the new contents from the basis and the delta
+        /// \param basis basis the signature was computed from, must be seekable
+        /// \param delta delta created by delta()
+        /// \param out receives the new contents
+        /// \throw std::runtime_error if the delta is corrupted, does not belong to the basis or the result does not match the digest of the new contents
+        static void patch(std::istream &basis, std::istream &delta, std::ostream &out);
+
+        /// \param basisPath basis file
+        /// \param deltaPath delta file
+        /// \param outPath file to create, must not be the basis file
+        /// \throw std::runtime_error if a file cannot be read or written or the delta does not apply
+        static void patchFile(std::filesystem::path const &basisPath, std::filesystem::path const &deltaPath, std::filesystem::path const &outPath);
+
+    private:
+        /// Delta instructions
+        enum class Instruction : cch::byte
+        {
+            /// SHA256 of the new contents, ends the delta
+            End = 0,
+            /// Block index (8 bytes) and block count (4 bytes) of a run of consecutive basis blocks
+            Copy = 1,
+            /// Length (4 bytes) followed by the data
+            Literal = 2
+        };
+
+        /// Blocks of a signature by their weak checksum
+        class BlockIndex
+        {
+        public:
+            explicit BlockIndex(Signature const &signature);
+
+            /// Find a basis block with the contents of the window
+            /// \param weak weak checksum of the window
+            /// \param window window contents
+            /// \param preferred block to return if it matches, the one following the previous match
+            /// \return index of a matching block or -1
+            std::int64_t find(std::uint32_t weak, std::span<cch::byte const> window, std::uint64_t preferred) const;
+
+        private:
+            /// Bit of a weak checksum in the filter
+            static std::uint32_t filterBit(std::uint32_t weak) noexcept
+            {
+                return (weak * 0x9E3779B1) >> (32 - FILTER_BITS);
+            }
+
+            static size_t const inline FILTER_BITS = 20;
+
+            Signature const &signature;
+            /// Weak checksums of the blocks hashed to single bits, rejects most positions without a hash table lookup
+            std::vector<std::uint64_t> filter;
+            /// First block of every weak checksum, the rest are chained through nextBlock
+            std::unordered_map<std::uint32_t, std::uint32_t> firstBlock;
+            std::vector<std::uint32_t> nextBlock;
+        };
+
+        static std::array<cch::byte, 32> strongDigest(StrongHash strongHash, std::span<cch::byte const> data);
+
+        /// Limits of blockSizeFor()
+        static size_t const inline MIN_BLOCK_SIZE = 700;
+        static size_t const inline MAX_BLOCK_SIZE = 128 * 1024;
+        /// Blocks whose strong digests are computed together in SIMD lanes
+        static size_t const inline SIGNATURE_BATCH = 64;
+        /// Literal runs are flushed once they reach that size, it bounds the buffer of the delta
+        static size_t const inline MAX_LITERAL = 1024 * 1024;
+        static std::uint32_t const inline NO_BLOCK = 0xFFFFFFFF;
+    };
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <span>
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include "config/types.h"
+#include "hash/SHA256.h"
+
+namespace cch::dedup
+{
+    /// Chunk of the data found by the chunker
+    struct ChunkRecord
+    {
+        /// Position of the chunk in the data
+        std::uint64_t offset = 0;
+        size_t length = 0;
+        /// SHA256 of the chunk contents, identifies the chunk for deduplication
+        hash::SHA256Hash digest;
+    };
+
+    /// Chunk size limits, the boundaries of a data depend on them so they have to stay the same for the data to dedupe
+    struct ChunkingParameters
+    {
+        /// No boundary is placed closer than that to the previous one, except at the end of the data
+        size_t minSize = 2 * 1024;
+        /// Expected chunk size
+        size_t averageSize = 8 * 1024;
+        /// A boundary is forced after that many bytes
+        size_t maxSize = 64 * 1024;
+    };
+
+    /// Content-defined chunking (FastCDC)
+    /// Boundaries are placed where a Gear rolling hash of the last bytes matches a mask, so they move together with the
+    /// contents: an inserted or removed byte only changes the chunks around it and the rest of the data still dedupes.
+    /// Normalized chunking uses a stricter mask below the average size and a looser one above it,
+    /// which keeps the chunk sizes close to the average
+    class FastCDC
+    {
+    public:
+        /// Receives the chunks in the order of the data
+        using ChunkSink = std::function<void(ChunkRecord const &)>;
+
+        /// \param parameters chunk size limits
+        /// \throw std::invalid_argument unless 64 <= minSize < averageSize < maxSize
+        explicit FastCDC(ChunkingParameters const &parameters = {});
+
+        /// Find the end of the chunk starting at the beginning of the data
+        /// \param data remaining data
+        /// \return length of the chunk, the whole data if it is shorter than the minimal chunk
+        size_t nextBoundary(std::span<cch::byte const> data) const;
+
+        /// Split the data into chunks and fingerprint them in the same pass
+        /// Chunks are fingerprinted in batches while they are still in the cache, several at once in SIMD lanes
+        /// \param data data to chunk
+        /// \param sink receives every chunk
+        /// \param baseOffset offset added to the chunk offsets, e.g. the position of the data in a larger stream
+        void chunk(std::span<cch::byte const> data, ChunkSink const &sink, std::uint64_t baseOffset = 0) const;
+
+        /// \param data data to chunk
+        /// \return chunks of the data
+        std::vector<ChunkRecord> chunk(std::span<cch::byte const> data) const;
+
+        /// Chunk a file through a memory mapping, without reading it into memory first
+        /// \param path file to chunk
+        /// \param sink receives every chunk
+        /// \throw std::runtime_error if the file cannot be mapped
+        void chunkFile(std::filesystem::path const &path, ChunkSink const &sink) const;
+
+        /// \param path file to chunk
+        /// \return chunks of the file
+        /// \throw std::runtime_error if the file cannot be mapped
+        std::vector<ChunkRecord> chunkFile(std::filesystem::path const &path) const;
+
+        ChunkingParameters const &parameters() const noexcept
+        {
+            return params;
+        }
+
+    private:
+        /// Mask with the given number of bits spread over the upper part of the hash,
+        /// the top bit is kept clear so the mask can be shifted left by one
+        static std::uint64_t spreadMask(size_t bits);
+
+        /// Random table of the Gear hash, fixed forever: changing it moves all the boundaries
+        static std::array<std::uint64_t, 256> const GEAR;
+        /// GEAR shifted left by one, for the steps that roll two bytes at once
+        static std::array<std::uint64_t, 256> const GEAR_SHIFTED;
+
+        /// Number of chunks fingerprinted together
+        static size_t const inline BATCH_SIZE = 32;
+
+        ChunkingParameters params;
+        /// Stricter mask used before the average size
+        std::uint64_t maskSmall;
+        /// Looser mask used after the average size
+        std::uint64_t maskLarge;
+    };
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include <span>
+#include <atomic>
+#include <cstdint>
+#include "config/types.h"
+
+namespace cch::hash
+{
+    /// Adler-32 checksum, compatible with zlib
+    class Adler32
+    {
+    public:
+        /// Implementations of the bulk checksum
+        enum class Backend
+        {
+            /// Portable implementation
+            Scalar,
+            AVX2
+        };
+
+        /// Calculate the checksum of the data
+        /// \param data data to checksum
+        /// \param adler checksum of the preceding data, so that hash(b, hash(a)) == hash(a + b)
+        /// \return checksum of the data
+        static std::uint32_t hash(std::span<cch::byte const> data, std::uint32_t adler = 1);
+
+        /// Checksum of two concatenated pieces of data from the checksums of the pieces
+        /// \param adler1 checksum of the first piece
+        /// \param adler2 checksum of the second piece
+        /// \param length2 length of the second piece in bytes
+        /// \return checksum of the first piece followed by the second one
+        static std::uint32_t combine(std::uint32_t adler1, std::uint32_t adler2, std::uint64_t length2);
+
+        /// Feed the next piece of data to the incremental checksum
+        /// \param data data of any size
+        void update(std::span<cch::byte const> data);
+
+        /// Feed a single byte to the incremental checksum
+        /// \param value next byte of the data
+        void update(cch::byte value) noexcept
+        {
+            a = (a + value) % MOD_ADLER;
+            b = (b + a) % MOD_ADLER;
+        }
+
+        /// Checksum of the data passed to update() so far, the checksum can be updated further
+        /// \return same value as hash() of the whole data
+        std::uint32_t digest() const noexcept
+        {
+            return (b << 16) | a;
+        }
+
+        /// Discard the data processed so far and start over
+        void reset() noexcept
+        {
+            a = 1;
+            b = 0;
+        }
+
+        /// Check whether the backend can run on the current CPU
+        /// \param backend backend to check
+        /// \return true if the backend is supported
+        static bool isSupported(Backend backend);
+
+        /// Select the backend used by all Adler-32 computations
+        /// The fastest supported backend is selected on the first use by default
+        /// \param backend backend to use
+        /// \return false if the backend is not supported by the CPU, the current backend is kept in that case
+        static bool setBackend(Backend backend);
+
+        /// \return backend currently used by all Adler-32 computations
+        static Backend getBackend();
+
+        static std::uint32_t const inline MOD_ADLER = 65521;
+
+    private:
+        using UpdateFunction = std::uint32_t (*)(std::uint32_t adler, cch::byte const *data, size_t size);
+
+        static std::uint32_t updateScalar(std::uint32_t adler, cch::byte const *data, size_t size);
+        static std::uint32_t updateAVX2(std::uint32_t adler, cch::byte const *data, size_t size);
+        /// Selects the fastest backend on the first call and forwards to it
+        static std::uint32_t updateDispatch(std::uint32_t adler, cch::byte const *data, size_t size);
+
+        static std::atomic<UpdateFunction> updateFunction;
+
+        /// Largest number of bytes whose sums cannot overflow 32 bits before the reduction
+        static size_t const inline MAX_DEFERRED = 5552;
+
+        std::uint32_t a = 1;
+        std::uint32_t b = 0;
+    };
+
+    /// Adler-32 of a sliding window of fixed size, updated in constant time per byte
+    /// Used to find blocks of known size at any offset of the data
+    class RollingAdler32
+    {
+    public:
+        /// \param window initial contents of the window, its size is the window size
+        explicit RollingAdler32(std::span<cch::byte const> window);
+
+        /// Slide the window by one byte
+        /// \param out first byte of the window, leaving it
+        /// \param in byte following the window, entering it
+        void roll(cch::byte out, cch::byte in) noexcept
+        {
+            a = (a + MOD_ADLER - out + in) % MOD_ADLER;
+            b = (b + windowModulo * (MOD_ADLER - out) + a + MOD_ADLER - 1) % MOD_ADLER;
+        }
+
+        /// \return checksum of the current window, the same as Adler32::hash() of it
+        std::uint32_t digest() const noexcept
+        {
+            return (b << 16) | a;
+        }
+
+        /// \return number of bytes in the window
+        size_t windowSize() const noexcept
+        {
+            return size;
+        }
+
+    private:
+        static std::uint32_t const inline MOD_ADLER = Adler32::MOD_ADLER;
+
+        std::uint32_t a;
+        std::uint32_t b;
+        size_t size;
+        /// Window size reduced modulo MOD_ADLER, the weight of the byte leaving the window
+        std::uint32_t windowModulo;
+    };
+}
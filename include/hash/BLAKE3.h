@@ -0,0 +1,233 @@
+#pragma once
+#include <span>
+#include <array>
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+#include "config/types.h"
+
+namespace cch::hash
+{
+    struct BLAKE3Hash
+    {
+        std::array<cch::byte, 32> bytes{};
+
+        std::string toString() const
+        {
+            std::stringstream ss;
+
+            for (auto x : bytes)
+            {
+                ss << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(x);
+            }
+
+            return ss.str();
+        }
+
+        std::span<cch::byte const> const getHash() const
+        {
+            return std::span<cch::byte const>(bytes);
+        }
+
+        std::array<cch::byte, 32> toBytes() const
+        {
+            return bytes;
+        }
+
+        bool operator==(BLAKE3Hash const &other) const = default;
+    };
+
+    /// BLAKE3 cryptographic hash
+    /// The input is split into 1 KiB chunks that are hashed independently and combined in a binary tree,
+    /// so long inputs are hashed in SIMD lanes (one chunk per lane) and subtrees on several threads
+    class BLAKE3
+    {
+    public:
+        /// Implementations of the multi-chunk compression
+        enum class Backend
+        {
+            /// Portable implementation, one chunk at a time
+            Scalar,
+            /// 8 chunks at once
+            AVX2,
+            /// 16 chunks at once
+            AVX512
+        };
+
+        static size_t const inline BLOCK_SIZE = 64;
+        static size_t const inline CHUNK_SIZE = 1024;
+        static size_t const inline KEY_SIZE = 32;
+
+        /// Regular (unkeyed) hasher
+        BLAKE3();
+
+        /// Keyed hasher, a MAC or PRF
+        /// \param key 32-byte secret key
+        explicit BLAKE3(std::span<cch::byte const, KEY_SIZE> key);
+
+        /// \param data data to hash
+        /// \param threadCount number of threads hashing subtrees of long inputs, 0 to use all hardware threads
+        /// \return hash of the data
+        static BLAKE3Hash hash(std::span<cch::byte const> data, size_t threadCount = 1);
+
+        /// Feed the next piece of data to the incremental hasher
+        /// \param data data of any size, long pieces are hashed with whole subtrees at once
+        /// \param threadCount number of threads hashing subtrees of the piece, 0 to use all hardware threads
+        void update(std::span<cch::byte const> data, size_t threadCount = 1);
+
+        /// Finish hashing of the data passed to update() and reset the hasher
+        /// \return hash of the entire data
+        BLAKE3Hash finalize();
+
+        /// Finish hashing with an output of any length and reset the hasher
+        /// The first 32 bytes are the same as the regular hash
+        /// \param output buffer to fill with the extended output
+        void finalize(std::span<cch::byte> output);
+
+        /// Discard the data processed so far and start over, the key is kept
+        void reset() noexcept;
+
+        /// Check whether the backend can run on the current CPU
+        /// \param backend backend to check
+        /// \return true if the backend is supported
+        static bool isSupported(Backend backend);
+
+        /// Select the backend used by all BLAKE3 computations
+        /// The fastest supported backend is selected on the first use by default
+        /// \param backend backend to use
+        /// \return false if the backend is not supported by the CPU, the current backend is kept in that case
+        static bool setBackend(Backend backend);
+
+        /// \return backend currently used by all BLAKE3 computations
+        static Backend getBackend();
+
+    private:
+        using ChainingValue = std::array<std::uint32_t, 8>;
+
+        /// Compress the same number of blocks from every input, inputs are hashed independently
+        /// \param inputs first block of every input
+        /// \param inputCount number of inputs
+        /// \param blocks number of blocks of every input
+        /// \param key initial chaining value
+        /// \param counter counter of the first input
+        /// \param incrementCounter true if the inputs are consecutive chunks, false if they are parent nodes
+        /// \param flags flags of every block
+        /// \param flagsStart additional flags of the first block
+        /// \param flagsEnd additional flags of the last block
+        /// \param out receives the 32-byte chaining value of every input
+        using HashManyFunction = void (*)(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                          std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                          std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out);
+
+        /// Kernel of a backend and the number of inputs it processes at once
+        struct Kernel
+        {
+            Backend backend;
+            size_t degree;
+            HashManyFunction hashMany;
+        };
+
+        static Kernel const &kernel();
+
+        static void hashManyScalar(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                   std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                   std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out);
+        static void hashManyAVX2(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                 std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                 std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out);
+        static void hashManyAVX512(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                   std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                   std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out);
+
+        /// Compression of one block in every lane, cv and words are in [word][lane] layout
+        static void compressLanesAVX2(std::array<std::array<std::uint32_t, 8>, 8> &cv, std::array<std::array<std::uint32_t, 8>, 16> const &words,
+                                      std::array<std::uint32_t, 8> const &counterLow, std::array<std::uint32_t, 8> const &counterHigh,
+                                      std::uint32_t blockLength, std::uint32_t flags);
+        static void compressLanesAVX512(std::array<std::array<std::uint32_t, 16>, 8> &cv, std::array<std::array<std::uint32_t, 16>, 16> const &words,
+                                        std::array<std::uint32_t, 16> const &counterLow, std::array<std::uint32_t, 16> const &counterHigh,
+                                        std::uint32_t blockLength, std::uint32_t flags);
+
+        static std::array<Kernel, 3> const KERNELS;
+        static std::atomic<Kernel const *> selectedKernel;
+
+        /// Compression function, returns the full 16-word state used by the extended output
+        static std::array<std::uint32_t, 16> compress(ChainingValue const &cv, std::array<std::uint32_t, 16> const &block,
+                                                      std::uint64_t counter, std::uint32_t blockLength, std::uint32_t flags);
+
+        /// Partially hashed chunk
+        struct ChunkState
+        {
+            ChainingValue cv;
+            std::uint64_t counter = 0;
+            std::array<cch::byte, BLOCK_SIZE> block{};
+            size_t blockLength = 0;
+            size_t blocksCompressed = 0;
+            std::uint8_t flags = 0;
+
+            ChunkState(ChainingValue const &key, std::uint64_t counter, std::uint8_t flags);
+
+            size_t length() const;
+            void update(std::span<cch::byte const> data);
+        };
+
+        /// Inputs of the last compression of a node, it gives the chaining value or the root output
+        struct Output
+        {
+            ChainingValue cv;
+            std::array<std::uint32_t, 16> block;
+            std::uint64_t counter;
+            std::uint32_t blockLength;
+            std::uint8_t flags;
+
+            void chainingValue(cch::byte *out) const;
+            void rootBytes(std::span<cch::byte> out) const;
+        };
+
+        static Output chunkOutput(ChunkState const &chunk);
+        static Output parentOutput(cch::byte const *children, ChainingValue const &key, std::uint8_t flags);
+
+        /// Chaining values of the chunks of an input of at most degree() chunks
+        static size_t compressChunksParallel(std::span<cch::byte const> input, ChainingValue const &key, std::uint64_t counter,
+                                             std::uint8_t flags, cch::byte *out);
+        /// Parent nodes of pairs of chaining values, an odd one is passed through
+        static size_t compressParentsParallel(cch::byte const *childCVs, size_t childCount, ChainingValue const &key,
+                                              std::uint8_t flags, cch::byte *out);
+        /// Chaining values of the subtree one level below its root, or more of them if the kernel is wide
+        static size_t compressSubtreeWide(std::span<cch::byte const> input, ChainingValue const &key, std::uint64_t counter,
+                                          std::uint8_t flags, cch::byte *out, size_t threadCount);
+        /// Both children of the root of a subtree of at least two chunks
+        static void compressSubtreeToParentNode(std::span<cch::byte const> input, ChainingValue const &key, std::uint64_t counter,
+                                                std::uint8_t flags, cch::byte *out, size_t threadCount);
+
+        /// Push the chaining value of a completed subtree, merging the subtrees completed before it
+        void pushChainingValue(cch::byte const *cv, std::uint64_t chunkCounter);
+        /// Merge the completed subtrees, leaving one per set bit of totalChunks
+        void mergeChainingValues(std::uint64_t totalChunks);
+
+        static std::uint8_t const inline CHUNK_START = 1 << 0;
+        static std::uint8_t const inline CHUNK_END = 1 << 1;
+        static std::uint8_t const inline PARENT = 1 << 2;
+        static std::uint8_t const inline ROOT = 1 << 3;
+        static std::uint8_t const inline KEYED_HASH = 1 << 4;
+
+        static size_t const inline OUT_SIZE = 32;
+        static size_t const inline MAX_DEGREE = 16;
+        /// Enough for 2^64 chunks
+        static size_t const inline MAX_DEPTH = 54;
+        /// Inputs shorter than that are not worth another thread
+        static size_t const inline MIN_PARALLEL_SIZE = 256 * CHUNK_SIZE;
+
+        static ChainingValue const IV;
+        /// Order of the message words in every round
+        static std::array<std::array<std::uint8_t, 16>, 7> const MESSAGE_SCHEDULE;
+
+        ChainingValue key;
+        std::uint8_t flags;
+        ChunkState chunk;
+        /// Chaining values of the completed subtrees, the largest first
+        std::array<cch::byte, (MAX_DEPTH + 1) * OUT_SIZE> cvStack;
+        size_t cvStackSize = 0;
+    };
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <filesystem>
+#include "config/types.h"
+
+namespace cch::hash
+{
+    /// Digest of one file of a batch
+    struct FileDigest
+    {
+        /// Digest bytes in the standard order of the algorithm, empty if the file could not be hashed
+        std::vector<cch::byte> digest;
+        /// Why the file could not be hashed, empty on success
+        std::string error;
+
+        bool ok() const noexcept
+        {
+            return error.empty();
+        }
+
+        std::string toString() const;
+    };
+
+    /// Hashes many files at once, keeping the storage busy while the hashing runs on a pool of workers
+    /// On Linux 5.6+ the reads of many files are in flight together through io_uring into registered buffers and the
+    /// completed buffers are handed to the workers. Elsewhere every worker reads its files with blocking pread() calls
+    class BatchFileHasher
+    {
+    public:
+        enum class Algorithm
+        {
+            MD5,
+            SHA256,
+            SHA512
+        };
+
+        /// Ways of reading the files
+        enum class IoBackend
+        {
+            /// Asynchronous reads through io_uring, issued by the calling thread
+            IoUring,
+            /// Blocking reads on the worker threads
+            Pread
+        };
+
+        struct Options
+        {
+            /// Reads in flight at once, that many files are read concurrently
+            size_t queueDepth = 64;
+            /// Size of every read buffer, twice the queue depth of them are allocated
+            size_t bufferSize = 256 * 1024;
+            /// Hashing threads, 0 to use all hardware threads
+            size_t threadCount = 0;
+            /// Preferred backend, Pread is used if it is not supported
+            IoBackend ioBackend = IoBackend::IoUring;
+        };
+
+        /// \param algorithm digest to compute
+        /// \param options queue depth, buffers and threads
+        /// \throw std::invalid_argument if the queue depth is not in [1; 4096] or the buffer size is not in [1; 1 GiB]
+        explicit BatchFileHasher(Algorithm algorithm, Options const &options);
+        explicit BatchFileHasher(Algorithm algorithm);
+
+        /// Hash the files
+        /// A file that cannot be read does not stop the batch, its entry carries the error instead
+        /// \param paths files to hash
+        /// \return digest of every file, in the same order
+        /// \throw std::system_error if the I/O ring fails as a whole
+        std::vector<FileDigest> hash(std::span<std::filesystem::path const> paths) const;
+
+        /// \return backend used for reading
+        IoBackend ioBackend() const noexcept
+        {
+            return backend;
+        }
+
+        /// Check whether the backend can be used on this system
+        /// \param backend backend to check
+        /// \return true if the backend is supported
+        static bool isSupported(IoBackend backend);
+
+    private:
+        void hashWithIoUring(std::span<std::filesystem::path const> paths, std::vector<FileDigest> &results, size_t threadCount) const;
+        void hashWithPread(std::span<std::filesystem::path const> paths, std::vector<FileDigest> &results, size_t threadCount) const;
+
+        static size_t const inline MAX_QUEUE_DEPTH = 4096;
+        static size_t const inline MAX_BUFFER_SIZE = 1024 * 1024 * 1024;
+
+        Algorithm algorithm;
+        Options options;
+        IoBackend backend;
+    };
+}
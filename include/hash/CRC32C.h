@@ -0,0 +1,148 @@
+#pragma once
+#include <span>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "config/types.h"
+
+namespace cch::hash
+{
+    /// CRC-32C (Castagnoli polynomial, as used by iSCSI, ext4, Btrfs and many storage formats)
+    class CRC32C
+    {
+    public:
+        /// Implementations of the checksum
+        enum class Backend
+        {
+            /// Portable table-driven implementation (slicing by 8)
+            Scalar,
+            /// SSE4.2 crc32 instruction on three interleaved streams merged with PCLMULQDQ
+            SSE42
+        };
+
+        /// Calculate the checksum of the data
+        /// \param data data to checksum
+        /// \param crc checksum of the preceding data, so that hash(b, hash(a)) == hash(a + b)
+        /// \return checksum of the data
+        static std::uint32_t hash(std::span<cch::byte const> data, std::uint32_t crc = 0);
+
+        /// Checksum of two concatenated pieces of data from the checksums of the pieces
+        /// Lets blocks be checksummed independently (e.g. in parallel) and merged afterwards
+        /// \param crc1 checksum of the first piece
+        /// \param crc2 checksum of the second piece
+        /// \param length2 length of the second piece in bytes
+        /// \return checksum of the first piece followed by the second one
+        static std::uint32_t combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t length2);
+
+        /// Feed the next piece of data to the incremental checksum
+        /// Can be called from the same loop that produces or consumes the data, e.g. per compressed block
+        /// \param data data of any size
+        void update(std::span<cch::byte const> data);
+
+        /// Finish the checksum of the data passed to update() and reset the state
+        /// \return checksum of the entire data
+        std::uint32_t finalize();
+
+        /// Discard the data processed so far and start over
+        void reset() noexcept;
+
+        /// Check whether the backend can run on the current CPU
+        /// \param backend backend to check
+        /// \return true if the backend is supported
+        static bool isSupported(Backend backend);
+
+        /// Select the backend used by all CRC32C computations
+        /// The fastest supported backend is selected on the first use by default
+        /// \param backend backend to use
+        /// \return false if the backend is not supported by the CPU, the current backend is kept in that case
+        static bool setBackend(Backend backend);
+
+        /// \return backend currently used by all CRC32C computations
+        static Backend getBackend();
+
+    private:
+        /// Update a raw (not inverted) checksum with the data
+        using UpdateFunction = std::uint32_t (*)(std::uint32_t crc, cch::byte const *data, size_t size);
+
+        static std::uint32_t updateScalar(std::uint32_t crc, cch::byte const *data, size_t size);
+        static std::uint32_t updateSSE42(std::uint32_t crc, cch::byte const *data, size_t size);
+        /// Selects the fastest backend on the first call and forwards to it
+        static std::uint32_t updateDispatch(std::uint32_t crc, cch::byte const *data, size_t size);
+
+        static std::atomic<UpdateFunction> updateFunction;
+
+        /// Reflected Castagnoli polynomial
+        static std::uint32_t const inline POLYNOMIAL = 0x82F63B78;
+
+        /// a(x) * b(x) mod P(x), both in the reflected representation
+        static constexpr std::uint32_t multiplyModP(std::uint32_t a, std::uint32_t b)
+        {
+            std::uint32_t product = 0;
+
+            for (std::uint32_t mask = 0x80000000; mask != 0; mask >>= 1)
+            {
+                if (a & mask)
+                {
+                    product ^= b;
+                }
+
+                b = (b & 1) ? (b >> 1) ^ POLYNOMIAL : b >> 1;
+            }
+
+            return product;
+        }
+
+        /// x^n mod P(x) in the reflected representation
+        static constexpr std::uint32_t xPowerModP(std::uint64_t n)
+        {
+            // x^(2^k) is squared for every bit of n
+            std::uint32_t result = 0x80000000;
+            std::uint32_t square = 0x40000000;
+
+            for (; n != 0; n >>= 1)
+            {
+                if (n & 1)
+                {
+                    result = multiplyModP(result, square);
+                }
+
+                square = multiplyModP(square, square);
+            }
+
+            return result;
+        }
+
+        static consteval std::array<std::array<std::uint32_t, 256>, 8> generateTables()
+        {
+            std::array<std::array<std::uint32_t, 256>, 8> tables{};
+
+            for (std::uint32_t i = 0; i < 256; ++i)
+            {
+                std::uint32_t crc = i;
+
+                for (size_t bit = 0; bit < 8; ++bit)
+                {
+                    crc = (crc & 1) ? (crc >> 1) ^ POLYNOMIAL : crc >> 1;
+                }
+
+                tables[0][i] = crc;
+            }
+
+            // tables[k][i] is the checksum of byte i followed by k zero bytes
+            for (size_t k = 1; k < tables.size(); ++k)
+            {
+                for (std::uint32_t i = 0; i < 256; ++i)
+                {
+                    tables[k][i] = (tables[k - 1][i] >> 8) ^ tables[0][tables[k - 1][i] & 0xFF];
+                }
+            }
+
+            return tables;
+        }
+
+        static std::array<std::array<std::uint32_t, 256>, 8> const TABLES;
+
+        /// Running raw checksum of the incremental interface
+        std::uint32_t state = 0xFFFFFFFF;
+    };
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <climits>
+#include <cstdint>
+#include <string_view>
+#include "config/types.h"
+
+namespace cch::hash::detail
+{
+    /// Block loop and padding of the MD5/SHA family for constant expressions
+    /// Runtime hashing goes through the kernels of every hash instead, this one only has to be constexpr
+    /// \tparam Word message word type
+    /// \tparam WordOrder byte order of the message words and of the length field
+    /// \tparam LengthBytes size of the message length field appended by the padding
+    /// \param data message
+    /// \param compress compress(block) processes one block of 16 words
+    template <typename Word, std::endian WordOrder, size_t LengthBytes, typename Compress>
+    constexpr void compileTimeHash(std::string_view data, Compress compress)
+    {
+        constexpr size_t BlockSize = 16 * sizeof(Word);
+
+        auto const process = [&compress](auto const &bytes, size_t offset)
+        {
+            std::array<Word, 16> block{};
+
+            for (size_t i = 0; i < block.size(); ++i)
+            {
+                for (size_t j = 0; j < sizeof(Word); ++j)
+                {
+                    size_t const shift = (WordOrder == std::endian::big ? sizeof(Word) - 1 - j : j) * CHAR_BIT;
+                    block[i] |= static_cast<Word>(static_cast<cch::byte>(bytes[offset + i * sizeof(Word) + j])) << shift;
+                }
+            }
+
+            compress(block);
+        };
+
+        size_t const chunkCount = data.size() / BlockSize;
+
+        for (size_t i = 0; i < chunkCount; ++i)
+        {
+            process(data, i * BlockSize);
+        }
+
+        // The padding is always appended, together with the tail of the data it takes one or two blocks
+        std::array<cch::byte, 2 * BlockSize> remainingBytes{};
+        size_t const tailSize = data.size() % BlockSize;
+
+        for (size_t i = 0; i < tailSize; ++i)
+        {
+            remainingBytes[i] = static_cast<cch::byte>(data[chunkCount * BlockSize + i]);
+        }
+
+        remainingBytes[tailSize] = 0x80;
+
+        size_t const paddingChunks = tailSize + 1 + LengthBytes > BlockSize ? 2 : 1;
+        size_t const lengthOffset = paddingChunks * BlockSize - LengthBytes;
+        std::uint64_t const bitLength = static_cast<std::uint64_t>(data.size()) * CHAR_BIT;
+
+        // Only the low 64 bits of a wider length field can be non-zero
+        for (size_t j = 0; j < sizeof(bitLength); ++j)
+        {
+            size_t const idx = WordOrder == std::endian::big ? lengthOffset + LengthBytes - 1 - j : lengthOffset + j;
+            remainingBytes[idx] = static_cast<cch::byte>(bitLength >> (j * CHAR_BIT));
+        }
+
+        for (size_t i = 0; i < paddingChunks; ++i)
+        {
+            process(remainingBytes, i * BlockSize);
+        }
+    }
+}
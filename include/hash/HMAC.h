@@ -0,0 +1,176 @@
+#pragma once
+#include <span>
+#include <array>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <stdexcept>
+#include "config/types.h"
+
+namespace cch::hash
+{
+    /// Keyed-hash message authentication code (RFC 2104) on top of an incremental hasher, e.g. HMAC<SHA256>
+    /// The hashers that absorbed (key ^ ipad) and (key ^ opad) are kept, so a message costs
+    /// two compression function calls less than hashing the padded key blocks again, and nothing is allocated
+    /// \tparam Hasher incremental hasher (SHA256, SHA512, MD5)
+    template <typename Hasher>
+    class HMAC
+    {
+    public:
+        using Hash = decltype(std::declval<Hasher&>().finalize());
+
+        /// Size of the authentication code in bytes
+        static size_t const inline DIGEST_SIZE = std::tuple_size_v<decltype(std::declval<Hash const&>().toBytes())>;
+
+        /// Precompute the keyed states
+        /// \param key key of any size, keys longer than the block size are hashed first
+        explicit HMAC(std::span<cch::byte const> key)
+        {
+            std::array<cch::byte, Hasher::BLOCK_SIZE> block{};
+
+            if (key.size() > Hasher::BLOCK_SIZE)
+            {
+                Hasher keyHasher;
+                keyHasher.update(key);
+                auto const keyHash = keyHasher.finalize().toBytes();
+                std::copy(keyHash.begin(), keyHash.end(), block.begin());
+            }
+            else
+            {
+                std::copy(key.begin(), key.end(), block.begin());
+            }
+
+            for (auto &b : block)
+            {
+                b ^= IPAD;
+            }
+
+            innerKeyed.update(block);
+
+            for (auto &b : block)
+            {
+                b ^= IPAD ^ OPAD;
+            }
+
+            outerKeyed.update(block);
+            inner = innerKeyed;
+        }
+
+        /// Authenticate a whole message, the streaming state is not affected
+        /// \param message message to authenticate
+        /// \return authentication code
+        Hash mac(std::span<cch::byte const> message) const
+        {
+            Hasher hasher = innerKeyed;
+            hasher.update(message);
+
+            return finish(hasher);
+        }
+
+        /// Feed the next piece of the message to the streaming interface
+        /// \param data data of any size
+        void update(std::span<cch::byte const> data)
+        {
+            inner.update(data);
+        }
+
+        /// Finish the message passed to update() and start a new one with the same key
+        /// \return authentication code of the message
+        Hash finalize()
+        {
+            auto const result = finish(inner);
+            inner = innerKeyed;
+
+            return result;
+        }
+
+        /// Discard the data passed to update(), the key is kept
+        void reset() noexcept
+        {
+            inner = innerKeyed;
+        }
+
+        /// Check an authentication code, the comparison takes the same time wherever the codes differ
+        /// \param message authenticated message
+        /// \param expected received authentication code
+        /// \return true if the code is valid
+        bool verify(std::span<cch::byte const> message, Hash const &expected) const
+        {
+            return equal(mac(message), expected);
+        }
+
+        /// Check the authentication codes of many messages
+        /// Both hash stages run through Hasher::hashMany, starting from the keyed states,
+        /// so the messages share the SIMD lanes of the multi-buffer kernels
+        /// \param messages authenticated messages
+        /// \param expected received authentication code of every message
+        /// \param results receives true for every message with a valid code
+        /// \return number of messages with a valid code
+        /// \throw std::invalid_argument if the spans differ in size
+        size_t verifyMany(std::span<std::span<cch::byte const> const> messages, std::span<Hash const> expected, std::span<bool> results) const
+        {
+            if (messages.size() != expected.size() || messages.size() != results.size())
+            {
+                throw std::invalid_argument("Messages, codes and results must have the same size");
+            }
+
+            auto const innerHashes = Hasher::hashMany(innerKeyed, messages);
+
+            std::vector<std::array<cch::byte, DIGEST_SIZE>> innerDigests(innerHashes.size());
+            std::vector<std::span<cch::byte const>> outerMessages(innerHashes.size());
+
+            for (size_t i = 0; i < innerHashes.size(); ++i)
+            {
+                innerDigests[i] = innerHashes[i].toBytes();
+                outerMessages[i] = innerDigests[i];
+            }
+
+            auto const codes = Hasher::hashMany(outerKeyed, outerMessages);
+            size_t valid = 0;
+
+            for (size_t i = 0; i < codes.size(); ++i)
+            {
+                results[i] = equal(codes[i], expected[i]);
+                valid += results[i];
+            }
+
+            return valid;
+        }
+
+        /// Compare two authentication codes in constant time
+        static bool equal(Hash const &lhs, Hash const &rhs)
+        {
+            auto const left = lhs.toBytes();
+            auto const right = rhs.toBytes();
+            cch::byte difference = 0;
+
+            for (size_t i = 0; i < left.size(); ++i)
+            {
+                difference |= left[i] ^ right[i];
+            }
+
+            return difference == 0;
+        }
+
+    private:
+        /// Finish the inner hash and run it through the outer keyed state
+        Hash finish(Hasher &innerHasher) const
+        {
+            auto const innerHash = innerHasher.finalize().toBytes();
+
+            Hasher outer = outerKeyed;
+            outer.update(innerHash);
+
+            return outer.finalize();
+        }
+
+        static cch::byte const inline IPAD = 0x36;
+        static cch::byte const inline OPAD = 0x5c;
+
+        /// States after the (key ^ ipad) and (key ^ opad) blocks
+        Hasher innerKeyed;
+        Hasher outerKeyed;
+        /// Inner state of the streaming interface
+        Hasher inner;
+    };
+}
@@ -4,7 +4,13 @@
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <bit>
+#include <utility>
 #include "../config/types.h"
+#include "CompileTimeHash.h"
 
 namespace cch::hash
 {
@@ -13,14 +19,14 @@ namespace cch::hash
 		union
 		{
 			cch::byte rawHash[16];
-			std::uint_fast32_t parts[4];
+			std::uint32_t parts[4];
 
 			struct
 			{
-				std::uint_fast32_t A;
-				std::uint_fast32_t B;
-				std::uint_fast32_t C;
-				std::uint_fast32_t D;
+				std::uint32_t A;
+				std::uint32_t B;
+				std::uint32_t C;
+				std::uint32_t D;
 			};
 		};
 
@@ -41,7 +47,30 @@ namespace cch::hash
 			return std::span<cch::byte const>(rawHash);
 		}
 
-		MD5Hash& operator+=(MD5Hash const& other)
+		/// Digest bytes in the standard (little endian) order, independent of the platform byte order
+		constexpr std::array<cch::byte, 16> toBytes() const
+		{
+			std::array<cch::byte, 16> bytes;
+
+			std::array<std::uint32_t, 4> const words = {A, B, C, D};
+
+			for (size_t i = 0; i < words.size(); ++i)
+			{
+				for (size_t j = 0; j < 4; ++j)
+				{
+					bytes[i * 4 + j] = static_cast<cch::byte>(words[i] >> (j * 8));
+				}
+			}
+
+			return bytes;
+		}
+
+		constexpr bool operator==(MD5Hash const& other) const
+		{
+			return A == other.A && B == other.B && C == other.C && D == other.D;
+		}
+
+		constexpr MD5Hash& operator+=(MD5Hash const& other)
 		{
 			A += other.A;
 			B += other.B;
@@ -51,22 +80,87 @@ namespace cch::hash
 			return *this;
 		}
 
-		explicit MD5Hash(size_t inputDataSize = 0) : A(A0), B(B0), C(C0), D(D0) {}
+		constexpr explicit MD5Hash(size_t inputDataSize = 0) : A(A0), B(B0), C(C0), D(D0) {}
 
-		MD5Hash(std::uint_fast32_t A, uint_fast32_t B, uint_fast32_t C, uint_fast32_t D) :
+		constexpr MD5Hash(std::uint32_t A, std::uint32_t B, std::uint32_t C, std::uint32_t D) :
 			A(A), B(B), C(C), D(D) {}
 
-		static std::uint_fast32_t const inline A0 = 0x67452301;
-		static std::uint_fast32_t const inline B0 = 0xefcdab89;
-		static std::uint_fast32_t const inline C0 = 0x98badcfe;
-		static std::uint_fast32_t const inline D0 = 0x10325476;
+		static std::uint32_t const inline A0 = 0x67452301;
+		static std::uint32_t const inline B0 = 0xefcdab89;
+		static std::uint32_t const inline C0 = 0x98badcfe;
+		static std::uint32_t const inline D0 = 0x10325476;
+	};
+
+	/// Multipart digest in the format used by object stores for multipart uploads ("ETag")
+	struct MD5MultipartHash
+	{
+		/// MD5 of the concatenated part digests
+		MD5Hash hash;
+		/// Digest of every part
+		std::vector<MD5Hash> parts;
+
+		/// \return "<hex digest>-<part count>"
+		std::string toString() const
+		{
+			return hash.toString() + "-" + std::to_string(parts.size());
+		}
 	};
 
 	class MD5
 	{
 	public:
+		/// Size of the block processed by the compression function
+		static size_t const inline BLOCK_SIZE = 64;
+
 		static MD5Hash hash(std::span<cch::byte> data);
 
+		/// Hash a string, usable in constant expressions (constexpr auto digest = MD5::hash("...");)
+		/// At runtime the regular kernel is used
+		/// \param data data to hash
+		/// \return hash of the data
+		static constexpr MD5Hash hash(std::string_view data);
+
+		/// Hash many independent messages at once
+		/// Messages are processed in AVX2 (8 lanes) or AVX-512 (16 lanes) registers when the CPU supports it
+		/// \param messages messages of any length
+		/// \return hash of every message, in the same order
+		static std::vector<MD5Hash> hashMany(std::span<std::span<cch::byte const> const> messages);
+
+		/// Hash many messages that all continue the data already passed to prefix, e.g. a keyed block
+		/// The lanes start from the state of the prefix instead of hashing it again for every message
+		/// \param prefix hasher that absorbed a whole number of blocks
+		/// \param messages messages of any length
+		/// \return hash of the prefix data followed by every message, in the same order
+		/// \throw std::invalid_argument if the prefix data does not end on a block boundary
+		static std::vector<MD5Hash> hashMany(MD5 const &prefix, std::span<std::span<cch::byte const> const> messages);
+
+		/// Hash fixed size parts of the data concurrently and combine them into a multipart digest
+		/// \param data data to hash
+		/// \param partSize size of a part in bytes, the last part may be shorter
+		/// \param threadCount number of worker threads, 0 to use all hardware threads
+		/// \return digest of the part digests and the digest of every part
+		static MD5MultipartHash hashMultipart(std::span<cch::byte const> data, size_t partSize, size_t threadCount = 0);
+
+		/// Feed the next piece of data to the incremental hasher
+		/// \param data data of any size
+		void update(std::span<cch::byte const> data);
+
+		/// Finish hashing of the data passed to update() and reset the hasher
+		/// \return hash of the entire data
+		MD5Hash finalize();
+
+		/// Discard the data processed so far and start over
+		void reset() noexcept;
+
+		/// Serialize the hasher so hashing can be continued later, possibly in another process
+		/// \return checkpoint in a stable, platform independent format
+		std::vector<cch::byte> saveState() const;
+
+		/// Continue hashing from a checkpoint created by saveState()
+		/// \param state checkpoint
+		/// \throw std::invalid_argument if the checkpoint is malformed or was created by another algorithm or format version
+		void restoreState(std::span<cch::byte const> state);
+
 	private:
 
 		// Static Methods and Variables
@@ -97,19 +191,138 @@ namespace cch::hash
 			return table;
 		}
 
-		static void hash(std::span<cch::byte> data, MD5Hash &hashState, std::uint64_t inputDataSize);
+		static void hash(std::span<cch::byte const> data, MD5Hash &hashState, std::uint64_t inputDataSize);
+
+		static std::array<unsigned char, 64> const indexTable;
+
+		static std::array<std::uint32_t, 64> const K;
 
-		static std::array<unsigned char, 64> const constinit indexTable;
+		static std::array<unsigned char, 64> const r;
 
-		static std::array<std::uint_fast32_t, 64> const constinit K;
+		template <size_t I>
+		static constexpr std::uint32_t combine(std::uint32_t A, std::uint32_t B, std::uint32_t C, std::uint32_t D, std::uint32_t val);
 
-		static std::array<unsigned char, 64> const constinit r;
+		static constexpr MD5Hash calculateHash(std::span<std::uint32_t const, 16> data, MD5Hash const& hashState);
+		static void _hashChunk(std::span<cch::byte const> data, size_t chunkIdx, MD5Hash& hashState);
+
+		template <size_t I>
+		static constexpr std::uint32_t f(std::uint32_t B, std::uint32_t C, std::uint32_t D);
+
+		/// Multi-buffer kernels, process one block of every lane, state and words are in [word][lane] layout
+		static void hashLanesAVX2(std::array<std::array<std::uint32_t, 8>, 4> &state, std::array<std::array<std::uint32_t, 8>, 16> const &words);
+		static void hashLanesAVX512(std::array<std::array<std::uint32_t, 16>, 4> &state, std::array<std::array<std::uint32_t, 16>, 16> const &words);
+
+		/// Running state of the incremental hasher
+		MD5Hash hashState;
+		/// Bytes that do not form a complete block yet
+		std::array<cch::byte, BLOCK_SIZE> pendingBlock{};
+		size_t pendingBytes = 0;
+		std::uint64_t processedBytes = 0;
+	};
 
-		static std::uint_fast32_t combine(std::uint_fast32_t A, std::uint_fast32_t B, std::uint_fast32_t C, std::uint_fast32_t D, std::uint32_t val, unsigned char i);
+	inline constexpr std::array<unsigned char, 64> MD5::indexTable = MD5::generateIndexTable();
 
-		static MD5Hash calculateHash(std::span<std::uint_fast32_t> data, MD5Hash& hashState);
-		static void _hashChunk(std::span<cch::byte> data, size_t chunkIdx, MD5Hash& hashState);
+	inline constexpr std::array<std::uint32_t, 64> MD5::K =
+	{
+		0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+		0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+		0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+		0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+		0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+		0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+		0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+		0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+		0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+		0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+		0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+		0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+		0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+		0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+		0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+		0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+	};
 
-		static std::uint_fast32_t f(std::uint_fast32_t B, std::uint_fast32_t C, std::uint_fast32_t D, unsigned char i);
+	inline constexpr std::array<unsigned char, 64> MD5::r =
+	{
+		7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+		5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+		4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+		6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
 	};
+
+	constexpr MD5Hash MD5::hash(std::string_view data)
+	{
+		MD5Hash hashState;
+
+		if consteval
+		{
+			detail::compileTimeHash<std::uint32_t, std::endian::little, 8>(data, [&hashState](std::array<std::uint32_t, 16> const &block)
+			{
+				hashState += calculateHash(block, hashState);
+			});
+		}
+		else
+		{
+			hash(std::span(reinterpret_cast<cch::byte const *>(data.data()), data.size()), hashState, data.size());
+		}
+
+		return hashState;
+	}
+
+	template <size_t I>
+	constexpr std::uint32_t MD5::combine(std::uint32_t A, std::uint32_t B, std::uint32_t C, std::uint32_t D, std::uint32_t val)
+	{
+		std::uint32_t res = f<I>(B, C, D) + A + K[I] + val;
+		res = std::rotl(res, r[I]);
+		res += B;
+
+		return res;
+	}
+
+	template <size_t I>
+	constexpr std::uint32_t MD5::f(std::uint32_t B, std::uint32_t C, std::uint32_t D)
+	{
+		// The round function is selected at compile time, the rounds are unrolled
+		if constexpr (I <= 15)
+		{
+			return D ^ (B & (C ^ D));
+		}
+		else if constexpr (I <= 31)
+		{
+			return C ^ (D & (B ^ C));
+		}
+		else if constexpr (I <= 47)
+		{
+			return B ^ C ^ D;
+		}
+		else
+		{
+			return C ^ (B | (~D));
+		}
+	}
+
+	constexpr MD5Hash MD5::calculateHash(std::span<std::uint32_t const, 16> data, MD5Hash const& hashState)
+	{
+		std::uint32_t A = hashState.A;
+		std::uint32_t B = hashState.B;
+		std::uint32_t C = hashState.C;
+		std::uint32_t D = hashState.D;
+
+		auto const round = [&]<size_t I>()
+		{
+			std::uint32_t const Btmp = combine<I>(A, B, C, D, data[indexTable[I]]);
+
+			A = D;
+			D = C;
+			C = B;
+			B = Btmp;
+		};
+
+		[&]<size_t... I>(std::index_sequence<I...>)
+		{
+			(round.template operator()<I>(), ...);
+		}(std::make_index_sequence<64>{});
+
+		return MD5Hash{ A, B, C, D};
+	}
 }
@@ -5,7 +5,12 @@
 #include <vector>
 #include <bit>
 #include <array>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
 #include "config/types.h"
+#include "CompileTimeHash.h"
 
 namespace cch::hash
 {
@@ -15,7 +20,7 @@ namespace cch::hash
         {
             cch::byte rawHash[32];
 
-            std::array<std::uint_fast32_t, 8> parts =
+            std::array<std::uint32_t, 8> parts =
             {
                 0x6a09e667,
                 0xbb67ae85,
@@ -30,7 +35,7 @@ namespace cch::hash
 
         SHA256Hash() = default;
 
-        explicit SHA256Hash(std::array<std::uint_fast32_t, 8> hash) :
+        constexpr explicit SHA256Hash(std::array<std::uint32_t, 8> hash) :
             parts(hash) {}
 
         std::string toString() const
@@ -63,7 +68,28 @@ namespace cch::hash
             return std::span<cch::byte const>(rawHash);
         }
 
-        SHA256Hash& operator+=(SHA256Hash const& other)
+        /// Digest bytes in the standard (big endian) order, independent of the platform byte order
+        constexpr std::array<cch::byte, 32> toBytes() const
+        {
+            std::array<cch::byte, 32> bytes;
+
+            for (size_t i = 0; i < std::size(parts); ++i)
+            {
+                for (size_t j = 0; j < 4; ++j)
+                {
+                    bytes[i * 4 + j] = static_cast<cch::byte>(parts[i] >> (24 - j * 8));
+                }
+            }
+
+            return bytes;
+        }
+
+        constexpr bool operator==(SHA256Hash const& other) const
+        {
+            return parts == other.parts;
+        }
+
+        constexpr SHA256Hash& operator+=(SHA256Hash const& other)
         {
             for (size_t i = 0; i < std::size(parts); ++i)
             {
@@ -77,16 +103,204 @@ namespace cch::hash
     class SHA256
     {
     public:
+        /// Size of the block processed by the compression function
+        static size_t const inline BLOCK_SIZE = 64;
+
+        /// Implementations of the block compression function
+        enum class Backend
+        {
+            /// Portable implementation
+            Scalar,
+            /// x86 SHA extensions (sha256rnds2/sha256msg1/sha256msg2)
+            SHANI
+        };
+
         static SHA256Hash hash(std::span<cch::byte> data);
 
+        /// Hash a string, usable in constant expressions (constexpr auto digest = SHA256::hash("...");)
+        /// At runtime the regular kernels are used
+        /// \param data data to hash
+        /// \return hash of the data
+        static constexpr SHA256Hash hash(std::string_view data);
+
+        /// Hash many independent messages at once
+        /// Messages are processed in AVX2 (8 lanes) or AVX-512 (16 lanes) registers when the CPU supports it,
+        /// unless a backend was selected with setBackend()
+        /// \param messages messages of any length
+        /// \return hash of every message, in the same order
+        static std::vector<SHA256Hash> hashMany(std::span<std::span<cch::byte const> const> messages);
+
+        /// Hash many messages that all continue the data already passed to prefix, e.g. a keyed block
+        /// The lanes start from the state of the prefix instead of hashing it again for every message
+        /// \param prefix hasher that absorbed a whole number of blocks
+        /// \param messages messages of any length
+        /// \return hash of the prefix data followed by every message, in the same order
+        /// \throw std::invalid_argument if the prefix data does not end on a block boundary
+        static std::vector<SHA256Hash> hashMany(SHA256 const &prefix, std::span<std::span<cch::byte const> const> messages);
+
+        /// Feed the next piece of data to the incremental hasher
+        /// \param data data of any size
+        void update(std::span<cch::byte const> data);
+
+        /// Finish hashing of the data passed to update() and reset the hasher
+        /// \return hash of the entire data
+        SHA256Hash finalize();
+
+        /// Discard the data processed so far and start over
+        void reset() noexcept;
+
+        /// Serialize the hasher so hashing can be continued later, possibly in another process
+        /// \return checkpoint in a stable, platform independent format
+        std::vector<cch::byte> saveState() const;
+
+        /// Continue hashing from a checkpoint created by saveState()
+        /// \param state checkpoint
+        /// \throw std::invalid_argument if the checkpoint is malformed or was created by another algorithm or format version
+        void restoreState(std::span<cch::byte const> state);
+
+        /// Check whether the backend can run on the current CPU
+        /// \param backend backend to check
+        /// \return true if the backend is supported
+        static bool isSupported(Backend backend);
+
+        /// Select the backend used by all SHA256 computations, hashMany() included
+        /// The fastest supported backend is selected on the first use by default, and hashMany() then uses the
+        /// multi-buffer kernels where they are faster
+        /// \param backend backend to use
+        /// \return false if the backend is not supported by the CPU, the current backend is kept in that case
+        static bool setBackend(Backend backend);
+
+        /// \return backend currently used by all SHA256 computations
+        static Backend getBackend();
+
     private:
-        static void hash(std::span<cch::byte> data, SHA256Hash &hash, std::uint64_t inputDataSize);
-        static void hashChunk(std::span<cch::byte> data, size_t chunkIdx, SHA256Hash& hashState);
-        static SHA256Hash calculateHash(std::span<std::uint_fast32_t> data, SHA256Hash &hashState);
+        using BlockFunction = void (*)(SHA256Hash &hashState, cch::byte const *data, size_t blockCount);
+
+        static void hash(std::span<cch::byte const> data, SHA256Hash &hash, std::uint64_t inputDataSize);
+        static void hashChunk(std::span<cch::byte const> data, size_t chunkIdx, SHA256Hash& hashState, size_t chunkCount = 1);
+        static constexpr SHA256Hash calculateHash(std::span<std::uint32_t const, 16> data, SHA256Hash const &hashState);
+
+        /// Block functions of the backends, process blockCount consecutive 64-byte blocks
+        static void hashBlocksScalar(SHA256Hash &hashState, cch::byte const *data, size_t blockCount);
+        static void hashBlocksSHANI(SHA256Hash &hashState, cch::byte const *data, size_t blockCount);
+        /// Selects the fastest backend on the first call and forwards to it
+        static void hashBlocksDispatch(SHA256Hash &hashState, cch::byte const *data, size_t blockCount);
+
+        static void useBackend(Backend backend);
+
+        static std::atomic<BlockFunction> hashBlocks;
+        /// The backend was chosen with setBackend() rather than by default
+        static std::atomic<bool> backendSelected;
+
+        /// Multi-buffer kernels, process one block of every lane, state and words are in [word][lane] layout
+        static void hashLanesAVX2(std::array<std::array<std::uint32_t, 8>, 8> &state, std::array<std::array<std::uint32_t, 8>, 16> const &words);
+        static void hashLanesAVX512(std::array<std::array<std::uint32_t, 16>, 8> &state, std::array<std::array<std::uint32_t, 16>, 16> const &words);
+
+        static std::array<std::uint32_t, 64> const K;
 
-        static std::array<std::uint_fast32_t, 64> K;
+        static constexpr std::uint32_t s0(std::uint32_t x);
+        static constexpr std::uint32_t s1(std::uint32_t x);
 
-        static std::uint_fast32_t s0(std::uint_fast32_t x);
-        static std::uint_fast32_t s1(std::uint_fast32_t x);
+        /// Running state of the incremental hasher
+        SHA256Hash hashState;
+        /// Bytes that do not form a complete block yet
+        std::array<cch::byte, BLOCK_SIZE> pendingBlock{};
+        size_t pendingBytes = 0;
+        std::uint64_t processedBytes = 0;
     };
+
+    inline constexpr std::array<std::uint32_t, 64> SHA256::K =
+    {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+    };
+
+    constexpr SHA256Hash SHA256::hash(std::string_view data)
+    {
+        SHA256Hash hashState;
+
+        if consteval
+        {
+            detail::compileTimeHash<std::uint32_t, std::endian::big, 8>(data, [&hashState](std::array<std::uint32_t, 16> const &block)
+            {
+                hashState += calculateHash(block, hashState);
+            });
+        }
+        else
+        {
+            hash(std::span(reinterpret_cast<cch::byte const *>(data.data()), data.size()), hashState, data.size());
+        }
+
+        return hashState;
+    }
+
+    constexpr SHA256Hash SHA256::calculateHash(std::span<std::uint32_t const, 16> data, SHA256Hash const &hashState)
+    {
+        // Only the last 16 words of the schedule are needed, they are kept in a ring
+        std::array<std::uint32_t, 16> w;
+        std::copy(data.begin(), data.end(), w.begin());
+
+        std::uint32_t A = hashState.parts[0];
+        std::uint32_t B = hashState.parts[1];
+        std::uint32_t C = hashState.parts[2];
+        std::uint32_t D = hashState.parts[3];
+        std::uint32_t E = hashState.parts[4];
+        std::uint32_t F = hashState.parts[5];
+        std::uint32_t G = hashState.parts[6];
+        std::uint32_t H = hashState.parts[7];
+
+        auto const schedule = [&w](size_t i)
+        {
+            if (i >= 16)
+            {
+                w[i % 16] += s0(w[(i + 1) % 16]) + w[(i + 9) % 16] + s1(w[(i + 14) % 16]);
+            }
+
+            return w[i % 16];
+        };
+
+        // The state variables are not shifted after every round, instead every call takes them in rotated order,
+        // 8 rounds bring them back to the original order
+        auto const round = [](auto a, auto b, auto c, auto &d, auto e, auto f, auto g, auto &h, std::uint32_t kw)
+        {
+            auto const S1 = std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+            auto const ch = g ^ (e & (f ^ g));
+            auto const tmp1 = h + S1 + ch + kw;
+            auto const S0 = std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+            auto const maj = (a & b) | (c & (a | b));
+
+            d += tmp1;
+            h = tmp1 + S0 + maj;
+        };
+
+        for (size_t i = 0; i < 64; i += 8)
+        {
+            round(A, B, C, D, E, F, G, H, K[i] + schedule(i));
+            round(H, A, B, C, D, E, F, G, K[i + 1] + schedule(i + 1));
+            round(G, H, A, B, C, D, E, F, K[i + 2] + schedule(i + 2));
+            round(F, G, H, A, B, C, D, E, K[i + 3] + schedule(i + 3));
+            round(E, F, G, H, A, B, C, D, K[i + 4] + schedule(i + 4));
+            round(D, E, F, G, H, A, B, C, K[i + 5] + schedule(i + 5));
+            round(C, D, E, F, G, H, A, B, K[i + 6] + schedule(i + 6));
+            round(B, C, D, E, F, G, H, A, K[i + 7] + schedule(i + 7));
+        }
+
+        return SHA256Hash{{A, B, C, D, E, F, G, H}};
+    }
+
+    constexpr std::uint32_t SHA256::s0(std::uint32_t x)
+    {
+        return std::rotr(x, 7) ^ std::rotr(x, 18) ^ (x >> 3);
+    }
+
+    constexpr std::uint32_t SHA256::s1(std::uint32_t x)
+    {
+        return std::rotr(x, 17) ^ std::rotr(x, 19) ^ (x >> 10);
+    }
 }
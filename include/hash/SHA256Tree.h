@@ -0,0 +1,71 @@
+#pragma once
+#include <span>
+#include <vector>
+#include "SHA256.h"
+#include "config/types.h"
+
+namespace cch::hash
+{
+    /// Merkle tree hash of a buffer
+    struct SHA256TreeHash
+    {
+        /// Root of the tree, identifies the entire buffer
+        SHA256Hash root;
+        /// Digest of every leaf, leaf i covers the bytes [i * leafSize, (i + 1) * leafSize)
+        std::vector<SHA256Hash> leaves;
+        size_t leafSize = 0;
+    };
+
+    /// Parallel tree hashing on top of SHA256
+    /// The buffer is split into fixed size leaves that are hashed concurrently and combined into a Merkle root:
+    ///  leaf = SHA256(0x00 || leafData)
+    ///  node = SHA256(0x01 || left || right)
+    /// A node without a sibling is promoted to the next level unchanged, an empty buffer is a single empty leaf
+    class SHA256Tree
+    {
+    public:
+        SHA256Tree() = delete;
+
+        /// Hash the buffer
+        /// \param data data to hash
+        /// \param leafSize size of a leaf in bytes
+        /// \param threadCount number of worker threads, 0 to use all hardware threads
+        /// \return root and leaf digests
+        static SHA256TreeHash hash(std::span<cch::byte const> data, size_t leafSize = DEFAULT_LEAF_SIZE, size_t threadCount = 0);
+
+        /// Rehash the leaves overlapping the changed byte range and recompute the root
+        /// \param data entire buffer after the change, its size must not change
+        /// \param tree tree of the buffer before the change
+        /// \param offset first changed byte
+        /// \param length number of changed bytes
+        static void update(std::span<cch::byte const> data, SHA256TreeHash &tree, size_t offset, size_t length);
+
+        /// Check that the byte range still matches the tree without hashing the rest of the buffer
+        /// \param data entire buffer
+        /// \param tree tree to verify against
+        /// \param offset first byte of the range
+        /// \param length length of the range
+        /// \return indices of the leaves in the range whose digest does not match
+        static std::vector<size_t> verify(std::span<cch::byte const> data, SHA256TreeHash const &tree, size_t offset, size_t length);
+
+        /// \param leafData data of a single leaf
+        /// \return leaf digest
+        static SHA256Hash hashLeaf(std::span<cch::byte const> leafData);
+
+        /// Combine leaf digests into the Merkle root
+        /// \param leaves leaf digests
+        /// \return root digest
+        static SHA256Hash root(std::span<SHA256Hash const> leaves);
+
+        static size_t const inline DEFAULT_LEAF_SIZE = 1024 * 1024;
+
+    private:
+        static size_t leafCount(size_t dataSize, size_t leafSize);
+        static std::span<cch::byte const> leafData(std::span<cch::byte const> data, size_t leafSize, size_t leafIdx);
+        /// Range of leaves [first, last) overlapping the byte range
+        static std::pair<size_t, size_t> leafRange(SHA256TreeHash const &tree, size_t dataSize, size_t offset, size_t length);
+
+        static cch::byte const inline LEAF_PREFIX = 0x00;
+        static cch::byte const inline NODE_PREFIX = 0x01;
+    };
+}
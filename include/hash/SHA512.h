@@ -5,8 +5,12 @@
 #include <vector>
 #include <bit>
 #include <array>
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
 
 #include "config/types.h"
+#include "CompileTimeHash.h"
 
 namespace cch::hash
 {
@@ -16,7 +20,7 @@ namespace cch::hash
         {
             cch::byte rawHash[64];
 
-            std::array<std::uint_fast64_t, 8> parts =
+            std::array<std::uint64_t, 8> parts =
             {
                 0x6a09e667f3bcc908,
                 0xbb67ae8584caa73b,
@@ -31,7 +35,7 @@ namespace cch::hash
 
         SHA512Hash() = default;
 
-        explicit SHA512Hash(std::array<std::uint_fast64_t, 8> hash) :
+        constexpr explicit SHA512Hash(std::array<std::uint64_t, 8> hash) :
             parts(hash) {}
 
         std::string toString() const
@@ -64,7 +68,28 @@ namespace cch::hash
             return std::span<cch::byte const>(rawHash);
         }
 
-        SHA512Hash& operator+=(SHA512Hash const& other)
+        /// Digest bytes in the standard (big endian) order, independent of the platform byte order
+        constexpr std::array<cch::byte, 64> toBytes() const
+        {
+            std::array<cch::byte, 64> bytes;
+
+            for (size_t i = 0; i < std::size(parts); ++i)
+            {
+                for (size_t j = 0; j < 8; ++j)
+                {
+                    bytes[i * 8 + j] = static_cast<cch::byte>(parts[i] >> (56 - j * 8));
+                }
+            }
+
+            return bytes;
+        }
+
+        constexpr bool operator==(SHA512Hash const& other) const
+        {
+            return parts == other.parts;
+        }
+
+        constexpr SHA512Hash& operator+=(SHA512Hash const& other)
         {
             for (size_t i = 0; i < std::size(parts); ++i)
             {
@@ -78,12 +103,162 @@ namespace cch::hash
     class SHA512
     {
     public:
+        /// Size of the block processed by the compression function
+        static size_t const inline BLOCK_SIZE = 128;
+
         static SHA512Hash hash(std::span<cch::byte> data);
 
+        /// Hash a string, usable in constant expressions (constexpr auto digest = SHA512::hash("...");)
+        /// At runtime the regular kernels are used
+        /// \param data data to hash
+        /// \return hash of the data
+        static constexpr SHA512Hash hash(std::string_view data);
+
+        /// Hash many independent messages at once
+        /// Messages are processed in AVX2 (4 lanes) or AVX-512 (8 lanes) registers when the CPU supports it
+        /// \param messages messages of any length
+        /// \return hash of every message, in the same order
+        static std::vector<SHA512Hash> hashMany(std::span<std::span<cch::byte const> const> messages);
+
+        /// Hash many messages that all continue the data already passed to prefix, e.g. a keyed block
+        /// The lanes start from the state of the prefix instead of hashing it again for every message
+        /// \param prefix hasher that absorbed a whole number of blocks
+        /// \param messages messages of any length
+        /// \return hash of the prefix data followed by every message, in the same order
+        /// \throw std::invalid_argument if the prefix data does not end on a block boundary
+        static std::vector<SHA512Hash> hashMany(SHA512 const &prefix, std::span<std::span<cch::byte const> const> messages);
+
+        /// Feed the next piece of data to the incremental hasher
+        /// \param data data of any size
+        void update(std::span<cch::byte const> data);
+
+        /// Finish hashing of the data passed to update() and reset the hasher
+        /// \return hash of the entire data
+        SHA512Hash finalize();
+
+        /// Discard the data processed so far and start over
+        void reset() noexcept;
+
+        /// Serialize the hasher so hashing can be continued later, possibly in another process
+        /// \return checkpoint in a stable, platform independent format
+        std::vector<cch::byte> saveState() const;
+
+        /// Continue hashing from a checkpoint created by saveState()
+        /// \param state checkpoint
+        /// \throw std::invalid_argument if the checkpoint is malformed or was created by another algorithm or format version
+        void restoreState(std::span<cch::byte const> state);
+
     private:
-        static void hash(std::span<cch::byte> data, SHA512Hash &hash, std::uint64_t inputDataSize);
-        static void hashChunk(std::span<cch::byte> data, size_t chunkIdx, SHA512Hash& hashState);
-        static SHA512Hash calculateHash(std::span<std::uint_fast64_t> data, SHA512Hash &hashState);
-        static std::array<std::uint_fast64_t, 80> K;
+        static void hash(std::span<cch::byte const> data, SHA512Hash &hash, std::uint64_t inputDataSize);
+        static void hashChunk(std::span<cch::byte const> data, size_t chunkIdx, SHA512Hash& hashState);
+        static constexpr SHA512Hash calculateHash(std::span<std::uint64_t const, 16> data, SHA512Hash const &hashState);
+        static std::array<std::uint64_t, 80> const K;
+
+        /// Multi-buffer kernels, process one block of every lane, state and words are in [word][lane] layout
+        static void hashLanesAVX2(std::array<std::array<std::uint64_t, 4>, 8> &state, std::array<std::array<std::uint64_t, 4>, 16> const &words);
+        static void hashLanesAVX512(std::array<std::array<std::uint64_t, 8>, 8> &state, std::array<std::array<std::uint64_t, 8>, 16> const &words);
+
+        /// Running state of the incremental hasher
+        SHA512Hash hashState;
+        /// Bytes that do not form a complete block yet
+        std::array<cch::byte, BLOCK_SIZE> pendingBlock{};
+        size_t pendingBytes = 0;
+        std::uint64_t processedBytes = 0;
+    };
+
+    inline constexpr std::array<std::uint64_t, 80> SHA512::K =
+    {
+        0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+        0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+        0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+        0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+        0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+        0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+        0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+        0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+        0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+        0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+        0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+        0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+        0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+        0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+        0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+        0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
     };
+
+    constexpr SHA512Hash SHA512::hash(std::string_view data)
+    {
+        SHA512Hash hashState;
+
+        if consteval
+        {
+            detail::compileTimeHash<std::uint64_t, std::endian::big, 16>(data, [&hashState](std::array<std::uint64_t, 16> const &block)
+            {
+                hashState += calculateHash(block, hashState);
+            });
+        }
+        else
+        {
+            hash(std::span(reinterpret_cast<cch::byte const *>(data.data()), data.size()), hashState, data.size());
+        }
+
+        return hashState;
+    }
+
+    constexpr SHA512Hash SHA512::calculateHash(std::span<std::uint64_t const, 16> data, SHA512Hash const &hashState)
+    {
+        // Only the last 16 words of the schedule are needed, they are kept in a ring
+        std::array<std::uint64_t, 16> w;
+        std::copy(data.begin(), data.end(), w.begin());
+
+        std::uint64_t A = hashState.parts[0];
+        std::uint64_t B = hashState.parts[1];
+        std::uint64_t C = hashState.parts[2];
+        std::uint64_t D = hashState.parts[3];
+        std::uint64_t E = hashState.parts[4];
+        std::uint64_t F = hashState.parts[5];
+        std::uint64_t G = hashState.parts[6];
+        std::uint64_t H = hashState.parts[7];
+
+        auto const schedule = [&w](size_t i)
+        {
+            if (i >= 16)
+            {
+                auto const w15 = w[(i + 1) % 16];
+                auto const w2 = w[(i + 14) % 16];
+                w[i % 16] += (std::rotr(w15, 1) ^ std::rotr(w15, 8) ^ (w15 >> 7)) + w[(i + 9) % 16] +
+                    (std::rotr(w2, 19) ^ std::rotr(w2, 61) ^ (w2 >> 6));
+            }
+
+            return w[i % 16];
+        };
+
+        // The state variables are not shifted after every round, instead every call takes them in rotated order,
+        // 8 rounds bring them back to the original order
+        auto const round = [](auto a, auto b, auto c, auto &d, auto e, auto f, auto g, auto &h, std::uint64_t kw)
+        {
+            auto const S1 = std::rotr(e, 14) ^ std::rotr(e, 18) ^ std::rotr(e, 41);
+            auto const ch = g ^ (e & (f ^ g));
+            auto const tmp1 = h + S1 + ch + kw;
+            auto const S0 = std::rotr(a, 28) ^ std::rotr(a, 34) ^ std::rotr(a, 39);
+            auto const maj = (a & b) | (c & (a | b));
+
+            d += tmp1;
+            h = tmp1 + S0 + maj;
+        };
+
+        for (size_t i = 0; i < 80; i += 8)
+        {
+            round(A, B, C, D, E, F, G, H, K[i] + schedule(i));
+            round(H, A, B, C, D, E, F, G, K[i + 1] + schedule(i + 1));
+            round(G, H, A, B, C, D, E, F, K[i + 2] + schedule(i + 2));
+            round(F, G, H, A, B, C, D, E, K[i + 3] + schedule(i + 3));
+            round(E, F, G, H, A, B, C, D, K[i + 4] + schedule(i + 4));
+            round(D, E, F, G, H, A, B, C, K[i + 5] + schedule(i + 5));
+            round(C, D, E, F, G, H, A, B, K[i + 6] + schedule(i + 6));
+            round(B, C, D, E, F, G, H, A, K[i + 7] + schedule(i + 7));
+        }
+
+        return SHA512Hash{{A, B, C, D, E, F, G, H}};
+    }
 }
@@ -0,0 +1,169 @@
+#pragma once
+#include <span>
+#include <array>
+#include <atomic>
+#include <string>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+#include "config/types.h"
+
+namespace cch::hash
+{
+    struct XXH3Hash128
+    {
+        std::uint64_t low = 0;
+        std::uint64_t high = 0;
+
+        /// Canonical representation, the high half first
+        std::string toString() const
+        {
+            std::stringstream ss;
+            ss << std::setw(16) << std::setfill('0') << std::hex << high
+               << std::setw(16) << std::setfill('0') << std::hex << low;
+
+            return ss.str();
+        }
+
+        /// Canonical bytes (big endian, the high half first), independent of the platform byte order
+        std::array<cch::byte, 16> toBytes() const
+        {
+            std::array<cch::byte, 16> bytes;
+
+            for (size_t i = 0; i < 8; ++i)
+            {
+                bytes[i] = static_cast<cch::byte>(high >> (56 - i * 8));
+                bytes[8 + i] = static_cast<cch::byte>(low >> (56 - i * 8));
+            }
+
+            return bytes;
+        }
+
+        bool operator==(XXH3Hash128 const &other) const = default;
+    };
+
+    /// XXH3 fast non-cryptographic hash with 64 and 128-bit results, compatible with xxHash 0.8
+    /// Meant for checksums, hash tables and dedup prefilters, it gives no protection against deliberate collisions
+    class XXH3
+    {
+    public:
+        /// Implementations of the stripe accumulation used for inputs longer than 240 bytes
+        enum class Backend
+        {
+            /// Portable implementation
+            Scalar,
+            SSE2,
+            AVX2,
+            AVX512
+        };
+
+        /// \param seed seed of the streaming hash
+        explicit XXH3(std::uint64_t seed = 0);
+
+        /// \param data data to hash
+        /// \param seed seed, hashes with different seeds are independent
+        /// \return 64-bit hash of the data
+        static std::uint64_t hash64(std::span<cch::byte const> data, std::uint64_t seed = 0);
+
+        /// \param data data to hash
+        /// \param seed seed, hashes with different seeds are independent
+        /// \return 128-bit hash of the data
+        static XXH3Hash128 hash128(std::span<cch::byte const> data, std::uint64_t seed = 0);
+
+        /// Feed the next piece of data to the incremental hasher
+        /// \param data data of any size
+        void update(std::span<cch::byte const> data);
+
+        /// Hash of the data passed to update() so far, the hasher can be updated further
+        /// \return same value as hash64() of the whole data
+        std::uint64_t digest64() const;
+
+        /// Hash of the data passed to update() so far, the hasher can be updated further
+        /// \return same value as hash128() of the whole data
+        XXH3Hash128 digest128() const;
+
+        /// Discard the data processed so far and start over with the same seed
+        void reset() noexcept;
+
+        /// Check whether the backend can run on the current CPU
+        /// \param backend backend to check
+        /// \return true if the backend is supported
+        static bool isSupported(Backend backend);
+
+        /// Select the backend used by all XXH3 computations
+        /// The fastest supported backend is selected on the first use by default
+        /// \param backend backend to use
+        /// \return false if the backend is not supported by the CPU, the current backend is kept in that case
+        static bool setBackend(Backend backend);
+
+        /// \return backend currently used by all XXH3 computations
+        static Backend getBackend();
+
+        static size_t const inline STRIPE_SIZE = 64;
+        static size_t const inline SECRET_SIZE = 192;
+
+    private:
+        using Accumulators = std::array<std::uint64_t, 8>;
+
+        /// Kernels of a backend
+        /// accumulate processes stripeCount consecutive stripes, the secret advances by 8 bytes per stripe
+        /// scramble mixes the accumulators at the end of a block
+        struct Kernel
+        {
+            Backend backend;
+            void (*accumulate)(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount);
+            void (*scramble)(std::uint64_t *acc, cch::byte const *secret);
+        };
+
+        static Kernel const &kernel();
+
+        static void accumulateScalar(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount);
+        static void scrambleScalar(std::uint64_t *acc, cch::byte const *secret);
+        static void accumulateSSE2(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount);
+        static void scrambleSSE2(std::uint64_t *acc, cch::byte const *secret);
+        static void accumulateAVX2(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount);
+        static void scrambleAVX2(std::uint64_t *acc, cch::byte const *secret);
+        static void accumulateAVX512(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount);
+        static void scrambleAVX512(std::uint64_t *acc, cch::byte const *secret);
+
+        static std::array<Kernel, 4> const KERNELS;
+        static std::atomic<Kernel const *> selectedKernel;
+
+        /// Hashes of inputs up to MIDSIZE_MAX bytes, they only use the default secret and the seed
+        static std::uint64_t hash64Short(std::span<cch::byte const> data, std::uint64_t seed);
+        static XXH3Hash128 hash128Short(std::span<cch::byte const> data, std::uint64_t seed);
+
+        /// Accumulate all the stripes of an input longer than MIDSIZE_MAX bytes
+        static void hashLong(std::span<cch::byte const> data, Accumulators &acc, cch::byte const *secret);
+        /// Continue the accumulation with stripeCount stripes, scrambling at the block boundaries
+        static void consumeStripes(Accumulators &acc, size_t &stripesInBlock, cch::byte const *input, size_t stripeCount, cch::byte const *secret);
+
+        static std::uint64_t mergeAccumulators(Accumulators const &acc, cch::byte const *secret, std::uint64_t start);
+        static std::uint64_t longDigest64(Accumulators const &acc, cch::byte const *secret, std::uint64_t length);
+        static XXH3Hash128 longDigest128(Accumulators const &acc, cch::byte const *secret, std::uint64_t length);
+
+        /// Accumulators of the streamed data including the buffered part and the final stripe
+        void finalAccumulators(Accumulators &finalAcc) const;
+
+        /// Secret of a seeded hash of a long input
+        static void deriveSecret(std::uint64_t seed, std::array<cch::byte, SECRET_SIZE> &secret);
+
+        static Accumulators const INITIAL_ACCUMULATORS;
+        alignas(64) static std::array<cch::byte, SECRET_SIZE> const DEFAULT_SECRET;
+
+        static size_t const inline STRIPES_PER_BLOCK = (SECRET_SIZE - STRIPE_SIZE) / 8;
+        static size_t const inline BLOCK_SIZE = STRIPES_PER_BLOCK * STRIPE_SIZE;
+        static size_t const inline MIDSIZE_MAX = 240;
+        static size_t const inline BUFFER_SIZE = 4 * STRIPE_SIZE;
+
+        /// Running state of the incremental hasher
+        alignas(64) Accumulators acc;
+        alignas(64) std::array<cch::byte, SECRET_SIZE> secret;
+        /// Data not accumulated yet, the last stripe before it is kept at the end of the buffer
+        alignas(64) std::array<cch::byte, BUFFER_SIZE> buffer{};
+        size_t bufferedBytes = 0;
+        size_t stripesInBlock = 0;
+        std::uint64_t totalBytes = 0;
+        std::uint64_t seed;
+    };
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <span>
+#include <array>
+#include <cstdint>
+#include "config/types.h"
+
+namespace cch
+{
+    /// Occurrences of every byte value, the first pass of the entropy coders
+    class ByteHistogram
+    {
+    public:
+        using Counts = std::array<std::uint64_t, 256>;
+
+        ByteHistogram() = delete;
+
+        /// Count the occurrences of each byte
+        /// Inputs of at least 2 * PARALLEL_MIN_SIZE bytes are split between the threads and the counts are added up
+        /// \param data data to count
+        /// \param threadCount threads counting the data, 0 to use all hardware threads
+        /// \return a[byte] = numberOfEntries
+        static Counts count(std::span<cch::byte const> data, size_t threadCount = 1);
+
+        /// Smallest part of the data counted by one thread
+        static size_t const inline PARALLEL_MIN_SIZE = 4 * 1024 * 1024;
+
+    private:
+        /// Add the occurrences of each byte to the counts
+        static void countRange(std::span<cch::byte const> data, Counts &counts);
+
+        /// Repeated bytes increment the same counter and every increment waits for the previous store,
+        /// spreading consecutive bytes over several tables keeps the increments independent
+        static size_t const inline TABLE_COUNT = 8;
+        /// Bytes counted in the 32-bit tables before they are added to the counts, no table counter can overflow
+        static size_t const inline FLUSH_SIZE = 1024 * 1024 * 1024;
+    };
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+    #define CCH_ARCH_X86 1
+#endif
+
+namespace cch
+{
+    /// Instruction set extensions of the CPU the library is running on
+    /// Used to pick the fastest available kernel at runtime
+    struct CpuFeatures
+    {
+        bool ssse3 = false;
+        bool sse41 = false;
+        bool sse42 = false;
+        bool pclmul = false;
+        bool avx2 = false;
+        bool avx512f = false;
+        bool avx512bw = false;
+        bool avx512vl = false;
+        bool sha = false;
+
+        /// Detected features, cpuid is queried only once
+        /// \return features of the current CPU
+        static CpuFeatures const& get();
+    };
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <span>
+#include <filesystem>
+#include "config/types.h"
+
+namespace cch
+{
+    /// Read-only memory mapping of a whole file
+    /// The file is read lazily by the OS as the mapping is accessed, so large files are processed without copying them
+    class MappedFile
+    {
+    public:
+        /// Map the file
+        /// \param path file to map
+        /// \throw std::runtime_error if the file cannot be opened or mapped
+        explicit MappedFile(std::filesystem::path const &path);
+
+        MappedFile(MappedFile const &) = delete;
+        MappedFile &operator=(MappedFile const &) = delete;
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+        ~MappedFile();
+
+        /// \return contents of the file, valid while the mapping exists
+        std::span<cch::byte const> data() const noexcept
+        {
+            return {address, length};
+        }
+
+        size_t size() const noexcept
+        {
+            return length;
+        }
+
+    private:
+        void unmap() noexcept;
+
+        cch::byte const *address = nullptr;
+        size_t length = 0;
+    #if defined(_WIN32)
+        void *mapping = nullptr;
+    #endif
+    };
+}
@@ -2,29 +2,11 @@
 #include <algorithm>
 
 /// Implemented
-std::array<unsigned long, 256> cch::compression::ArithmeticCompression::countBytes(std::span<cch::byte> data)
-{
-    std::array<unsigned long, 256> counted;
-
-    for (size_t i = 0; i < counted.size(); ++i)
-    {
-        counted[i] = 0;
-    }
-
-    for (auto c : data)
-    {
-        ++counted[c];
-    }
-
-    return counted;
-}
-
-/// Implemented
-std::array<cch::byte, 256> cch::compression::ArithmeticCompression::scaleCounts(const std::array<unsigned long, 256> &counts)
+std::array<cch::byte, 256> cch::compression::ArithmeticCompression::scaleCounts(ByteHistogram::Counts const &counts)
 {
     std::array<cch::byte, 256> scaled;
 
-    unsigned long maxCount = *std::max(counts.begin(), counts.end());
+    unsigned long maxCount = std::ranges::max(counts);
     unsigned int total = 1;
     unsigned long scale = maxCount / 256 + 1;
 
@@ -101,7 +83,7 @@ std::vector<cch::byte> cch::compression::ArithmeticCompression::compress(std::sp
 /// Implemented
 void cch::compression::ArithmeticCompression::buildModel(std::span<cch::byte> data)
 {
-    auto counts = countBytes(data);
+    auto counts = ByteHistogram::count(data);
     auto scaled = scaleCounts(counts);
     buildTotals(scaled);
 }
@@ -1,317 +1,1448 @@
 #include "../../include/compression/HuffmanCompression.h"
-#include "../../include/utilities/bitstream.h"
-#include "../../include/hash/djb2hash.h"
-#include <limits>
-#include <queue>
-#include <iostream>
-#include <format>
 #include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+    /// Accumulates codes aligned to the most significant bit of a word and stores them a whole word at a time
+    struct BitWriter
+    {
+        cch::byte *out = nullptr;
+        std::uint64_t bits = 0;
+        size_t bitCount = 0;
+
+        /// Append a code, at most 57 bits may be pending
+        void put(std::uint16_t const code, std::uint8_t const length)
+        {
+            bitCount += length;
+            bits |= static_cast<std::uint64_t>(code) << (64 - bitCount);
+        }
+
+        /// Store the pending bits and keep the bits of the incomplete last byte, the destination needs one word of slack
+        void flush()
+        {
+            std::uint64_t word = bits;
+
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                word = std::byteswap(word);
+            }
+
+            std::memcpy(out, &word, sizeof(word));
+            out += bitCount >> 3;
+            bits <<= bitCount & ~size_t{7};
+            bitCount &= 7;
+        }
+
+        /// Flush, including the incomplete last byte
+        /// \return end of the written data
+        cch::byte *finish()
+        {
+            flush();
+            return out + (bitCount != 0);
+        }
+    };
+
+    /// Holds the next bits of a stream, from the most significant bit down
+    struct BitReader
+    {
+        std::uint64_t bits = 0;
+        size_t bitCount = 0;
+        cch::byte const *ptr = nullptr;
+        cch::byte const *end = nullptr;
+
+        /// Refill to at least 56 bits with a single load, more than 8 bytes must be left
+        void refill()
+        {
+            std::uint64_t word;
+            std::memcpy(&word, ptr, sizeof(word));
+
+            if constexpr (std::endian::native == std::endian::little)
+            {
+                word = std::byteswap(word);
+            }
+
+            bits |= word >> bitCount;
+            ptr += (63 - bitCount) >> 3;
+            bitCount |= 56;
+        }
+
+        /// Refill one byte at a time without reading past the end, past the end the buffer holds zeros
+        void refillTail()
+        {
+            while (bitCount <= 56 && ptr != end)
+            {
+                bits |= static_cast<std::uint64_t>(*ptr++) << (56 - bitCount);
+                bitCount += 8;
+            }
+
+            if (ptr == end)
+            {
+                bitCount = 64;
+            }
+        }
+
+        void consume(size_t const count)
+        {
+            bits <<= count;
+            bitCount -= count;
+        }
+    };
+
+    template <typename T>
+    void putWord(std::vector<cch::byte> &out, T value)
+    {
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            out.push_back(static_cast<cch::byte>(value >> (i * 8)));
+        }
+    }
+
+    template <typename T>
+    T getWord(cch::byte const *ptr)
+    {
+        T value = 0;
+
+        for (size_t i = 0; i < sizeof(T); ++i)
+        {
+            value |= static_cast<T>(ptr[i]) << (i * 8);
+        }
+
+        return value;
+    }
+}
+
+cch::compression::HuffmanCompression::HuffmanCompression(Options const &options) : options(options)
+{
+    if (options.blockSize != 0 && (options.blockSize < MIN_BLOCK_SIZE || options.blockSize > MAX_BLOCK_SIZE))
+    {
+        throw std::invalid_argument("Block size must be 0 or between " + std::to_string(MIN_BLOCK_SIZE) + " bytes and 1 GiB");
+    }
+}
+
+std::pair<std::vector<cch::byte>, std::vector<cch::byte>> cch::compression::HuffmanCompression::compressData(std::span<cch::byte> data)
+{
+    return options.blockSize == 0 ? compressBlock(data) : compressBlocks(data);
+}
+
+std::vector<cch::byte> cch::compression::HuffmanCompression::decompressData(
+    std::pair<std::span<cch::byte>, std::span<cch::byte>> data)
+{
+    return !data.first.empty() && data.first[0] == BLOCK_FORMAT ? decompressBlocks(data) : decompressBlock(data);
+}
+
+std::pair<std::vector<cch::byte>, std::vector<cch::byte>> cch::compression::HuffmanCompression::compressBlock(std::span<cch::byte> data)
+{
+    if (options.order1)
+    {
+        return compressOrder1(data);
+    }
+
+    return options.interleaved ? compressFourStreams(data) : compressStream(data);
+}
+
+std::vector<cch::byte> cch::compression::HuffmanCompression::decompressBlock(
+    std::pair<std::span<cch::byte>, std::span<cch::byte>> data)
+{
+    cch::byte const format = data.first.empty() ? 0 : data.first[0];
+
+    if (format == ORDER1_FORMAT)
+    {
+        return decompressOrder1(data);
+    }
+
+    return format == FOUR_STREAMS_FORMAT ? decompressFourStreams(data) : decompressStream(data);
+}
+
+std::pair<std::vector<cch::byte>, std::vector<cch::byte>> cch::compression::HuffmanCompression::compressBlocks(std::span<cch::byte> data)
+{
+    size_t const blockCount = (data.size() + options.blockSize - 1) / options.blockSize;
+    std::vector<std::pair<std::vector<cch::byte>, std::vector<cch::byte>>> blocks(blockCount);
+
+    runParallel(blockCount, [&](size_t const block)
+    {
+        blocks[block] = compressBlock(data.subspan(block * options.blockSize, std::min(options.blockSize, data.size() - block * options.blockSize)));
+    });
+
+    std::vector<cch::byte> info;
+    info.reserve(BLOCK_HEADER_SIZE + blockCount * BLOCK_INDEX_ENTRY_SIZE);
+    info.push_back(BLOCK_FORMAT);
+    putWord<std::uint64_t>(info, data.size());
+    putWord<std::uint32_t>(info, static_cast<std::uint32_t>(options.blockSize));
+
+    size_t compressedSize = 0;
+
+    for (auto const &[blockInfo, blockData] : blocks)
+    {
+        putWord<std::uint32_t>(info, static_cast<std::uint32_t>(blockInfo.size()));
+        putWord<std::uint64_t>(info, blockData.size());
+        compressedSize += blockInfo.size() + blockData.size();
+    }
+
+    // Every block is stored as its information followed by its compressed data
+    std::vector<cch::byte> compressedData;
+    compressedData.reserve(compressedSize);
+
+    for (auto &[blockInfo, blockData] : blocks)
+    {
+        compressedData.insert(compressedData.end(), blockInfo.begin(), blockInfo.end());
+        compressedData.insert(compressedData.end(), blockData.begin(), blockData.end());
+        std::vector<cch::byte>().swap(blockInfo);
+        std::vector<cch::byte>().swap(blockData);
+    }
+
+    return std::make_pair(std::move(info), std::move(compressedData));
+}
+
+std::vector<cch::byte> cch::compression::HuffmanCompression::decompressBlocks(
+    std::pair<std::span<cch::byte>, std::span<cch::byte>> data)
+{
+    auto const [info, in] = data;
+
+    if (info.size() < BLOCK_HEADER_SIZE)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    auto const dataSize = getWord<std::uint64_t>(info.data() + 1);
+    size_t const blockSize = getWord<std::uint32_t>(info.data() + 9);
+
+    if (blockSize < MIN_BLOCK_SIZE || blockSize > MAX_BLOCK_SIZE)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    size_t const blockCount = (info.size() - BLOCK_HEADER_SIZE) / BLOCK_INDEX_ENTRY_SIZE;
+
+    if ((info.size() - BLOCK_HEADER_SIZE) % BLOCK_INDEX_ENTRY_SIZE != 0 || blockCount != (dataSize + blockSize - 1) / blockSize)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    // Offsets of the blocks in the compressed data
+    std::vector<size_t> offsets(blockCount + 1);
+
+    for (size_t block = 0; block < blockCount; ++block)
+    {
+        cch::byte const *const entry = info.data() + BLOCK_HEADER_SIZE + block * BLOCK_INDEX_ENTRY_SIZE;
+        std::uint64_t const blockBytes = std::uint64_t{getWord<std::uint32_t>(entry)} + getWord<std::uint64_t>(entry + 4);
+
+        if (blockBytes > in.size() - offsets[block])
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
+
+        offsets[block + 1] = offsets[block] + blockBytes;
+    }
+
+    if (offsets.back() != in.size())
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    std::vector<cch::byte> decompressedData(dataSize);
+
+    runParallel(blockCount, [&](size_t const block)
+    {
+        size_t const blockInfoSize = getWord<std::uint32_t>(info.data() + BLOCK_HEADER_SIZE + block * BLOCK_INDEX_ENTRY_SIZE);
+        auto const blockData = in.subspan(offsets[block], offsets[block + 1] - offsets[block]);
+        auto const decoded = decompressBlock({blockData.first(blockInfoSize), blockData.subspan(blockInfoSize)});
+        size_t const expectedSize = std::min(blockSize, decompressedData.size() - block * blockSize);
+
+        if (decoded.size() != expectedSize)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
+
+        std::ranges::copy(decoded, decompressedData.begin() + block * blockSize);
+    });
+
+    return decompressedData;
+}
+
+size_t cch::compression::HuffmanCompression::histogramThreads() const noexcept
+{
+    // The blocks are already compressed in parallel
+    return options.blockSize == 0 ? options.threadCount : 1;
+}
+
+void cch::compression::HuffmanCompression::runParallel(size_t const count, std::function<void(size_t)> const &task) const
+{
+    size_t threadCount = options.threadCount;
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    threadCount = std::min(threadCount, count);
+
+    std::atomic<size_t> nextTask = 0;
+
+    auto const worker = [&]()
+    {
+        for (size_t index = nextTask++; index < count; index = nextTask++)
+        {
+            task(index);
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(threadCount);
+
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+
+    worker();
+
+    for (auto &w : workers)
+    {
+        w.get();
+    }
+}
+
+std::pair<std::vector<cch::byte>, std::vector<cch::byte>>  cch::compression::HuffmanCompression::compressStream(std::span<cch::byte> data)
+{
+    // Calculate the byte frequency
+    auto const byteFrequency = ByteHistogram::count(data, histogramThreads());
+    // Length limited code lengths and the canonical codes they define
+    auto const lengths = buildCodeLengths(byteFrequency);
+    auto const codes = buildCanonicalCodes(lengths);
+
+    // Serialize the code lengths for used bytes only
+    // The first byte is reserved for the amount of bits used in the last byte of the compressed data
+    std::vector<cch::byte> serializedLengths{0x00};
+    serializeCodeLengths(lengths, serializedLengths);
+
+    std::uint64_t totalBits = 0;
+
+    for (size_t byte = 0; byte < byteFrequency.size(); ++byte)
+    {
+        totalBits += byteFrequency[byte] * lengths[byte];
+    }
+
+    // Every flush stores a whole word, the buffer gets one word of slack
+    std::vector<cch::byte> compressedData((totalBits + 7) / 8 + sizeof(std::uint64_t));
+    BitWriter writer{compressedData.data()};
+    size_t i = 0;
+
+    // Four codes of at most 12 bits fit next to the 7 pending bits
+    for (; i + 4 <= data.size(); i += 4)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            writer.put(codes[data[i + k]].bits, codes[data[i + k]].length);
+        }
+
+        writer.flush();
+    }
+
+    for (; i < data.size(); ++i)
+    {
+        writer.put(codes[data[i]].bits, codes[data[i]].length);
+    }
+
+    cch::byte *const out = writer.finish();
+    compressedData.resize(out - compressedData.data());
+
+    // The first byte is the amount of bits used in the last byte of the compressed data
+    serializedLengths[0] = static_cast<cch::byte>(totalBits == 0 ? 0 : (totalBits - 1) % 8 + 1);
+
+    return std::make_pair(std::move(serializedLengths), std::move(compressedData));
+}
+
+std::vector<cch::byte> cch::compression::HuffmanCompression::decompressStream(
+    std::pair<std::span<cch::byte>, std::span<cch::byte>> data)
+{
+    // Get the amount of bits used in the last byte of compressed data
+    size_t const lastByteBits = data.first.empty() ? 0 : data.first[0];
+    std::span<cch::byte const> const in = data.second;
+
+    if (in.empty() || lastByteBits == 0)
+    {
+        return {};
+    }
+
+    if (lastByteBits > 8)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    // Restore the code lengths from the compression info
+    auto const lengths = restoreCodeLengths(data.first.subspan(1));
+    std::uint64_t const totalBits = (in.size() - 1) * 8 + lastByteBits;
+
+    // A single used byte has the one bit code "0"
+    if (std::ranges::count(lengths, 0) == 255)
+    {
+        auto const symbol = std::ranges::find_if(lengths, [](auto const length) { return length != 0; }) - lengths.begin();
+        return std::vector<cch::byte>(totalBits, static_cast<cch::byte>(symbol));
+    }
+
+    auto const table = buildDecodeTable(lengths);
+
+    std::vector<cch::byte> decompressedData(in.size() * 2 + 128);
+    size_t outPos = 0;
+
+    // Fast loop, the last byte (with the padding bits) is never loaded here
+    BitReader reader{0, 0, in.data(), in.data() + in.size()};
+
+    while (reader.end - reader.ptr > 8)
+    {
+        reader.refill();
+
+        if (decompressedData.size() - outPos < 128)
+        {
+            decompressedData.resize(decompressedData.size() * 2);
+        }
+
+        cch::byte *out = decompressedData.data() + outPos;
+
+        // Every lookup takes at most MAX_CODE_LENGTH bits, a refill holds enough for four of them
+        for (size_t lookup = 0; lookup < (56 / DECODE_TABLE_BITS); ++lookup)
+        {
+            auto const &entry = table[reader.bits >> (64 - DECODE_TABLE_BITS)];
+
+            // All four symbols are copied, the output pointer only moves past the valid ones
+            std::memcpy(out, entry.symbols.data(), MAX_ENTRY_SYMBOLS);
+            out += entry.count;
+            reader.consume(entry.length);
+        }
+
+        outPos = out - decompressedData.data();
+    }
+
+    // The tail is decoded one byte at a time so no symbol is decoded from the padding bits
+    std::uint64_t consumedBits = (reader.ptr - in.data()) * 8 - reader.bitCount;
+
+    while (consumedBits < totalBits)
+    {
+        // The consumed bits are checked against the total below
+        reader.refillTail();
+
+        if (decompressedData.size() - outPos < MAX_ENTRY_SYMBOLS)
+        {
+            decompressedData.resize(decompressedData.size() * 2);
+        }
+
+        auto const &entry = table[reader.bits >> (64 - DECODE_TABLE_BITS)];
+        size_t const length = entry.length <= totalBits - consumedBits ? entry.length : entry.firstLength;
+
+        if (length == entry.length)
+        {
+            std::memcpy(decompressedData.data() + outPos, entry.symbols.data(), MAX_ENTRY_SYMBOLS);
+            outPos += entry.count;
+        }
+        else
+        {
+            decompressedData[outPos++] = entry.symbols[0];
+        }
+
+        reader.consume(length);
+        consumedBits += length;
+    }
+
+    if (consumedBits != totalBits)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    decompressedData.resize(outPos);
+    return decompressedData;
+}
+
+std::pair<std::vector<cch::byte>, std::vector<cch::byte>> cch::compression::HuffmanCompression::compressFourStreams(std::span<cch::byte> data)
+{
+    // Every stream codes a quarter of the data, the last one may be shorter
+    size_t const segmentSize = (data.size() + STREAM_COUNT - 1) / STREAM_COUNT;
+    std::array<std::span<cch::byte>, STREAM_COUNT> segments;
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        size_t const start = std::min(data.size(), stream * segmentSize);
+        segments[stream] = data.subspan(start, std::min(segmentSize, data.size() - start));
+    }
+
+    // The frequencies of every quarter give the exact size of its stream
+    std::array<ByteHistogram::Counts, STREAM_COUNT> segmentFrequencies;
+    ByteHistogram::Counts byteFrequency{};
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        segmentFrequencies[stream] = ByteHistogram::count(segments[stream], histogramThreads());
+
+        for (size_t byte = 0; byte < byteFrequency.size(); ++byte)
+        {
+            byteFrequency[byte] += segmentFrequencies[stream][byte];
+        }
+    }
+
+    auto const lengths = buildCodeLengths(byteFrequency);
+    auto const codes = buildCanonicalCodes(lengths);
+
+    std::vector<cch::byte> serializedLengths{FOUR_STREAMS_FORMAT};
+    serializeCodeLengths(lengths, serializedLengths);
+
+    std::array<size_t, STREAM_COUNT> streamSizes{};
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        std::uint64_t streamBits = 0;
+
+        for (size_t byte = 0; byte < byteFrequency.size(); ++byte)
+        {
+            streamBits += segmentFrequencies[stream][byte] * lengths[byte];
+        }
+
+        streamSizes[stream] = (streamBits + 7) / 8;
+    }
+
+    std::vector<cch::byte> compressedData;
+    compressedData.reserve(FOUR_STREAMS_HEADER_SIZE);
+    putWord<std::uint64_t>(compressedData, data.size());
+
+    for (size_t stream = 0; stream + 1 < STREAM_COUNT; ++stream)
+    {
+        putWord<std::uint64_t>(compressedData, streamSizes[stream]);
+    }
+
+    // The streams are written together, every one gets a word of slack so its flushes do not overwrite the next one
+    std::array<size_t, STREAM_COUNT> streamOffsets{};
+    size_t bufferSize = FOUR_STREAMS_HEADER_SIZE;
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        streamOffsets[stream] = bufferSize;
+        bufferSize += streamSizes[stream] + sizeof(std::uint64_t);
+    }
+
+    compressedData.resize(bufferSize);
+
+    std::array<BitWriter, STREAM_COUNT> writers;
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        writers[stream].out = compressedData.data() + streamOffsets[stream];
+    }
+
+    // One pass over the quarters, the four accumulators are independent
+    size_t const lastSegmentSize = segments[STREAM_COUNT - 1].size();
+    size_t i = 0;
+
+    for (; i + 4 <= lastSegmentSize; i += 4)
+    {
+        for (size_t k = 0; k < 4; ++k)
+        {
+            for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+            {
+                auto const code = codes[segments[stream][i + k]];
+                writers[stream].put(code.bits, code.length);
+            }
+        }
+
+        for (auto &writer : writers)
+        {
+            writer.flush();
+        }
+    }
+
+    for (; i < segmentSize; ++i)
+    {
+        for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+        {
+            if (i < segments[stream].size())
+            {
+                auto const code = codes[segments[stream][i]];
+                writers[stream].put(code.bits, code.length);
+                writers[stream].flush();
+            }
+        }
+    }
+
+    // Close the gaps left by the slack
+    size_t compressedSize = FOUR_STREAMS_HEADER_SIZE;
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        writers[stream].finish();
+        std::memmove(compressedData.data() + compressedSize, compressedData.data() + streamOffsets[stream], streamSizes[stream]);
+        compressedSize += streamSizes[stream];
+    }
+
+    compressedData.resize(compressedSize);
+    compressedData.shrink_to_fit();
+
+    return std::make_pair(std::move(serializedLengths), std::move(compressedData));
+}
+
+std::vector<cch::byte> cch::compression::HuffmanCompression::decompressFourStreams(
+    std::pair<std::span<cch::byte>, std::span<cch::byte>> data)
+{
+    std::span<cch::byte const> const in = data.second;
+
+    if (in.size() < FOUR_STREAMS_HEADER_SIZE)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    std::uint64_t const dataSize = getWord<std::uint64_t>(in.data());
+    std::array<std::uint64_t, STREAM_COUNT> streamSizes{};
+    std::uint64_t streamsSize = in.size() - FOUR_STREAMS_HEADER_SIZE;
+
+    for (size_t stream = 0; stream + 1 < STREAM_COUNT; ++stream)
+    {
+        streamSizes[stream] = getWord<std::uint64_t>(in.data() + 8 + stream * 8);
+
+        if (streamSizes[stream] > streamsSize)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
+
+        streamsSize -= streamSizes[stream];
+    }
+
+    streamSizes[STREAM_COUNT - 1] = streamsSize;
+
+    // Every code takes at least one bit
+    if (dataSize > (in.size() - FOUR_STREAMS_HEADER_SIZE) * 8)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    if (dataSize == 0)
+    {
+        return {};
+    }
+
+    auto const lengths = restoreCodeLengths(data.first.subspan(1));
+    std::vector<cch::byte> decompressedData(dataSize);
+
+    // A single used byte has the one bit code "0"
+    if (std::ranges::count(lengths, 0) == 255)
+    {
+        auto const symbol = std::ranges::find_if(lengths, [](auto const length) { return length != 0; }) - lengths.begin();
+        std::ranges::fill(decompressedData, static_cast<cch::byte>(symbol));
+        return decompressedData;
+    }
+
+    auto const table = buildDecodeTable(lengths);
+    size_t const segmentSize = (dataSize + STREAM_COUNT - 1) / STREAM_COUNT;
+
+    std::array<BitReader, STREAM_COUNT> readers;
+    std::array<cch::byte *, STREAM_COUNT> outs;
+    std::array<cch::byte *, STREAM_COUNT> outEnds;
+    cch::byte const *streamStart = in.data() + FOUR_STREAMS_HEADER_SIZE;
+
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        readers[stream].ptr = streamStart;
+        readers[stream].end = streamStart + streamSizes[stream];
+        streamStart += streamSizes[stream];
+
+        outs[stream] = decompressedData.data() + std::min<size_t>(dataSize, stream * segmentSize);
+        outEnds[stream] = decompressedData.data() + std::min<size_t>(dataSize, (stream + 1) * segmentSize);
+    }
+
+    // Fast loop, the four streams are decoded together while all of them can take a whole refill: four lookups of up to
+    // four symbols, the last copy writes up to 16 bytes past the output pointer
+    auto const canDecode = [&]()
+    {
+        for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+        {
+            if (readers[stream].end - readers[stream].ptr <= 8 || outEnds[stream] - outs[stream] < 16)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    };
+
+    while (canDecode())
+    {
+        for (auto &reader : readers)
+        {
+            reader.refill();
+        }
+
+        for (size_t lookup = 0; lookup < (56 / DECODE_TABLE_BITS); ++lookup)
+        {
+            for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+            {
+                auto const &entry = table[readers[stream].bits >> (64 - DECODE_TABLE_BITS)];
+                std::memcpy(outs[stream], entry.symbols.data(), MAX_ENTRY_SYMBOLS);
+                outs[stream] += entry.count;
+                readers[stream].consume(entry.length);
+            }
+        }
+    }
+
+    // Finish every stream on its own, the symbol count of a stream is known so the padding bits are never decoded
+    for (size_t stream = 0; stream < STREAM_COUNT; ++stream)
+    {
+        auto &reader = readers[stream];
+        std::uint64_t const streamBits = streamSizes[stream] * 8;
+        std::uint64_t consumedBits = (streamSizes[stream] - (reader.end - reader.ptr)) * 8 - reader.bitCount;
+
+        while (outs[stream] != outEnds[stream])
+        {
+            reader.refillTail();
+
+            auto const &entry = table[reader.bits >> (64 - DECODE_TABLE_BITS)];
+            bool const whole = entry.count <= outEnds[stream] - outs[stream];
+            size_t const count = whole ? entry.count : 1;
+            size_t const length = whole ? entry.length : entry.firstLength;
+
+            std::memcpy(outs[stream], entry.symbols.data(), count);
+            outs[stream] += count;
+            reader.consume(length);
+            consumedBits += length;
+        }
+
+        // The stream must end in its last byte
+        if (consumedBits > streamBits || streamBits - consumedBits >= 8)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
+    }
 
-std::pair<std::vector<cch::byte>, std::vector<cch::byte>>  cch::compression::HuffmanCompression::compressData(std::span<cch::byte> data)
+    return decompressedData;
+}
+
+std::pair<std::vector<cch::byte>, std::vector<cch::byte>> cch::compression::HuffmanCompression::compressOrder1(std::span<cch::byte> data)
 {
-    // Calculate the byte frequency
-    auto byteFrequency = calculateCharFrequency(data);
-    // Initialize tree nodes
-    auto nodes = initializeNodes(byteFrequency);
+    std::vector<cch::byte> info{ORDER1_FORMAT};
+    putWord<std::uint64_t>(info, data.size());
+
+    if (data.empty())
+    {
+        return std::make_pair(std::move(info), std::vector<cch::byte>());
+    }
+
+    // The first byte is coded in the context of a zero byte
+    std::vector<ByteHistogram::Counts> contextFrequencies(256);
+    cch::byte previous = 0;
+
+    for (auto const byte : data)
+    {
+        ++contextFrequencies[previous][byte];
+        previous = byte;
+    }
+
+    auto const contextMap = clusterContexts(contextFrequencies);
+
+    std::vector<ByteHistogram::Counts> tableFrequencies(contextMap.tableCount);
+
+    for (size_t context = 0; context < contextFrequencies.size(); ++context)
+    {
+        for (size_t byte = 0; byte < 256; ++byte)
+        {
+            tableFrequencies[contextMap.tableOf[context]][byte] += contextFrequencies[context][byte];
+        }
+    }
+
+    std::vector<CodeLengths> tableLengths(contextMap.tableCount);
+    std::vector<std::array<Code, 256>> tableCodes(contextMap.tableCount);
+
+    for (size_t table = 0; table < contextMap.tableCount; ++table)
+    {
+        tableLengths[table] = buildCodeLengths(tableFrequencies[table]);
+        tableCodes[table] = buildCanonicalCodes(tableLengths[table]);
+    }
+
+    info.push_back(static_cast<cch::byte>(contextMap.tableCount - 1));
+
+    // The context map as runs of (table, length of the run - 1)
+    for (size_t context = 0; context < 256;)
+    {
+        size_t run = 1;
+
+        while (context + run < 256 && contextMap.tableOf[context + run] == contextMap.tableOf[context])
+        {
+            ++run;
+        }
+
+        info.push_back(contextMap.tableOf[context]);
+        info.push_back(static_cast<cch::byte>(run - 1));
+        context += run;
+    }
+
+    // The code lengths of every table, preceded by their size (u16)
+    for (auto const &lengths : tableLengths)
+    {
+        size_t const sizePosition = info.size();
+        putWord<std::uint16_t>(info, 0);
+        serializeCodeLengths(lengths, info);
 
-    // Serialize the frequency for used bytes only
-    auto const usedRanges = generateCodeRanges(byteFrequency);
-    auto serailizedFrequencies = serializeBytesFrequencies(usedRanges, byteFrequency);
-    // Deallocate the memory
-    byteFrequency.clear();
+        size_t const size = info.size() - sizePosition - sizeof(std::uint16_t);
+        info[sizePosition] = static_cast<cch::byte>(size);
+        info[sizePosition + 1] = static_cast<cch::byte>(size >> 8);
+    }
+
+    std::uint64_t totalBits = 0;
+
+    for (size_t context = 0; context < contextFrequencies.size(); ++context)
+    {
+        auto const &lengths = tableLengths[contextMap.tableOf[context]];
 
-    // build tree
-    auto const rootIdx = buildTree(nodes);
-    // Build the code table for a given tree
-    std::unordered_map<cch::byte, std::string> codeTable;
-    generateCodeTable(codeTable, nodes, rootIdx);
+        for (size_t byte = 0; byte < 256; ++byte)
+        {
+            totalBits += contextFrequencies[context][byte] * lengths[byte];
+        }
+    }
 
-    // Compress the data
-    obitstream<std::vector<cch::byte>> compressedData;
-    compressedData.getBuffer().reserve(data.size());
+    std::array<Code const *, 256> codesOf;
 
-    for (auto byte : data)
+    for (size_t context = 0; context < codesOf.size(); ++context)
     {
-        auto const &code = codeTable[byte];
+        codesOf[context] = tableCodes[contextMap.tableOf[context]].data();
+    }
 
-        for (auto const bit : code)
+    // Every flush stores a whole word, the buffer gets one word of slack
+    std::vector<cch::byte> compressedData((totalBits + 7) / 8 + sizeof(std::uint64_t));
+    BitWriter writer{compressedData.data()};
+    previous = 0;
+    size_t i = 0;
+
+    for (; i + 4 <= data.size(); i += 4)
+    {
+        for (size_t k = 0; k < 4; ++k)
         {
-            compressedData.write(bit == '1');
+            auto const code = codesOf[previous][data[i + k]];
+            writer.put(code.bits, code.length);
+            previous = data[i + k];
         }
+
+        writer.flush();
+    }
+
+    for (; i < data.size(); ++i)
+    {
+        auto const code = codesOf[previous][data[i]];
+        writer.put(code.bits, code.length);
+        previous = data[i];
     }
 
-    serailizedFrequencies[0] = compressedData.getBitsWrittenToCurrentByte();
-    compressedData.getBuffer().shrink_to_fit();
+    compressedData.resize(writer.finish() - compressedData.data());
 
-    return std::make_pair(std::move(serailizedFrequencies), std::move(compressedData.extractBuffer()));
+    return std::make_pair(std::move(info), std::move(compressedData));
 }
 
-std::vector<cch::byte> cch::compression::HuffmanCompression::decompressData(
+std::vector<cch::byte> cch::compression::HuffmanCompression::decompressOrder1(
     std::pair<std::span<cch::byte>, std::span<cch::byte>> data)
 {
-    std::vector<cch::byte> decompressedData;
-    decompressedData.reserve(data.second.size() * 1.3);
+    std::span<cch::byte const> const info = data.first;
+    std::span<cch::byte const> const in = data.second;
+
+    if (info.size() < 9)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    std::uint64_t const dataSize = getWord<std::uint64_t>(info.data() + 1);
+
+    if (dataSize == 0)
+    {
+        return {};
+    }
+
+    // Every code takes at least one bit
+    if (dataSize > in.size() * 8 || info.size() < 10)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    size_t const tableCount = info[9] + 1;
+    size_t pos = 10;
 
-    // Restore the frequency table from the compression info
-    auto const frequencyTable = restoreFrequencyTable(data.first);
+    std::array<std::uint8_t, 256> tableOf{};
+
+    for (size_t context = 0; context < 256;)
+    {
+        if (info.size() - pos < 2 || info[pos] >= tableCount || size_t{info[pos + 1]} + 1 > 256 - context)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
 
-    // Initialize nodes
-    auto nodes = initializeNodes(frequencyTable);
-    // Build the tree
-    auto const rootIdx = buildTree(nodes);
+        std::fill_n(tableOf.begin() + context, info[pos + 1] + 1, info[pos]);
+        context += info[pos + 1] + 1;
+        pos += 2;
+    }
 
-    std::unordered_map<size_t, cch::byte> codeTable;
+    size_t const tableSize = size_t{1} << DECODE_TABLE_BITS;
+    std::vector<SymbolEntry> tables(tableCount * tableSize);
 
+    for (size_t table = 0; table < tableCount; ++table)
     {
-        // Generate the code table & inverse it (from byte->code to code->byte)
-        std::unordered_map<cch::byte, std::string> ccodeTable;
-        ccodeTable.reserve(256);
-        generateCodeTable(ccodeTable, nodes, rootIdx);
-        codeTable = inverseCodeTable(std::move(ccodeTable));
+        if (info.size() - pos < 2)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
+
+        size_t const size = getWord<std::uint16_t>(info.data() + pos);
+        pos += 2;
+
+        if (info.size() - pos < size)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
+
+        buildSymbolTable(restoreCodeLengths(info.subspan(pos, size)), std::span(tables).subspan(table * tableSize, tableSize));
+        pos += size;
     }
 
-    // Get the amount of bits used in the last byte of decompressed data
-    char lastByteBits = static_cast<char>(data.first[0]);
+    if (pos != info.size())
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
 
-    // Decompress the data
-    ibitstream in(data.second.begin(), data.second.end());
-    size_t currentHash = cch::hash::djb2::defaultHashValue;
+    std::array<SymbolEntry const *, 256> tableFor;
 
-    while (lastByteBits > 0 && !in.eof())
+    for (size_t context = 0; context < tableFor.size(); ++context)
     {
-        currentHash = cch::hash::djb2::djb2hash(currentHash, in.read() ? '1' : '0');
+        tableFor[context] = tables.data() + tableOf[context] * tableSize;
+    }
+
+    std::vector<cch::byte> decompressedData(dataSize);
+    cch::byte *out = decompressedData.data();
+    cch::byte *const outEnd = out + decompressedData.size();
+    cch::byte previous = 0;
 
-        lastByteBits -= in.isLastByte() ? 1 : 0;
+    BitReader reader{0, 0, in.data(), in.data() + in.size()};
+
+    // Every symbol selects the table of the next one, so a lookup decodes a single symbol
+    while (reader.end - reader.ptr > 8 && outEnd - out >= 4)
+    {
+        reader.refill();
 
-        if (auto it = codeTable.find(currentHash); it != codeTable.end())
+        for (size_t lookup = 0; lookup < (56 / DECODE_TABLE_BITS); ++lookup)
         {
-            decompressedData.push_back(it->second);
-            currentHash = cch::hash::djb2::defaultHashValue;
+            auto const entry = tableFor[previous][reader.bits >> (64 - DECODE_TABLE_BITS)];
+            *out++ = entry.symbol;
+            previous = entry.symbol;
+            reader.consume(entry.length);
         }
     }
 
+    // The symbol count is known so the padding bits are never decoded
+    std::uint64_t const streamBits = in.size() * 8;
+    std::uint64_t consumedBits = (reader.ptr - in.data()) * 8 - reader.bitCount;
+
+    while (out != outEnd)
+    {
+        reader.refillTail();
+
+        auto const entry = tableFor[previous][reader.bits >> (64 - DECODE_TABLE_BITS)];
+        *out++ = entry.symbol;
+        previous = entry.symbol;
+        reader.consume(entry.length);
+        consumedBits += entry.length;
+    }
+
+    // The stream must end in its last byte
+    if (consumedBits > streamBits || streamBits - consumedBits >= 8)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
     return decompressedData;
 }
 
-short cch::compression::HuffmanCompression::buildTree(std::vector<TreeNode> &nodes)
+cch::compression::HuffmanCompression::ContextMap cch::compression::HuffmanCompression::clusterContexts(
+    std::vector<ByteHistogram::Counts> const &contextFrequencies)
 {
-    auto comp = [&nodes](short const a, short const b)
+    // Bits of the serialized code lengths of a table: the size, then every range of used bytes
+    auto const tableBits = [](ByteHistogram::Counts const &frequencies)
+    {
+        size_t bytes = 2;
+
+        for (size_t byte = 0; byte < frequencies.size();)
+        {
+            size_t run = 0;
+
+            while (byte + run < frequencies.size() && frequencies[byte + run] != 0)
+            {
+                ++run;
+            }
+
+            bytes += run == 0 ? 0 : 2 + (run + 1) / 2;
+            byte += run == 0 ? 1 : run;
+        }
+
+        return static_cast<double>(bytes * 8);
+    };
+
+    // Size of the data coded with the probabilities of the model, the entropy when they are its own frequencies
+    auto const entropyBits = [](ByteHistogram::Counts const &frequencies, ByteHistogram::Counts const &model, std::uint64_t const modelTotal)
     {
-        return nodes[a].weigth > nodes[b].weigth;
+        double bits = 0;
+
+        for (size_t byte = 0; byte < frequencies.size(); ++byte)
+        {
+            if (frequencies[byte] != 0)
+            {
+                bits += frequencies[byte] * std::log2(static_cast<double>(modelTotal) / model[byte]);
+            }
+        }
+
+        return bits;
     };
 
-    std::priority_queue<short, std::deque<short>, decltype(comp)> pq{comp};
-    
-    for (size_t i = 0; i < nodes.size(); ++i)
+    ByteHistogram::Counts order0{};
+    std::array<std::uint64_t, 256> contextTotals{};
+
+    for (size_t context = 0; context < contextFrequencies.size(); ++context)
+    {
+        for (size_t byte = 0; byte < 256; ++byte)
+        {
+            order0[byte] += contextFrequencies[context][byte];
+            contextTotals[context] += contextFrequencies[context][byte];
+        }
+    }
+
+    std::uint64_t const order0Total = std::accumulate(contextTotals.begin(), contextTotals.end(), std::uint64_t{0});
+
+    ContextMap contextMap;
+    std::vector<ByteHistogram::Counts> tableFrequencies;
+    std::vector<size_t> sparseContexts;
+
+    for (size_t context = 0; context < contextFrequencies.size(); ++context)
+    {
+        if (contextTotals[context] == 0)
+        {
+            continue;
+        }
+
+        // Both sizes are estimated by the entropy, the code lengths would favour the own table by their rounding
+        auto const &frequencies = contextFrequencies[context];
+        double const ownBits = entropyBits(frequencies, frequencies, contextTotals[context]) + tableBits(frequencies);
+        double const sharedBits = entropyBits(frequencies, order0, order0Total);
+
+        if (ownBits < sharedBits)
+        {
+            contextMap.tableOf[context] = static_cast<std::uint8_t>(tableFrequencies.size());
+            tableFrequencies.push_back(frequencies);
+        }
+        else
+        {
+            sparseContexts.push_back(context);
+        }
+    }
+
+    if (!sparseContexts.empty())
     {
-        if (nodes[i].weigth > 0)
+        // At most 255 dense contexts leave room for the shared table
+        ByteHistogram::Counts shared{};
+
+        for (auto const context : sparseContexts)
         {
-            pq.push(static_cast<short>(i));
+            contextMap.tableOf[context] = static_cast<std::uint8_t>(tableFrequencies.size());
+
+            for (size_t byte = 0; byte < 256; ++byte)
+            {
+                shared[byte] += contextFrequencies[context][byte];
+            }
         }
+
+        tableFrequencies.push_back(shared);
     }
 
-    while (pq.size() != 1)
+    // Move every sparse context to the table coding it in the fewest bits, then rebuild the tables from their contexts.
+    // A table covers the bytes of all its contexts, so the current table is always a candidate
+    for (size_t pass = 0; pass < CLUSTER_PASSES && !sparseContexts.empty(); ++pass)
     {
-        auto l = pq.top();
-        pq.pop();
+        std::vector<CodeLengths> tableLengths(tableFrequencies.size());
+
+        for (size_t table = 0; table < tableFrequencies.size(); ++table)
+        {
+            tableLengths[table] = buildCodeLengths(tableFrequencies[table]);
+        }
+
+        for (auto const context : sparseContexts)
+        {
+            auto const &frequencies = contextFrequencies[context];
+            std::vector<cch::byte> usedBytes;
+
+            for (size_t byte = 0; byte < 256; ++byte)
+            {
+                if (frequencies[byte] != 0)
+                {
+                    usedBytes.push_back(static_cast<cch::byte>(byte));
+                }
+            }
+
+            std::uint64_t bestBits = std::numeric_limits<std::uint64_t>::max();
+
+            for (size_t table = 0; table < tableLengths.size(); ++table)
+            {
+                std::uint64_t bits = 0;
+
+                for (auto const byte : usedBytes)
+                {
+                    bits = tableLengths[table][byte] == 0 ? std::numeric_limits<std::uint64_t>::max() : bits + frequencies[byte] * tableLengths[table][byte];
+
+                    if (bits >= bestBits)
+                    {
+                        break;
+                    }
+                }
+
+                if (bits < bestBits)
+                {
+                    bestBits = bits;
+                    contextMap.tableOf[context] = static_cast<std::uint8_t>(table);
+                }
+            }
+        }
+
+        std::ranges::fill(tableFrequencies, ByteHistogram::Counts{});
+
+        for (size_t context = 0; context < contextFrequencies.size(); ++context)
+        {
+            if (contextTotals[context] != 0)
+            {
+                for (size_t byte = 0; byte < 256; ++byte)
+                {
+                    tableFrequencies[contextMap.tableOf[context]][byte] += contextFrequencies[context][byte];
+                }
+            }
+        }
+    }
+
+    // Drop the tables left without contexts
+    std::array<std::uint8_t, 256> renumbered{};
 
-        auto r = pq.top();
-        pq.pop();
+    for (size_t table = 0; table < tableFrequencies.size(); ++table)
+    {
+        if (std::ranges::any_of(tableFrequencies[table], [](auto const count) { return count != 0; }))
+        {
+            renumbered[table] = static_cast<std::uint8_t>(contextMap.tableCount++);
+        }
+    }
 
-        nodes.emplace_back(nodes[l].weigth + nodes[r].weigth, l, r);
-        pq.push(static_cast<short>(nodes.size() - 1));
+    // Unused contexts take the table of the previous context, which lengthens the runs of the serialized map
+    for (size_t context = 0; context < contextFrequencies.size(); ++context)
+    {
+        if (contextTotals[context] != 0)
+        {
+            contextMap.tableOf[context] = renumbered[contextMap.tableOf[context]];
+        }
+        else
+        {
+            contextMap.tableOf[context] = context == 0 ? 0 : contextMap.tableOf[context - 1];
+        }
     }
 
-    return pq.top();
+    return contextMap;
 }
 
-std::vector<cch::compression::HuffmanCompression::TreeNode> cch::compression::HuffmanCompression::initializeNodes(
-    std::unordered_map<cch::byte, cch::byte> const &frequencyTable)
+std::vector<cch::compression::HuffmanCompression::DecodeEntry> cch::compression::HuffmanCompression::buildDecodeTable(
+    CodeLengths const &lengths)
 {
-    // Create TreeNodes, construct 256 elements (for byte 0x00-0xFF)
-    std::vector<TreeNode> nodes(256);
-    // Reserve memory for intermidiate nodes
-    nodes.reserve(nodes.size() * 2);
+    size_t const mask = (size_t{1} << DECODE_TABLE_BITS) - 1;
+
+    std::vector<SymbolEntry> table(size_t{1} << DECODE_TABLE_BITS);
+    buildSymbolTable(lengths, table);
 
-    // Fill the frequency
-    for (auto [byte, freq] : frequencyTable)
+    // Append the symbols decoded from the rest of the index while their codes fit in it
+    std::vector<DecodeEntry> multiTable(table.size());
+
+    for (size_t index = 0; index < table.size(); ++index)
     {
-        nodes[byte].weigth = freq;
+        auto &entry = multiTable[index];
+        entry.symbols[0] = table[index].symbol;
+        entry.count = 1;
+        entry.length = entry.firstLength = table[index].length;
+
+        while (entry.count < MAX_ENTRY_SYMBOLS)
+        {
+            auto const &next = table[(index << entry.length) & mask];
+
+            if (next.length > DECODE_TABLE_BITS - entry.length)
+            {
+                break;
+            }
+
+            entry.symbols[entry.count++] = next.symbol;
+            entry.length += next.length;
+        }
     }
 
-    return nodes;
+    return multiTable;
 }
 
-void cch::compression::HuffmanCompression::generateCodeTable(
-    std::unordered_map<cch::byte, std::string> &codeTable, std::vector<TreeNode> const &nodes, short const nodeIdx, std::string code)
+void cch::compression::HuffmanCompression::buildSymbolTable(CodeLengths const &lengths, std::span<SymbolEntry> table)
 {
-    if (nodes[nodeIdx].left == -1 || nodes[nodeIdx].right == -1)
+    auto const codes = buildCanonicalCodes(lengths);
+    size_t filled = 0;
+
+    // A code fills all the indices it is a prefix of
+    for (size_t byte = 0; byte < codes.size(); ++byte)
     {
-        if (code.empty())
+        if (codes[byte].length == 0)
         {
-            code = "0";
+            continue;
         }
 
-        codeTable[nodeIdx] = code;
-        return;
+        size_t const shift = DECODE_TABLE_BITS - codes[byte].length;
+        size_t const first = static_cast<size_t>(codes[byte].bits) << shift;
+
+        std::ranges::fill(table.subspan(first, size_t{1} << shift), SymbolEntry{static_cast<cch::byte>(byte), codes[byte].length});
+        filled += size_t{1} << shift;
     }
 
-    generateCodeTable(codeTable, nodes, nodes[nodeIdx].left, code + "0");
-    generateCodeTable(codeTable, nodes, nodes[nodeIdx].right, code + "1");
+    // Only the code of a single used byte leaves indices free, they never occur in valid data
+    std::ranges::fill(table.subspan(filled), table[0]);
 }
 
-std::vector<std::pair<cch::byte, cch::byte>> cch::compression::HuffmanCompression::generateCodeRanges(
-    std::unordered_map<cch::byte, cch::byte> const &frequencyTable)
+cch::compression::HuffmanCompression::CodeLengths cch::compression::HuffmanCompression::buildCodeLengths(
+    ByteHistogram::Counts const &frequencies)
 {
-    std::vector<std::pair<cch::byte, cch::byte>> usedRanges;
+    CodeLengths lengths{};
+
+    // Used bytes sorted by frequency
+    std::vector<cch::byte> symbols;
 
-    // Fill vector of used bytes
-    std::vector<cch::byte> indices;
+    for (size_t byte = 0; byte < frequencies.size(); ++byte)
+    {
+        if (frequencies[byte] != 0)
+        {
+            symbols.push_back(static_cast<cch::byte>(byte));
+        }
+    }
 
-    for (auto [byte, f] : frequencyTable)
+    if (symbols.size() <= 1)
     {
-        if (f > 0)
+        for (auto const symbol : symbols)
         {
-            indices.push_back(byte);
+            lengths[symbol] = 1;
         }
+
+        return lengths;
     }
 
-    std::ranges::sort(indices, std::less<>());
+    std::ranges::stable_sort(symbols, [&frequencies](auto const a, auto const b) { return frequencies[a] < frequencies[b]; });
 
-    // Convert vector of used bytes to ranges format (FirstUsedByte, LastUsedByte)
-    for (size_t i = 0; i < indices.size();)
+    // An item is either a byte (a coin of the deepest denomination) or a package of the two items at index
+    // child and child + 1 of the deeper level
+    struct Item
     {
-        cch::byte start = indices[i];
-        cch::byte end = start;
-        size_t j = i + 1;
+        std::uint64_t weight;
+        int symbol;
+        size_t child;
+    };
+
+    // levels[0] holds the coins of the deepest level, every next level adds the packages of the pairs of the previous one
+    std::vector<std::vector<Item>> levels(MAX_CODE_LENGTH);
 
-        while (j < indices.size())
+    for (size_t level = 0; level < MAX_CODE_LENGTH; ++level)
+    {
+        auto &items = levels[level];
+        items.reserve(symbols.size() * 2);
+        size_t leaf = 0;
+        size_t pair = 0;
+        size_t const pairs = level == 0 ? 0 : levels[level - 1].size() / 2;
+
+        // Merge the bytes and the packages by weight, bytes first on ties
+        while (leaf < symbols.size() || pair < pairs)
         {
-            if (end + 1 == indices[j])
+            std::uint64_t const packageWeight = pair < pairs
+                ? levels[level - 1][pair * 2].weight + levels[level - 1][pair * 2 + 1].weight
+                : 0;
+
+            if (pair == pairs || (leaf < symbols.size() && frequencies[symbols[leaf]] <= packageWeight))
             {
-                end = indices[j++];
+                items.push_back({frequencies[symbols[leaf]], symbols[leaf], 0});
+                ++leaf;
             }
             else
             {
-                break;
+                items.push_back({packageWeight, -1, pair * 2});
+                ++pair;
             }
         }
+    }
 
-        usedRanges.emplace_back(start, end);
+    // The 2n - 2 lightest items of the top level make the optimal code, every occurrence of a byte in the
+    // selected items and their packages adds one bit to its code
+    std::vector<std::pair<size_t, size_t>> pending;
 
-        i = j;
+    for (size_t index = 0; index < symbols.size() * 2 - 2; ++index)
+    {
+        pending.emplace_back(MAX_CODE_LENGTH - 1, index);
     }
 
-    return usedRanges;
+    while (!pending.empty())
+    {
+        auto const [level, index] = pending.back();
+        pending.pop_back();
+        auto const &item = levels[level][index];
+
+        if (item.symbol >= 0)
+        {
+            ++lengths[item.symbol];
+        }
+        else
+        {
+            pending.emplace_back(level - 1, item.child);
+            pending.emplace_back(level - 1, item.child + 1);
+        }
+    }
+
+    return lengths;
 }
 
-std::vector<cch::byte> cch::compression::HuffmanCompression::serializeBytesFrequencies(
-    std::vector<std::pair<cch::byte, cch::byte>> const &rangesOfUsedBytes,
-    std::unordered_map<cch::byte, cch::byte> const &frequencyTable)
+std::array<cch::compression::HuffmanCompression::Code, 256> cch::compression::HuffmanCompression::buildCanonicalCodes(
+    CodeLengths const &lengths)
 {
-    std::vector<cch::byte> serializedByteFrequency;
-    serializedByteFrequency.reserve(512);
+    std::array<size_t, MAX_CODE_LENGTH + 1> lengthCount{};
+
+    for (auto const length : lengths)
+    {
+        ++lengthCount[length];
+    }
 
-    // Reserve the first byte to store the amount of bits used in the last byte of the compressed data
-    serializedByteFrequency.push_back(0x00);
+    lengthCount[0] = 0;
 
-    for (auto [rangeStart, rangeEnd] : rangesOfUsedBytes)
+    // The first code of every length follows the last code of the previous length
+    std::array<std::uint16_t, MAX_CODE_LENGTH + 1> nextCode{};
+    std::uint16_t code = 0;
+
+    for (size_t length = 1; length <= MAX_CODE_LENGTH; ++length)
     {
-        serializedByteFrequency.push_back(rangeStart);
-        serializedByteFrequency.push_back(rangeEnd);
+        code = static_cast<std::uint16_t>((code + lengthCount[length - 1]) << 1);
+        nextCode[length] = code;
+    }
 
-        for (unsigned short idx = rangeStart; idx <= rangeEnd; ++idx)
+    std::array<Code, 256> codes{};
+
+    for (size_t byte = 0; byte < lengths.size(); ++byte)
+    {
+        if (lengths[byte] != 0)
         {
-            serializedByteFrequency.push_back(frequencyTable.find(idx)->second);
+            codes[byte] = {nextCode[lengths[byte]]++, lengths[byte]};
         }
     }
 
-    serializedByteFrequency.shrink_to_fit();
-    return serializedByteFrequency;
+    return codes;
 }
 
-std::unordered_map<cch::byte, cch::byte> cch::compression::HuffmanCompression::restoreFrequencyTable(
-    std::span<cch::byte> const data)
+std::vector<std::pair<cch::byte, cch::byte>> cch::compression::HuffmanCompression::generateCodeRanges(
+    CodeLengths const &lengths)
 {
-    std::unordered_map<cch::byte, cch::byte> byteFrequency;
-    byteFrequency.reserve(256);
+    std::vector<std::pair<cch::byte, cch::byte>> usedRanges;
 
-    for (size_t i = 1; i < data.size() - 1;)
+    // Convert the used bytes to ranges format (FirstUsedByte, LastUsedByte)
+    for (size_t i = 0; i < lengths.size();)
     {
-        unsigned short const startOfRange = data[i];
-        unsigned short const endOfRange = data[i + 1];
+        if (lengths[i] == 0)
+        {
+            ++i;
+            continue;
+        }
+
+        size_t j = i + 1;
 
-        for (size_t c = 0; c <= (endOfRange - startOfRange); ++c)
+        while (j < lengths.size() && lengths[j] != 0)
         {
-            byteFrequency[startOfRange + c] = data[i + 2 + c];
+            ++j;
         }
 
-        i += 3 + (endOfRange - startOfRange);
+        usedRanges.emplace_back(static_cast<cch::byte>(i), static_cast<cch::byte>(j - 1));
+
+        i = j;
     }
 
-    return byteFrequency;
+    return usedRanges;
 }
 
-std::unordered_map<size_t, cch::byte> cch::compression::HuffmanCompression::inverseCodeTable(
-    std::unordered_map<cch::byte, std::string> codeTable)
+void cch::compression::HuffmanCompression::serializeCodeLengths(CodeLengths const &lengths, std::vector<cch::byte> &serializedLengths)
 {
-    std::unordered_map<size_t, cch::byte> inversedTable;
-    inversedTable.reserve(codeTable.size());
-
-    for (auto &[byte, code] : codeTable)
+    for (auto [rangeStart, rangeEnd] : generateCodeRanges(lengths))
     {
-        inversedTable[cch::hash::djb2::djb2hash(code)] = byte;
-    }
+        serializedLengths.push_back(rangeStart);
+        serializedLengths.push_back(rangeEnd);
 
-    return inversedTable;
+        // Two lengths per byte, the first one in the high nibble
+        for (unsigned short idx = rangeStart; idx <= rangeEnd; idx += 2)
+        {
+            cch::byte const second = idx + 1 <= rangeEnd ? lengths[idx + 1] : 0;
+            serializedLengths.push_back(static_cast<cch::byte>((lengths[idx] << 4) | second));
+        }
+    }
 }
 
-std::unordered_map<cch::byte, cch::byte> cch::compression::HuffmanCompression::calculateCharFrequency
-    (std::span<cch::byte> const data)
+cch::compression::HuffmanCompression::CodeLengths cch::compression::HuffmanCompression::restoreCodeLengths(
+    std::span<cch::byte const> const data)
 {
-    std::unordered_map<cch::byte, size_t> frequencyTable;
-    frequencyTable.reserve(256);
+    CodeLengths lengths{};
+    size_t usedBytes = 0;
+    int previousEnd = -1;
 
-    // Init table
-    for (unsigned short i = 0; i <= std::numeric_limits<cch::byte>::max(); ++i)
+    for (size_t i = 0; i < data.size();)
     {
-        frequencyTable[i] = 0;
-    }
+        if (data.size() - i < 2 || data[i] <= previousEnd || data[i + 1] < data[i])
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
 
-    for (auto byte : data)
-    {
-        frequencyTable[byte]++;
-    }
+        unsigned short const startOfRange = data[i];
+        unsigned short const endOfRange = data[i + 1];
+        size_t const rangeSize = endOfRange - startOfRange + 1;
+        i += 2;
+
+        if (data.size() - i < (rangeSize + 1) / 2)
+        {
+            throw std::runtime_error("Corrupted Huffman data");
+        }
 
-    size_t max = 0;
+        for (size_t c = 0; c < rangeSize; ++c)
+        {
+            std::uint8_t const length = c % 2 == 0 ? data[i + c / 2] >> 4 : data[i + c / 2] & 0x0F;
 
-    for (auto [b, f] : frequencyTable)
-    {
-        max = std::max(f, max);
-    }
+            if (length == 0 || length > MAX_CODE_LENGTH)
+            {
+                throw std::runtime_error("Corrupted Huffman data");
+            }
 
-    if (max == 0)
-    {
-        frequencyTable[0] = 1;
-        max = 1;
-    }
+            lengths[startOfRange + c] = length;
+        }
 
-    max = (max / 255) + 1;
+        i += (rangeSize + 1) / 2;
+        usedBytes += rangeSize;
+        previousEnd = endOfRange;
+    }
 
-    std::unordered_map<cch::byte, cch::byte> frequencyTableCompact;
-    frequencyTableCompact.reserve(256);
+    // The table decoder relies on a complete code: every index of the table starts with a valid code
+    std::uint64_t kraftSum = 0;
 
-    for (auto [byte, freq] : frequencyTable)
+    for (auto const length : lengths)
     {
-        frequencyTableCompact[byte] = static_cast<unsigned int>(freq / max);
-
-        if (frequencyTableCompact[byte] == 0 && freq != 0)
+        if (length != 0)
         {
-            frequencyTableCompact[byte] = 1;
+            kraftSum += std::uint64_t{1} << (MAX_CODE_LENGTH - length);
         }
     }
 
-    return frequencyTableCompact;
+    bool const complete = kraftSum == (std::uint64_t{1} << MAX_CODE_LENGTH);
+    bool const singleSymbol = usedBytes == 1 && kraftSum == (std::uint64_t{1} << (MAX_CODE_LENGTH - 1));
+
+    if (!complete && !singleSymbol)
+    {
+        throw std::runtime_error("Corrupted Huffman data");
+    }
+
+    return lengths;
 }
 
 int t(int x)
@@ -40,8 +40,7 @@ std::vector<std::uint32_t> cch::compression::LZWCompression::compress(std::span<
             currentByteSeq.push_back(x);
 
             currentHash = 0;
-            a = 1;
-            b = 0;
+            adler.reset();
 
             calculateHashForElement(x, currentByteSeq.size());
         }
@@ -116,16 +115,14 @@ void cch::compression::LZWCompression::initCompressionDictionary() noexcept
     for (unsigned int i = 0; i <= std::numeric_limits<unsigned char>::max(); ++i)
     {
         currentHash = 0;
-        a = 1;
-        b = 0;
+        adler.reset();
 
         calculateHashForElement(i, 1);
         dictionary[currentHash] = i;
     }
 
     currentHash = 0;
-    a = 1;
-    b = 0;
+    adler.reset();
 }
 
 void cch::compression::LZWCompression::initDecompressionDictionary() noexcept
@@ -140,9 +137,8 @@ void cch::compression::LZWCompression::initDecompressionDictionary() noexcept
 
 void cch::compression::LZWCompression::calculateHashForElement(unsigned char newElement, int index)
 {
-    a = (a + newElement) % MOD_ADLER;
-    b = (b + a) % MOD_ADLER;
+    adler.update(newElement);
     //currentHash = currentHash * 31 + newElement;
-    currentHash = std::hash<size_t>()((b << 16) | a);
+    currentHash = std::hash<size_t>()(adler.digest());
     //currentHash ^= std::hash<size_t>()(static_cast<size_t>(newElement) * index);
 }
\ No newline at end of file
@@ -0,0 +1,559 @@
+#include "dedup/ChunkStore.h"
+#include "hash/CRC32C.h"
+#include "compression/RLECompression.h"
+#include "compression/LZSS.h"
+#include "compression/HuffmanCompression.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_set>
+
+namespace
+{
+    void putWord(cch::byte *ptr, std::uint32_t value)
+    {
+        for (size_t i = 0; i < 4; ++i)
+        {
+            ptr[i] = static_cast<cch::byte>(value >> (i * 8));
+        }
+    }
+
+    std::uint32_t getWord(cch::byte const *ptr)
+    {
+        std::uint32_t value = 0;
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            value |= static_cast<std::uint32_t>(ptr[i]) << (i * 8);
+        }
+
+        return value;
+    }
+
+    cch::hash::SHA256Hash digestFromBytes(cch::byte const *ptr)
+    {
+        std::array<std::uint32_t, 8> parts;
+
+        for (size_t i = 0; i < parts.size(); ++i)
+        {
+            parts[i] = (static_cast<std::uint32_t>(ptr[i * 4]) << 24) | (static_cast<std::uint32_t>(ptr[i * 4 + 1]) << 16) |
+                       (static_cast<std::uint32_t>(ptr[i * 4 + 2]) << 8) | static_cast<std::uint32_t>(ptr[i * 4 + 3]);
+        }
+
+        return cch::hash::SHA256Hash{parts};
+    }
+}
+
+std::array<char, 4> const cch::dedup::ChunkStore::PACK_MAGIC = {'C', 'C', 'H', 'P'};
+
+std::uint64_t cch::dedup::ObjectRecipe::size() const
+{
+    std::uint64_t total = 0;
+
+    for (auto const &chunk : chunks)
+    {
+        total += chunk.length;
+    }
+
+    return total;
+}
+
+cch::dedup::ChunkStore::ChunkStore(std::filesystem::path directory, Options const &options) :
+    directory(std::move(directory)), options(options), chunker(options.chunking)
+{
+    // Recipes and pack records store chunk lengths in 32 bits
+    if (options.chunking.maxSize > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::invalid_argument("The maximal chunk size must not exceed 4 GiB - 1");
+    }
+
+    if (options.codec == Codec::LZSS)
+    {
+        throw std::invalid_argument("The LZSS codec cannot be used for new chunks");
+    }
+
+    std::filesystem::create_directories(this->directory);
+
+    std::vector<std::uint32_t> packs;
+
+    for (auto const &entry : std::filesystem::directory_iterator(this->directory))
+    {
+        auto const name = entry.path().filename().string();
+
+        // pack-XXXXXXXX.pack
+        if (entry.is_regular_file() && name.size() == 18 && name.starts_with("pack-") && name.ends_with(".pack"))
+        {
+            packs.push_back(static_cast<std::uint32_t>(std::stoul(name.substr(5, 8), nullptr, 16)));
+        }
+    }
+
+    // Older packs first, a chunk found again in a newer pack (after an interrupted compaction) is ignored
+    std::sort(packs.begin(), packs.end());
+
+    for (auto pack : packs)
+    {
+        scanPack(pack);
+    }
+
+    // Existing packs are never appended to, the first new chunk starts a new pack
+    nextPack = packs.empty() ? 0 : packs.back() + 1;
+}
+
+cch::dedup::ChunkStore::ChunkStore(std::filesystem::path directory) :
+    ChunkStore(std::move(directory), Options{}) {}
+
+cch::dedup::ObjectRecipe cch::dedup::ChunkStore::put(std::span<cch::byte const> data)
+{
+    std::shared_lock compactionLock(compactionMutex);
+
+    ObjectRecipe recipe;
+    recipe.chunks.reserve(data.size() / options.chunking.averageSize + 1);
+    std::vector<hash::SHA256Hash> writtenByOthers;
+
+    chunker.chunk(data, [&](ChunkRecord const &chunk)
+    {
+        recipe.chunks.push_back({chunk.digest, static_cast<std::uint32_t>(chunk.length)});
+
+        bool isNew;
+
+        {
+            // The first writer to see a chunk claims it, the others only reference it
+            std::lock_guard lock(indexMutex);
+            auto const [it, inserted] = index.try_emplace(chunk.digest);
+            isNew = inserted;
+
+            if (!inserted && it->second.pending)
+            {
+                writtenByOthers.push_back(chunk.digest);
+            }
+        }
+
+        if (isNew)
+        {
+            writeChunk(chunk.digest, data.subspan(chunk.offset, chunk.length));
+        }
+        else
+        {
+            ++dedupedChunks;
+        }
+    });
+
+    logicalBytes += data.size();
+
+    // The recipe is only usable once the chunks claimed by concurrent writers are in the packs too
+    std::unique_lock lock(indexMutex);
+
+    for (auto const &digest : writtenByOthers)
+    {
+        chunkWritten.wait(lock, [&]()
+        {
+            auto const it = index.find(digest);
+            return it == index.end() || !it->second.pending;
+        });
+
+        if (!index.contains(digest))
+        {
+            throw std::runtime_error("A chunk could not be stored by a concurrent writer");
+        }
+    }
+
+    return recipe;
+}
+
+cch::dedup::ObjectRecipe cch::dedup::ChunkStore::putFile(std::filesystem::path const &path)
+{
+    MappedFile const file(path);
+    return put(file.data());
+}
+
+std::vector<cch::byte> cch::dedup::ChunkStore::read(ObjectRecipe const &recipe) const
+{
+    std::shared_lock compactionLock(compactionMutex);
+
+    std::vector<cch::byte> result;
+    result.reserve(recipe.size());
+
+    for (auto const &chunk : recipe.chunks)
+    {
+        IndexEntry entry;
+
+        {
+            std::lock_guard lock(indexMutex);
+            auto const it = index.find(chunk.digest);
+
+            if (it == index.end() || it->second.pending)
+            {
+                throw std::out_of_range("Chunk " + chunk.digest.toString() + " is not in the store");
+            }
+
+            entry = it->second;
+        }
+
+        auto const file = mapPack(entry.pack, entry.offset + RECORD_HEADER_SIZE + entry.storedLength);
+        auto const record = recordAt(*file, chunk.digest, entry);
+        auto const rawLength = getWord(record.data() + 36);
+
+        if (rawLength != chunk.length)
+        {
+            throw std::runtime_error("Chunk " + chunk.digest.toString() + " does not match the recipe");
+        }
+
+        auto const codec = static_cast<Codec>(record[32]);
+        auto const payload = record.subspan(RECORD_HEADER_SIZE);
+        auto const chunkOffset = result.size();
+
+        if (codec == Codec::None)
+        {
+            // Raw chunks are copied straight from the mapping
+            result.insert(result.end(), payload.begin(), payload.end());
+        }
+        else
+        {
+            auto const decoded = decode(codec, payload, rawLength);
+            result.insert(result.end(), decoded.begin(), decoded.end());
+        }
+
+        // The CRC only covers the payload, a codec bug must not hand out wrong bytes
+        if (hash::SHA256::hash(std::span(result).subspan(chunkOffset)) != chunk.digest)
+        {
+            throw std::runtime_error("Chunk " + chunk.digest.toString() + " does not match its digest");
+        }
+    }
+
+    return result;
+}
+
+bool cch::dedup::ChunkStore::contains(hash::SHA256Hash const &digest) const
+{
+    // compact() rewrites and erases index entries holding only the compaction lock
+    std::shared_lock compactionLock(compactionMutex);
+    std::lock_guard lock(indexMutex);
+    auto const it = index.find(digest);
+
+    return it != index.end() && !it->second.pending;
+}
+
+cch::dedup::CompactionResult cch::dedup::ChunkStore::compact(std::span<ObjectRecipe const> liveObjects)
+{
+    std::unique_lock compactionLock(compactionMutex);
+    CompactionResult result;
+
+    std::unordered_set<hash::SHA256Hash, DigestHash> live;
+
+    for (auto const &object : liveObjects)
+    {
+        for (auto const &chunk : object.chunks)
+        {
+            live.insert(chunk.digest);
+        }
+    }
+
+    // Seal the current pack, live chunks are copied into fresh packs
+    {
+        std::lock_guard lock(packMutex);
+        packStream.close();
+    }
+
+    std::unordered_map<std::uint32_t, std::uint64_t> deadBytes;
+
+    for (auto const &[digest, entry] : index)
+    {
+        if (!live.contains(digest))
+        {
+            deadBytes[entry.pack] += RECORD_HEADER_SIZE + entry.storedLength;
+        }
+    }
+
+    // Only the packs with dead chunks are rewritten, their live records are copied as they are
+    for (auto &[digest, entry] : index)
+    {
+        if (deadBytes.contains(entry.pack) && live.contains(digest))
+        {
+            auto const file = mapPack(entry.pack, entry.offset + RECORD_HEADER_SIZE + entry.storedLength);
+            auto const record = recordAt(*file, digest, entry);
+            std::tie(entry.pack, entry.offset) = appendRecord(record);
+        }
+    }
+
+    {
+        std::lock_guard lock(packMutex);
+        packStream.close();
+    }
+
+    for (auto it = index.begin(); it != index.end();)
+    {
+        if (!live.contains(it->first))
+        {
+            result.reclaimedBytes += RECORD_HEADER_SIZE + it->second.storedLength;
+            ++result.removedChunks;
+            it = index.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // The copies are flushed, the old packs can go
+    std::lock_guard lock(mappingMutex);
+
+    for (auto const &[pack, bytes] : deadBytes)
+    {
+        mappings.erase(pack);
+        std::filesystem::remove(packPath(pack));
+        ++result.rewrittenPacks;
+    }
+
+    return result;
+}
+
+cch::dedup::ChunkStoreStatistics cch::dedup::ChunkStore::statistics() const
+{
+    ChunkStoreStatistics statistics;
+    statistics.logicalBytes = logicalBytes;
+    statistics.newChunks = newChunks;
+    statistics.dedupedChunks = dedupedChunks;
+    statistics.writtenBytes = writtenBytes;
+
+    std::shared_lock compactionLock(compactionMutex);
+    std::lock_guard lock(indexMutex);
+    statistics.uniqueChunks = index.size();
+
+    return statistics;
+}
+
+std::pair<cch::dedup::ChunkStore::Codec, std::vector<cch::byte>> cch::dedup::ChunkStore::encode(std::span<cch::byte const> chunk) const
+{
+    // The codecs take mutable spans
+    std::vector<cch::byte> input(chunk.begin(), chunk.end());
+    std::vector<cch::byte> encoded;
+
+    switch (options.codec)
+    {
+        case Codec::None:
+        case Codec::LZSS:
+            // LZSS is rejected by the constructor
+            break;
+        case Codec::RLE:
+            encoded = compression::RLECompression().compress(input);
+            break;
+        case Codec::Huffman:
+        {
+            // The code description and the code stream are stored one after another
+            auto const [description, code] = compression::HuffmanCompression().compress(input, std::launch::deferred).get();
+            encoded.resize(4 + description.size() + code.size());
+            putWord(encoded.data(), static_cast<std::uint32_t>(description.size()));
+            std::copy(description.begin(), description.end(), encoded.begin() + 4);
+            std::copy(code.begin(), code.end(), encoded.begin() + 4 + description.size());
+            break;
+        }
+    }
+
+    if (encoded.empty() || encoded.size() >= chunk.size())
+    {
+        return {Codec::None, std::move(input)};
+    }
+
+    return {options.codec, std::move(encoded)};
+}
+
+std::vector<cch::byte> cch::dedup::ChunkStore::decode(Codec codec, std::span<cch::byte const> payload, std::uint32_t rawLength)
+{
+    std::vector<cch::byte> input(payload.begin(), payload.end());
+    std::vector<cch::byte> decoded;
+
+    switch (codec)
+    {
+        case Codec::None:
+            decoded = std::move(input);
+            break;
+        case Codec::RLE:
+            decoded = compression::RLECompression().decompress(input);
+            break;
+        case Codec::LZSS:
+            decoded = compression::LZSS().decompress(input);
+            break;
+        case Codec::Huffman:
+        {
+            std::uint32_t const descriptionSize = input.size() >= 4 ? getWord(input.data()) : 0;
+
+            if (input.size() < 4 || descriptionSize > input.size() - 4)
+            {
+                throw std::runtime_error("Corrupted Huffman chunk");
+            }
+
+            std::span<cch::byte> const description(input.data() + 4, descriptionSize);
+            std::span<cch::byte> const code(input.data() + 4 + descriptionSize, input.size() - 4 - descriptionSize);
+            decoded = compression::HuffmanCompression().decompress({description, code}, std::launch::deferred).get();
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown chunk codec");
+    }
+
+    if (decoded.size() != rawLength)
+    {
+        throw std::runtime_error("Chunk decoded to a wrong size");
+    }
+
+    return decoded;
+}
+
+void cch::dedup::ChunkStore::writeChunk(hash::SHA256Hash const &digest, std::span<cch::byte const> chunk)
+{
+    try
+    {
+        // Compression runs concurrently in every writer, only the append is serialized
+        auto const [codec, payload] = encode(chunk);
+
+        std::vector<cch::byte> record(RECORD_HEADER_SIZE + payload.size());
+        auto const digestBytes = digest.toBytes();
+        std::copy(digestBytes.begin(), digestBytes.end(), record.begin());
+        record[32] = static_cast<cch::byte>(codec);
+        putWord(record.data() + 36, static_cast<std::uint32_t>(chunk.size()));
+        putWord(record.data() + 40, static_cast<std::uint32_t>(payload.size()));
+        putWord(record.data() + 44, hash::CRC32C::hash(payload));
+        std::copy(payload.begin(), payload.end(), record.begin() + RECORD_HEADER_SIZE);
+
+        auto const [pack, offset] = appendRecord(record);
+
+        {
+            std::lock_guard lock(indexMutex);
+            index[digest] = IndexEntry{pack, offset, static_cast<std::uint32_t>(payload.size()), false};
+        }
+
+        ++newChunks;
+        writtenBytes += record.size();
+    }
+    catch (...)
+    {
+        // Release the claim so the writers waiting for the chunk do not wait forever
+        {
+            std::lock_guard lock(indexMutex);
+            index.erase(digest);
+        }
+
+        chunkWritten.notify_all();
+        throw;
+    }
+
+    chunkWritten.notify_all();
+}
+
+std::pair<std::uint32_t, std::uint64_t> cch::dedup::ChunkStore::appendRecord(std::span<cch::byte const> record)
+{
+    std::lock_guard lock(packMutex);
+
+    if (!packStream.is_open() || (currentPackSize + record.size() > options.maxPackSize && currentPackSize > PACK_HEADER_SIZE))
+    {
+        startPack();
+    }
+
+    std::uint64_t const offset = currentPackSize;
+
+    // Flushed right away, readers map the pack as soon as the chunk is in the index
+    packStream.write(reinterpret_cast<char const *>(record.data()), static_cast<std::streamsize>(record.size()));
+    packStream.flush();
+
+    if (!packStream)
+    {
+        throw std::runtime_error("Cannot write to " + packPath(currentPack).string());
+    }
+
+    currentPackSize += record.size();
+    return {currentPack, offset};
+}
+
+void cch::dedup::ChunkStore::startPack()
+{
+    packStream.close();
+    currentPack = nextPack++;
+    packStream.open(packPath(currentPack), std::ios::binary | std::ios::out | std::ios::trunc);
+
+    std::array<char, PACK_HEADER_SIZE> header{};
+    std::copy(PACK_MAGIC.begin(), PACK_MAGIC.end(), header.begin());
+    header[4] = static_cast<char>(PACK_VERSION);
+    packStream.write(header.data(), header.size());
+
+    if (!packStream)
+    {
+        throw std::runtime_error("Cannot create " + packPath(currentPack).string());
+    }
+
+    currentPackSize = PACK_HEADER_SIZE;
+}
+
+std::shared_ptr<cch::MappedFile const> cch::dedup::ChunkStore::mapPack(std::uint32_t pack, std::uint64_t minSize) const
+{
+    std::lock_guard lock(mappingMutex);
+    auto &mapping = mappings[pack];
+
+    // The current pack grows after it is mapped, readers holding the old mapping keep it alive
+    if (!mapping || mapping->size() < minSize)
+    {
+        mapping = std::make_shared<MappedFile const>(packPath(pack));
+
+        if (mapping->size() < minSize)
+        {
+            throw std::runtime_error(packPath(pack).string() + " is truncated");
+        }
+    }
+
+    return mapping;
+}
+
+std::span<cch::byte const> cch::dedup::ChunkStore::recordAt(MappedFile const &file, hash::SHA256Hash const &digest, IndexEntry const &entry) const
+{
+    auto const record = file.data().subspan(entry.offset, RECORD_HEADER_SIZE + entry.storedLength);
+    auto const payload = record.subspan(RECORD_HEADER_SIZE);
+
+    if (digestFromBytes(record.data()) != digest || getWord(record.data() + 40) != entry.storedLength ||
+        getWord(record.data() + 44) != hash::CRC32C::hash(payload))
+    {
+        throw std::runtime_error("Chunk " + digest.toString() + " is corrupted in " + packPath(entry.pack).string());
+    }
+
+    return record;
+}
+
+void cch::dedup::ChunkStore::scanPack(std::uint32_t pack)
+{
+    auto const file = std::make_shared<MappedFile const>(packPath(pack));
+    auto const data = file->data();
+
+    if (data.size() < PACK_HEADER_SIZE || !std::equal(PACK_MAGIC.begin(), PACK_MAGIC.end(), data.begin()) || data[4] != PACK_VERSION)
+    {
+        throw std::runtime_error(packPath(pack).string() + " is not a chunk pack");
+    }
+
+    // Only the record headers are read, the payloads are checked when they are read.
+    // A record cut short by an interrupted write ends the scan
+    std::uint64_t offset = PACK_HEADER_SIZE;
+
+    while (data.size() - offset >= RECORD_HEADER_SIZE)
+    {
+        cch::byte const *header = data.data() + offset;
+        std::uint32_t const storedLength = getWord(header + 40);
+
+        if (data.size() - offset - RECORD_HEADER_SIZE < storedLength)
+        {
+            break;
+        }
+
+        index.try_emplace(digestFromBytes(header), IndexEntry{pack, offset, storedLength, false});
+        offset += RECORD_HEADER_SIZE + storedLength;
+    }
+
+    mappings[pack] = file;
+}
+
+std::filesystem::path cch::dedup::ChunkStore::packPath(std::uint32_t pack) const
+{
+    std::stringstream name;
+    name << "pack-" << std::setw(8) << std::setfill('0') << std::hex << pack << ".pack";
+
+    return directory / name.str();
+}
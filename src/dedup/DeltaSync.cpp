@@ -0,0 +1,607 @@
+#include "dedup/DeltaSync.h"
+#include "hash/Adler32.h"
+#include "hash/MD5.h"
+#include "hash/SHA256.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+
+namespace
+{
+    /// Serialized signature: magic | version | strong hash | 2 reserved | block size (4) | file size (8) |
+    /// weak checksum (4) and strong digest of every block. Numbers are little endian
+    std::array<char, 4> const SIGNATURE_MAGIC = {'C', 'C', 'H', 'G'};
+    /// Delta: magic | version | 3 reserved | block size (4) | basis size (8) | instructions
+    std::array<char, 4> const DELTA_MAGIC = {'C', 'C', 'H', 'D'};
+    cch::byte const FORMAT_VERSION = 1;
+    size_t const HEADER_SIZE = 4 + 4 + 4 + 8;
+
+    template <typename Word>
+    cch::byte *putWord(cch::byte *out, Word word)
+    {
+        for (size_t i = 0; i < sizeof(Word); ++i)
+        {
+            *out++ = static_cast<cch::byte>(word >> (i * 8));
+        }
+
+        return out;
+    }
+
+    template <typename Word>
+    Word getWord(cch::byte const *in)
+    {
+        Word word = 0;
+
+        for (size_t i = 0; i < sizeof(Word); ++i)
+        {
+            word |= static_cast<Word>(in[i]) << (i * 8);
+        }
+
+        return word;
+    }
+
+    /// \return number of bytes read, less than the size only at the end of the stream
+    size_t readSome(std::istream &in, cch::byte *data, size_t size)
+    {
+        in.read(reinterpret_cast<char *>(data), static_cast<std::streamsize>(size));
+
+        if (in.bad())
+        {
+            throw std::runtime_error("Cannot read the input stream");
+        }
+
+        return static_cast<size_t>(in.gcount());
+    }
+
+    void writeAll(std::ostream &out, cch::byte const *data, size_t size)
+    {
+        if (!out.write(reinterpret_cast<char const *>(data), static_cast<std::streamsize>(size)))
+        {
+            throw std::runtime_error("Cannot write the output stream");
+        }
+    }
+
+    std::ifstream openInput(std::filesystem::path const &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            throw std::runtime_error("Cannot open " + path.string());
+        }
+
+        return file;
+    }
+
+    std::ofstream openOutput(std::filesystem::path const &path)
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+        {
+            throw std::runtime_error("Cannot create " + path.string());
+        }
+
+        return file;
+    }
+}
+
+void cch::dedup::Signature::write(std::ostream &out) const
+{
+    std::array<cch::byte, HEADER_SIZE> header{};
+    auto it = std::copy(SIGNATURE_MAGIC.begin(), SIGNATURE_MAGIC.end(), header.begin());
+    *it++ = FORMAT_VERSION;
+    *it++ = static_cast<cch::byte>(strongHash);
+    it += 2;
+    it = putWord(it, blockSize);
+    putWord(it, fileSize);
+    writeAll(out, header.data(), header.size());
+
+    std::vector<cch::byte> entry(4 + strongSize());
+
+    for (auto const &block : blocks)
+    {
+        putWord(entry.data(), block.weak);
+        std::copy_n(block.strong.begin(), strongSize(), entry.begin() + 4);
+        writeAll(out, entry.data(), entry.size());
+    }
+}
+
+cch::dedup::Signature cch::dedup::Signature::read(std::istream &in)
+{
+    std::array<cch::byte, HEADER_SIZE> header;
+
+    if (readSome(in, header.data(), header.size()) != header.size() ||
+        !std::equal(SIGNATURE_MAGIC.begin(), SIGNATURE_MAGIC.end(), header.begin()))
+    {
+        throw std::invalid_argument("The data is not a delta signature");
+    }
+
+    Signature signature;
+    signature.strongHash = static_cast<StrongHash>(header[5]);
+    signature.blockSize = getWord<std::uint32_t>(header.data() + 8);
+    signature.fileSize = getWord<std::uint64_t>(header.data() + 12);
+
+    if (header[4] != FORMAT_VERSION || (signature.strongHash != StrongHash::MD5 && signature.strongHash != StrongHash::SHA256) ||
+        signature.blockSize == 0)
+    {
+        throw std::invalid_argument("Unsupported delta signature format");
+    }
+
+    std::uint64_t const blockCount = (signature.fileSize + signature.blockSize - 1) / signature.blockSize;
+    std::vector<cch::byte> entry(4 + signature.strongSize());
+
+    for (std::uint64_t i = 0; i < blockCount; ++i)
+    {
+        if (readSome(in, entry.data(), entry.size()) != entry.size())
+        {
+            throw std::invalid_argument("Truncated delta signature");
+        }
+
+        auto &block = signature.blocks.emplace_back();
+        block.weak = getWord<std::uint32_t>(entry.data());
+        std::copy(entry.begin() + 4, entry.end(), block.strong.begin());
+    }
+
+    return signature;
+}
+
+size_t cch::dedup::DeltaSync::blockSizeFor(std::uint64_t fileSize)
+{
+    // Rounded to a multiple of 8 like in rsync
+    auto const root = static_cast<size_t>(std::sqrt(static_cast<double>(fileSize)));
+    return std::clamp((root + 7) & ~size_t{7}, MIN_BLOCK_SIZE, MAX_BLOCK_SIZE);
+}
+
+cch::dedup::Signature cch::dedup::DeltaSync::signature(std::istream &basis, size_t blockSize, StrongHash strongHash)
+{
+    if (blockSize == 0 || blockSize > 0xFFFFFFFF)
+    {
+        throw std::invalid_argument("Block size must be between 1 and 2^32 - 1");
+    }
+
+    Signature signature;
+    signature.blockSize = static_cast<std::uint32_t>(blockSize);
+    signature.strongHash = strongHash;
+
+    // Batches of blocks, their strong digests are computed together
+    std::vector<cch::byte> buffer(SIGNATURE_BATCH * blockSize);
+    std::vector<std::span<cch::byte const>> blocks;
+
+    while (true)
+    {
+        size_t const size = readSome(basis, buffer.data(), buffer.size());
+
+        blocks.clear();
+
+        for (size_t offset = 0; offset < size; offset += blockSize)
+        {
+            blocks.emplace_back(buffer.data() + offset, std::min(blockSize, size - offset));
+        }
+
+        if (signature.blocks.size() + blocks.size() >= NO_BLOCK)
+        {
+            throw std::invalid_argument("Block size is too small for the basis");
+        }
+
+        size_t const first = signature.blocks.size();
+        signature.blocks.resize(first + blocks.size());
+
+        for (size_t i = 0; i < blocks.size(); ++i)
+        {
+            signature.blocks[first + i].weak = hash::Adler32::hash(blocks[i]);
+        }
+
+        if (strongHash == StrongHash::MD5)
+        {
+            auto const digests = hash::MD5::hashMany(blocks);
+
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                auto const bytes = digests[i].toBytes();
+                std::copy(bytes.begin(), bytes.end(), signature.blocks[first + i].strong.begin());
+            }
+        }
+        else
+        {
+            auto const digests = hash::SHA256::hashMany(blocks);
+
+            for (size_t i = 0; i < blocks.size(); ++i)
+            {
+                signature.blocks[first + i].strong = digests[i].toBytes();
+            }
+        }
+
+        signature.fileSize += size;
+
+        if (size < buffer.size())
+        {
+            return signature;
+        }
+    }
+}
+
+cch::dedup::Signature cch::dedup::DeltaSync::signatureFile(std::filesystem::path const &path, StrongHash strongHash)
+{
+    auto file = openInput(path);
+    return signature(file, blockSizeFor(std::filesystem::file_size(path)), strongHash);
+}
+
+void cch::dedup::DeltaSync::delta(Signature const &signature, std::istream &target, std::ostream &delta)
+{
+    size_t const blockSize = signature.blockSize;
+    BlockIndex const index(signature);
+
+    std::array<cch::byte, HEADER_SIZE> header{};
+    auto it = std::copy(DELTA_MAGIC.begin(), DELTA_MAGIC.end(), header.begin());
+    *it = FORMAT_VERSION;
+    it += 4;
+    it = putWord(it, signature.blockSize);
+    putWord(it, signature.fileSize);
+    writeAll(delta, header.data(), header.size());
+
+    // The buffer holds the pending literal run followed by the window and the data read ahead of it:
+    // [begin, position) is the literal run, [position, position + blockSize) the window, [position, end) the data read so far
+    std::vector<cch::byte> buffer(MAX_LITERAL + 2 * blockSize);
+    size_t begin = 0;
+    size_t position = 0;
+    size_t end = 0;
+    bool endOfInput = false;
+    hash::SHA256 targetDigest;
+
+    // Run of consecutive blocks not written yet
+    std::uint64_t copyStart = 0;
+    std::uint32_t copyCount = 0;
+
+    auto const flushCopy = [&]()
+    {
+        if (copyCount != 0)
+        {
+            std::array<cch::byte, 1 + 8 + 4> instruction;
+            instruction[0] = static_cast<cch::byte>(Instruction::Copy);
+            putWord(putWord(instruction.data() + 1, copyStart), copyCount);
+            writeAll(delta, instruction.data(), instruction.size());
+            copyCount = 0;
+        }
+    };
+
+    auto const flushLiteral = [&](size_t literalEnd)
+    {
+        if (literalEnd != begin)
+        {
+            flushCopy();
+
+            std::array<cch::byte, 1 + 4> instruction;
+            instruction[0] = static_cast<cch::byte>(Instruction::Literal);
+            putWord(instruction.data() + 1, static_cast<std::uint32_t>(literalEnd - begin));
+            writeAll(delta, instruction.data(), instruction.size());
+            writeAll(delta, buffer.data() + begin, literalEnd - begin);
+            begin = literalEnd;
+        }
+    };
+
+    auto const addCopy = [&](std::uint64_t block)
+    {
+        flushLiteral(position);
+
+        if (copyCount != 0 && copyStart + copyCount == block && copyCount != NO_BLOCK)
+        {
+            ++copyCount;
+        }
+        else
+        {
+            flushCopy();
+            copyStart = block;
+            copyCount = 1;
+        }
+    };
+
+    std::optional<hash::RollingAdler32> rolling;
+
+    while (true)
+    {
+        // One byte past the window is needed to roll it
+        if (end - position <= blockSize && !endOfInput)
+        {
+            std::copy(buffer.begin() + begin, buffer.begin() + end, buffer.begin());
+            position -= begin;
+            end -= begin;
+            begin = 0;
+
+            size_t const size = readSome(target, buffer.data() + end, buffer.size() - end);
+            targetDigest.update(std::span<cch::byte const>(buffer.data() + end, size));
+            end += size;
+            endOfInput = end != buffer.size();
+        }
+
+        if (end - position < blockSize)
+        {
+            break;
+        }
+
+        std::span<cch::byte const> const window(buffer.data() + position, blockSize);
+
+        if (!rolling)
+        {
+            rolling.emplace(window);
+        }
+
+        std::uint64_t const preferred = copyCount != 0 ? copyStart + copyCount : 0;
+        std::int64_t const block = index.find(rolling->digest(), window, preferred);
+
+        if (block >= 0)
+        {
+            addCopy(static_cast<std::uint64_t>(block));
+            position += blockSize;
+            begin = position;
+            rolling.reset();
+            continue;
+        }
+
+        if (position - begin == MAX_LITERAL)
+        {
+            flushLiteral(position);
+        }
+
+        if (end - position > blockSize)
+        {
+            rolling->roll(buffer[position], buffer[position + blockSize]);
+        }
+        else
+        {
+            rolling.reset();
+        }
+
+        ++position;
+    }
+
+    // The shorter last block of the basis can only match at the end of the new contents
+    size_t const tail = end - position;
+    bool tailMatched = false;
+
+    if (tail != 0 && !signature.blocks.empty() && signature.fileSize % blockSize == tail)
+    {
+        std::span<cch::byte const> const window(buffer.data() + position, tail);
+        auto const &last = signature.blocks.back();
+
+        if (last.weak == hash::Adler32::hash(window) &&
+            std::equal(last.strong.begin(), last.strong.begin() + signature.strongSize(), strongDigest(signature.strongHash, window).begin()))
+        {
+            addCopy(signature.blocks.size() - 1);
+            tailMatched = true;
+        }
+    }
+
+    flushLiteral(tailMatched ? begin : end);
+    flushCopy();
+
+    std::array<cch::byte, 1 + 32> instruction;
+    instruction[0] = static_cast<cch::byte>(Instruction::End);
+    auto const digest = targetDigest.finalize().toBytes();
+    std::copy(digest.begin(), digest.end(), instruction.begin() + 1);
+    writeAll(delta, instruction.data(), instruction.size());
+}
+
+void cch::dedup::DeltaSync::deltaFile(Signature const &signature, std::filesystem::path const &targetPath, std::filesystem::path const &deltaPath)
+{
+    auto target = openInput(targetPath);
+    auto out = openOutput(deltaPath);
+    delta(signature, target, out);
+}
+
+void cch::dedup::DeltaSync::patch(std::istream &basis, std::istream &delta, std::ostream &out)
+{
+    std::array<cch::byte, HEADER_SIZE> header;
+
+    if (readSome(delta, header.data(), header.size()) != header.size() ||
+        !std::equal(DELTA_MAGIC.begin(), DELTA_MAGIC.end(), header.begin()) || header[4] != FORMAT_VERSION)
+    {
+        throw std::runtime_error("The data is not a supported delta");
+    }
+
+    std::uint64_t const blockSize = getWord<std::uint32_t>(header.data() + 8);
+    std::uint64_t const basisSize = getWord<std::uint64_t>(header.data() + 12);
+
+    basis.seekg(0, std::ios::end);
+    auto const actualSize = basis.tellg();
+
+    if (blockSize == 0 || actualSize < 0 || static_cast<std::uint64_t>(actualSize) != basisSize)
+    {
+        throw std::runtime_error("The delta was not created for this basis");
+    }
+
+    std::uint64_t const blockCount = (basisSize + blockSize - 1) / blockSize;
+    std::vector<cch::byte> buffer(64 * 1024);
+    hash::SHA256 outDigest;
+
+    // Copy through the buffer, the output is hashed on the way
+    auto const copy = [&](std::istream &in, std::uint64_t size)
+    {
+        while (size != 0)
+        {
+            size_t const part = static_cast<size_t>(std::min<std::uint64_t>(size, buffer.size()));
+
+            if (readSome(in, buffer.data(), part) != part)
+            {
+                throw std::runtime_error("Corrupted delta");
+            }
+
+            outDigest.update(std::span<cch::byte const>(buffer.data(), part));
+            writeAll(out, buffer.data(), part);
+            size -= part;
+        }
+    };
+
+    while (true)
+    {
+        cch::byte instruction;
+
+        if (readSome(delta, &instruction, 1) != 1)
+        {
+            throw std::runtime_error("Corrupted delta");
+        }
+
+        switch (static_cast<Instruction>(instruction))
+        {
+            case Instruction::Copy:
+            {
+                std::array<cch::byte, 8 + 4> operands;
+
+                if (readSome(delta, operands.data(), operands.size()) != operands.size())
+                {
+                    throw std::runtime_error("Corrupted delta");
+                }
+
+                std::uint64_t const block = getWord<std::uint64_t>(operands.data());
+                std::uint64_t const count = getWord<std::uint32_t>(operands.data() + 8);
+
+                if (count == 0 || block >= blockCount || count > blockCount - block)
+                {
+                    throw std::runtime_error("Corrupted delta");
+                }
+
+                std::uint64_t const offset = block * blockSize;
+                basis.clear();
+                basis.seekg(static_cast<std::streamoff>(offset));
+                copy(basis, std::min(count * blockSize, basisSize - offset));
+                break;
+            }
+            case Instruction::Literal:
+            {
+                std::array<cch::byte, 4> length;
+
+                if (readSome(delta, length.data(), length.size()) != length.size())
+                {
+                    throw std::runtime_error("Corrupted delta");
+                }
+
+                copy(delta, getWord<std::uint32_t>(length.data()));
+                break;
+            }
+            case Instruction::End:
+            {
+                std::array<cch::byte, 32> expected;
+
+                if (readSome(delta, expected.data(), expected.size()) != expected.size())
+                {
+                    throw std::runtime_error("Corrupted delta");
+                }
+
+                if (outDigest.finalize().toBytes() != expected)
+                {
+                    throw std::runtime_error("Patched data does not match the digest in the delta");
+                }
+
+                return;
+            }
+            default:
+                throw std::runtime_error("Corrupted delta");
+        }
+    }
+}
+
+void cch::dedup::DeltaSync::patchFile(std::filesystem::path const &basisPath, std::filesystem::path const &deltaPath, std::filesystem::path const &outPath)
+{
+    if (std::filesystem::exists(outPath) && std::filesystem::equivalent(basisPath, outPath))
+    {
+        throw std::runtime_error("The patched file must not replace the basis while it is read");
+    }
+
+    auto basis = openInput(basisPath);
+    auto delta = openInput(deltaPath);
+    auto out = openOutput(outPath);
+    patch(basis, delta, out);
+
+    if (!out.flush())
+    {
+        throw std::runtime_error("Cannot write " + outPath.string());
+    }
+}
+
+cch::dedup::DeltaSync::BlockIndex::BlockIndex(Signature const &signature) :
+    signature(signature), filter((size_t{1} << FILTER_BITS) / 64), nextBlock(signature.blocks.size(), NO_BLOCK)
+{
+    // Only whole blocks match inside the data, the shorter last block is checked separately
+    size_t const count = signature.fileSize % signature.blockSize == 0 ? signature.blocks.size() : signature.blocks.size() - 1;
+    firstBlock.reserve(count);
+
+    // Chained from the last one, so every chain is in the order of the file
+    for (size_t i = count; i-- > 0;)
+    {
+        std::uint32_t const weak = signature.blocks[i].weak;
+        filter[filterBit(weak) / 64] |= std::uint64_t{1} << (filterBit(weak) % 64);
+
+        auto const [it, inserted] = firstBlock.try_emplace(weak, static_cast<std::uint32_t>(i));
+
+        if (!inserted)
+        {
+            nextBlock[i] = it->second;
+            it->second = static_cast<std::uint32_t>(i);
+        }
+    }
+}
+
+std::int64_t cch::dedup::DeltaSync::BlockIndex::find(std::uint32_t weak, std::span<cch::byte const> window, std::uint64_t preferred) const
+{
+    if (!(filter[filterBit(weak) / 64] >> (filterBit(weak) % 64) & 1))
+    {
+        return -1;
+    }
+
+    auto const it = firstBlock.find(weak);
+
+    if (it == firstBlock.end())
+    {
+        return -1;
+    }
+
+    // Weak checksums collide, the strong digest of the window is only computed once there is a candidate
+    auto const digest = strongDigest(signature.strongHash, window);
+    size_t const strongSize = signature.strongSize();
+
+    auto const matches = [&](std::uint64_t block)
+    {
+        auto const &candidate = signature.blocks[block];
+        return candidate.weak == weak && std::equal(digest.begin(), digest.begin() + strongSize, candidate.strong.begin());
+    };
+
+    // Continuing the previous run keeps it a single copy instruction
+    if (preferred != 0 && (preferred + 1) * signature.blockSize <= signature.fileSize && matches(preferred))
+    {
+        return static_cast<std::int64_t>(preferred);
+    }
+
+    for (std::uint32_t block = it->second; block != NO_BLOCK; block = nextBlock[block])
+    {
+        if (matches(block))
+        {
+            return block;
+        }
+    }
+
+    return -1;
+}
+
+std::array<cch::byte, 32> cch::dedup::DeltaSync::strongDigest(StrongHash strongHash, std::span<cch::byte const> data)
+{
+    std::array<cch::byte, 32> digest{};
+
+    if (strongHash == StrongHash::MD5)
+    {
+        hash::MD5 md5;
+        md5.update(data);
+        auto const bytes = md5.finalize().toBytes();
+        std::copy(bytes.begin(), bytes.end(), digest.begin());
+    }
+    else
+    {
+        hash::SHA256 sha256;
+        sha256.update(data);
+        digest = sha256.finalize().toBytes();
+    }
+
+    return digest;
+}
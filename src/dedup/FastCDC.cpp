@@ -0,0 +1,167 @@
+#include "dedup/FastCDC.h"
+#include "utilities/MappedFile.h"
+#include <algorithm>
+#include <bit>
+#include <stdexcept>
+
+namespace
+{
+    consteval std::array<std::uint64_t, 256> generateGear(int shift)
+    {
+        // SplitMix64 from a fixed seed, the table is part of the chunk format
+        std::array<std::uint64_t, 256> table{};
+        std::uint64_t state = 0x6A09E667F3BCC908;
+
+        for (auto &entry : table)
+        {
+            state += 0x9E3779B97F4A7C15;
+            std::uint64_t z = state;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            entry = (z ^ (z >> 31)) << shift;
+        }
+
+        return table;
+    }
+}
+
+std::array<std::uint64_t, 256> const cch::dedup::FastCDC::GEAR = generateGear(0);
+std::array<std::uint64_t, 256> const cch::dedup::FastCDC::GEAR_SHIFTED = generateGear(1);
+
+cch::dedup::FastCDC::FastCDC(ChunkingParameters const &parameters) :
+    params(parameters)
+{
+    if (params.minSize < 64 || params.minSize >= params.averageSize || params.averageSize >= params.maxSize)
+    {
+        throw std::invalid_argument("Chunk sizes must satisfy 64 <= minSize < averageSize < maxSize");
+    }
+
+    // A mask of n bits matches once per 2^n bytes on average, the average is rounded down to a power of two.
+    // Two more bits are used below the average and two fewer above it (normalization level 2)
+    size_t const bits = std::bit_width(params.averageSize) - 1;
+    maskSmall = spreadMask(bits + 2);
+    maskLarge = spreadMask(bits - 2);
+}
+
+size_t cch::dedup::FastCDC::nextBoundary(std::span<cch::byte const> data) const
+{
+    if (data.size() <= params.minSize)
+    {
+        return data.size();
+    }
+
+    size_t const size = std::min(data.size(), params.maxSize);
+    size_t const normalSize = std::min(params.averageSize, size);
+    cch::byte const *bytes = data.data();
+
+    // Rolls two bytes per step: after the first, shifted one, the hash is twice the single-step hash,
+    // so it is tested with the shifted mask
+    std::uint64_t const maskSmallShifted = maskSmall << 1;
+    std::uint64_t const maskLargeShifted = maskLarge << 1;
+    std::uint64_t hash = 0;
+    size_t i = params.minSize;
+
+    // Bytes before the minimal size can never be a boundary, they are skipped rather than hashed
+    for (; i + 2 <= normalSize; i += 2)
+    {
+        hash = (hash << 2) + GEAR_SHIFTED[bytes[i]];
+
+        if (!(hash & maskSmallShifted))
+        {
+            return i + 1;
+        }
+
+        hash += GEAR[bytes[i + 1]];
+
+        if (!(hash & maskSmall))
+        {
+            return i + 2;
+        }
+    }
+
+    for (; i + 2 <= size; i += 2)
+    {
+        hash = (hash << 2) + GEAR_SHIFTED[bytes[i]];
+
+        if (!(hash & maskLargeShifted))
+        {
+            return i + 1;
+        }
+
+        hash += GEAR[bytes[i + 1]];
+
+        if (!(hash & maskLarge))
+        {
+            return i + 2;
+        }
+    }
+
+    return size;
+}
+
+void cch::dedup::FastCDC::chunk(std::span<cch::byte const> data, ChunkSink const &sink, std::uint64_t baseOffset) const
+{
+    std::vector<std::span<cch::byte const>> batch;
+    batch.reserve(BATCH_SIZE);
+
+    size_t offset = 0;
+
+    while (offset < data.size())
+    {
+        size_t const batchOffset = offset;
+        batch.clear();
+
+        for (; batch.size() < BATCH_SIZE && offset < data.size(); offset += batch.back().size())
+        {
+            batch.push_back(data.subspan(offset, nextBoundary(data.subspan(offset))));
+        }
+
+        // The batch was just scanned and is still in the cache, hash its chunks in SIMD lanes
+        auto const digests = hash::SHA256::hashMany(batch);
+        std::uint64_t chunkOffset = baseOffset + batchOffset;
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            sink(ChunkRecord{chunkOffset, batch[i].size(), digests[i]});
+            chunkOffset += batch[i].size();
+        }
+    }
+}
+
+std::vector<cch::dedup::ChunkRecord> cch::dedup::FastCDC::chunk(std::span<cch::byte const> data) const
+{
+    std::vector<ChunkRecord> chunks;
+    chunks.reserve(data.size() / params.averageSize + 1);
+
+    chunk(data, [&chunks](ChunkRecord const &record)
+    {
+        chunks.push_back(record);
+    });
+
+    return chunks;
+}
+
+void cch::dedup::FastCDC::chunkFile(std::filesystem::path const &path, ChunkSink const &sink) const
+{
+    MappedFile const file(path);
+    chunk(file.data(), sink);
+}
+
+std::vector<cch::dedup::ChunkRecord> cch::dedup::FastCDC::chunkFile(std::filesystem::path const &path) const
+{
+    MappedFile const file(path);
+    return chunk(file.data());
+}
+
+std::uint64_t cch::dedup::FastCDC::spreadMask(size_t bits)
+{
+    // Bits spaced evenly over [16, 62], the upper bits of a Gear hash depend on the most bytes
+    std::uint64_t mask = 0;
+
+    for (size_t k = 0; k < bits; ++k)
+    {
+        mask |= std::uint64_t{1} << (62 - k * 46 / bits);
+    }
+
+    return mask;
+}
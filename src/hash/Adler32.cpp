@@ -0,0 +1,130 @@
+#include "../include/hash/Adler32.h"
+#include "utilities/CpuFeatures.h"
+#include <algorithm>
+
+std::atomic<cch::hash::Adler32::UpdateFunction> cch::hash::Adler32::updateFunction = &cch::hash::Adler32::updateDispatch;
+
+std::uint32_t cch::hash::Adler32::hash(std::span<cch::byte const> data, std::uint32_t adler)
+{
+    return updateFunction.load(std::memory_order_relaxed)(adler, data.data(), data.size());
+}
+
+std::uint32_t cch::hash::Adler32::combine(std::uint32_t adler1, std::uint32_t adler2, std::uint64_t length2)
+{
+    // The first sum of the second piece starts from 1 instead of the first sum of the first piece,
+    // which adds (a1 - 1) to every term of its second sum
+    std::uint64_t const remainder = length2 % MOD_ADLER;
+    std::uint64_t const a1 = adler1 & 0xFFFF;
+    std::uint64_t const b1 = adler1 >> 16;
+    std::uint64_t const a2 = adler2 & 0xFFFF;
+    std::uint64_t const b2 = adler2 >> 16;
+
+    std::uint64_t const a = (a1 + a2 + MOD_ADLER - 1) % MOD_ADLER;
+    std::uint64_t const b = (b1 + b2 + remainder * a1 + MOD_ADLER - remainder) % MOD_ADLER;
+
+    return static_cast<std::uint32_t>((b << 16) | a);
+}
+
+void cch::hash::Adler32::update(std::span<cch::byte const> data)
+{
+    auto const adler = hash(data, digest());
+
+    a = adler & 0xFFFF;
+    b = adler >> 16;
+}
+
+std::uint32_t cch::hash::Adler32::updateScalar(std::uint32_t adler, cch::byte const *data, size_t size)
+{
+    std::uint32_t a = adler & 0xFFFF;
+    std::uint32_t b = adler >> 16;
+
+    // The reductions are deferred as long as the sums fit in 32 bits
+    while (size > 0)
+    {
+        size_t const blockSize = std::min(size, MAX_DEFERRED);
+        size -= blockSize;
+
+        size_t i = 0;
+
+        for (; i + 4 <= blockSize; i += 4)
+        {
+            a += data[i];
+            b += a;
+            a += data[i + 1];
+            b += a;
+            a += data[i + 2];
+            b += a;
+            a += data[i + 3];
+            b += a;
+        }
+
+        for (; i < blockSize; ++i)
+        {
+            a += data[i];
+            b += a;
+        }
+
+        data += blockSize;
+        a %= MOD_ADLER;
+        b %= MOD_ADLER;
+    }
+
+    return (b << 16) | a;
+}
+
+std::uint32_t cch::hash::Adler32::updateDispatch(std::uint32_t adler, cch::byte const *data, size_t size)
+{
+    setBackend(isSupported(Backend::AVX2) ? Backend::AVX2 : Backend::Scalar);
+    return updateFunction.load(std::memory_order_relaxed)(adler, data, size);
+}
+
+bool cch::hash::Adler32::isSupported(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::Scalar:
+            return true;
+        case Backend::AVX2:
+        #if defined(CCH_ARCH_X86)
+            return CpuFeatures::get().avx2;
+        #else
+            return false;
+        #endif
+    }
+
+    return false;
+}
+
+bool cch::hash::Adler32::setBackend(Backend backend)
+{
+    if (!isSupported(backend))
+    {
+        return false;
+    }
+
+    updateFunction.store(backend == Backend::AVX2 ? &updateAVX2 : &updateScalar, std::memory_order_relaxed);
+    return true;
+}
+
+cch::hash::Adler32::Backend cch::hash::Adler32::getBackend()
+{
+    auto const function = updateFunction.load(std::memory_order_relaxed);
+
+    if (function == &updateDispatch)
+    {
+        // Nothing has been checksummed yet, resolve the default backend now
+        setBackend(isSupported(Backend::AVX2) ? Backend::AVX2 : Backend::Scalar);
+        return getBackend();
+    }
+
+    return function == &updateAVX2 ? Backend::AVX2 : Backend::Scalar;
+}
+
+cch::hash::RollingAdler32::RollingAdler32(std::span<cch::byte const> window) :
+    size(window.size()), windowModulo(static_cast<std::uint32_t>(window.size() % MOD_ADLER))
+{
+    auto const adler = Adler32::hash(window);
+
+    a = adler & 0xFFFF;
+    b = adler >> 16;
+}
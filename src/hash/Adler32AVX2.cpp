@@ -0,0 +1,69 @@
+#include "utilities/CpuFeatures.h"
+#include "../include/hash/Adler32.h"
+
+#if defined(CCH_ARCH_X86)
+#include <immintrin.h>
+#include <algorithm>
+
+// Requires AVX2, the file is compiled with -mavx2 and the kernel is only called
+// when Adler32::isSupported(Backend::AVX2) is true
+std::uint32_t cch::hash::Adler32::updateAVX2(std::uint32_t adler, cch::byte const *data, size_t size)
+{
+    static size_t const CHUNK_SIZE = 32;
+    // The sums are reduced once per block, the lanes of the weighted sum grow by less than 2^15 per chunk
+    // and cannot overflow within a block
+    static size_t const BLOCK_SIZE = MAX_DEFERRED / CHUNK_SIZE * CHUNK_SIZE;
+
+    std::uint64_t a = adler & 0xFFFF;
+    std::uint64_t b = adler >> 16;
+
+    // Byte k of a chunk is added to the second sum (32 - k) times within the chunk
+    __m256i const weights = _mm256_set_epi8(
+        1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16,
+        17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32);
+    __m256i const ones = _mm256_set1_epi16(1);
+    __m256i const zero = _mm256_setzero_si256();
+
+    auto const sum64 = [](__m256i v)
+    {
+        __m128i const half = _mm_add_epi64(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+        return static_cast<std::uint64_t>(_mm_cvtsi128_si64(half)) + static_cast<std::uint64_t>(_mm_extract_epi64(half, 1));
+    };
+
+    while (size >= CHUNK_SIZE)
+    {
+        size_t const blockSize = std::min(size, BLOCK_SIZE) / CHUNK_SIZE * CHUNK_SIZE;
+
+        // Sum of the bytes, sum of the byte sums before every chunk and the weighted sum within the chunks
+        __m256i byteSum = zero;
+        __m256i prefixSum = zero;
+        __m256i weightedSum = zero;
+
+        for (size_t i = 0; i < blockSize; i += CHUNK_SIZE)
+        {
+            __m256i const chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data + i));
+
+            prefixSum = _mm256_add_epi64(prefixSum, byteSum);
+            byteSum = _mm256_add_epi64(byteSum, _mm256_sad_epu8(chunk, zero));
+            weightedSum = _mm256_add_epi32(weightedSum, _mm256_madd_epi16(_mm256_maddubs_epi16(chunk, weights), ones));
+        }
+
+        // Every lane of the weighted sum is below 2^31, widen them before adding
+        __m256i const weightedSum64 = _mm256_add_epi64(_mm256_unpacklo_epi32(weightedSum, zero), _mm256_unpackhi_epi32(weightedSum, zero));
+
+        b = (b + a * blockSize + CHUNK_SIZE * sum64(prefixSum) + sum64(weightedSum64)) % MOD_ADLER;
+        a = (a + sum64(byteSum)) % MOD_ADLER;
+
+        data += blockSize;
+        size -= blockSize;
+    }
+
+    return updateScalar(static_cast<std::uint32_t>((b << 16) | a), data, size);
+}
+#else
+std::uint32_t cch::hash::Adler32::updateAVX2(std::uint32_t adler, cch::byte const *data, size_t size)
+{
+    // Never selected, Adler32::isSupported(Backend::AVX2) is false on other architectures
+    return updateScalar(adler, data, size);
+}
+#endif
@@ -0,0 +1,659 @@
+#include "../include/hash/BLAKE3.h"
+#include "utilities/CpuFeatures.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <future>
+#include <thread>
+
+namespace
+{
+    std::uint32_t loadWord(cch::byte const *ptr)
+    {
+        std::uint32_t word;
+        std::memcpy(&word, ptr, sizeof(word));
+
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = std::byteswap(word);
+        }
+
+        return word;
+    }
+
+    void storeWord(cch::byte *ptr, std::uint32_t word)
+    {
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = std::byteswap(word);
+        }
+
+        std::memcpy(ptr, &word, sizeof(word));
+    }
+
+    /// Multi-lane hashMany on top of a kernel compressing one block per lane
+    /// Groups of Lanes inputs go through the kernel, a single input left over is compressed by the scalar fallback
+    template <size_t Lanes, typename Kernel, typename Fallback>
+    void hashManyLanes(cch::byte const *const *inputs, size_t inputCount, size_t blocks, std::array<std::uint32_t, 8> const &key,
+                       std::uint64_t counter, bool incrementCounter, std::uint8_t flags, std::uint8_t flagsStart,
+                       std::uint8_t flagsEnd, cch::byte *out, Kernel kernel, Fallback fallback)
+    {
+        alignas(64) std::array<std::array<std::uint32_t, Lanes>, 8> cv;
+        alignas(64) std::array<std::array<std::uint32_t, Lanes>, 16> words;
+        alignas(64) std::array<std::uint32_t, Lanes> counterLow;
+        alignas(64) std::array<std::uint32_t, Lanes> counterHigh;
+
+        for (size_t first = 0; first < inputCount; first += Lanes)
+        {
+            size_t const count = std::min(Lanes, inputCount - first);
+            std::uint64_t const groupCounter = counter + (incrementCounter ? first : 0);
+
+            if (count == 1)
+            {
+                fallback(inputs + first, 1, blocks, key, groupCounter, incrementCounter, flags, flagsStart, flagsEnd, out + first * 32);
+                continue;
+            }
+
+            for (size_t l = 0; l < Lanes; ++l)
+            {
+                std::uint64_t const laneCounter = groupCounter + (incrementCounter ? l : 0);
+                counterLow[l] = static_cast<std::uint32_t>(laneCounter);
+                counterHigh[l] = static_cast<std::uint32_t>(laneCounter >> 32);
+
+                for (size_t j = 0; j < 8; ++j)
+                {
+                    cv[j][l] = key[j];
+                }
+            }
+
+            for (size_t block = 0; block < blocks; ++block)
+            {
+                // Idle lanes repeat the first input of the group, their results are dropped
+                for (size_t l = 0; l < Lanes; ++l)
+                {
+                    cch::byte const *data = inputs[first + (l < count ? l : 0)] + block * 64;
+
+                    for (size_t t = 0; t < 16; ++t)
+                    {
+                        words[t][l] = loadWord(data + t * 4);
+                    }
+                }
+
+                std::uint8_t const blockFlags = flags | (block == 0 ? flagsStart : 0) | (block + 1 == blocks ? flagsEnd : 0);
+                kernel(cv, words, counterLow, counterHigh, 64, blockFlags);
+            }
+
+            for (size_t l = 0; l < count; ++l)
+            {
+                for (size_t j = 0; j < 8; ++j)
+                {
+                    storeWord(out + (first + l) * 32 + j * 4, cv[j][l]);
+                }
+            }
+        }
+    }
+}
+
+cch::hash::BLAKE3::ChainingValue const cch::hash::BLAKE3::IV =
+{
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+std::array<std::array<std::uint8_t, 16>, 7> const cch::hash::BLAKE3::MESSAGE_SCHEDULE =
+{{
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+    {2, 6, 3, 10, 7, 0, 4, 13, 1, 11, 12, 5, 9, 14, 15, 8},
+    {3, 4, 10, 12, 13, 2, 7, 14, 6, 5, 9, 0, 11, 15, 8, 1},
+    {10, 7, 12, 9, 14, 3, 13, 15, 4, 0, 11, 2, 5, 8, 1, 6},
+    {12, 13, 9, 11, 15, 10, 14, 8, 7, 2, 5, 3, 0, 1, 6, 4},
+    {9, 14, 11, 5, 8, 12, 15, 1, 13, 3, 0, 10, 2, 6, 4, 7},
+    {11, 15, 5, 0, 1, 9, 8, 6, 14, 10, 2, 12, 3, 4, 7, 13}
+}};
+
+std::array<cch::hash::BLAKE3::Kernel, 3> const cch::hash::BLAKE3::KERNELS =
+{{
+    {Backend::Scalar, 1, &hashManyScalar},
+    {Backend::AVX2, 8, &hashManyAVX2},
+    {Backend::AVX512, 16, &hashManyAVX512}
+}};
+
+std::atomic<cch::hash::BLAKE3::Kernel const *> cch::hash::BLAKE3::selectedKernel = nullptr;
+
+cch::hash::BLAKE3::BLAKE3() :
+    key(IV), flags(0), chunk(IV, 0, 0) {}
+
+cch::hash::BLAKE3::BLAKE3(std::span<cch::byte const, KEY_SIZE> key) :
+    flags(KEYED_HASH), chunk(IV, 0, 0)
+{
+    for (size_t i = 0; i < this->key.size(); ++i)
+    {
+        this->key[i] = loadWord(key.data() + i * 4);
+    }
+
+    chunk = ChunkState(this->key, 0, flags);
+}
+
+cch::hash::BLAKE3Hash cch::hash::BLAKE3::hash(std::span<cch::byte const> data, size_t threadCount)
+{
+    BLAKE3 hasher;
+    hasher.update(data, threadCount);
+
+    return hasher.finalize();
+}
+
+void cch::hash::BLAKE3::update(std::span<cch::byte const> data, size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // Complete the buffered chunk first, it is only finalized once more data follows it
+    if (chunk.length() > 0)
+    {
+        size_t const take = std::min(CHUNK_SIZE - chunk.length(), data.size());
+        chunk.update(data.first(take));
+        data = data.subspan(take);
+
+        if (data.empty())
+        {
+            return;
+        }
+
+        std::array<cch::byte, OUT_SIZE> cv;
+        chunkOutput(chunk).chainingValue(cv.data());
+        pushChainingValue(cv.data(), chunk.counter);
+        chunk = ChunkState(key, chunk.counter + 1, flags);
+    }
+
+    // Hash the largest complete subtrees the data allows, at least one byte is left for the final chunk
+    while (data.size() > CHUNK_SIZE)
+    {
+        std::uint64_t subtreeSize = std::bit_floor(data.size());
+        std::uint64_t const processedSize = chunk.counter * CHUNK_SIZE;
+
+        // A subtree has to start at a multiple of its own size
+        while (((subtreeSize - 1) & processedSize) != 0)
+        {
+            subtreeSize /= 2;
+        }
+
+        std::uint64_t const subtreeChunks = subtreeSize / CHUNK_SIZE;
+
+        if (subtreeSize <= CHUNK_SIZE)
+        {
+            ChunkState subtreeChunk(key, chunk.counter, flags);
+            subtreeChunk.update(data.first(subtreeSize));
+
+            std::array<cch::byte, OUT_SIZE> cv;
+            chunkOutput(subtreeChunk).chainingValue(cv.data());
+            pushChainingValue(cv.data(), chunk.counter);
+        }
+        else
+        {
+            // The root of the subtree may have to be merged with a sibling later, keep its two children
+            std::array<cch::byte, 2 * OUT_SIZE> children;
+            compressSubtreeToParentNode(data.first(subtreeSize), key, chunk.counter, flags, children.data(), threadCount);
+            pushChainingValue(children.data(), chunk.counter);
+            pushChainingValue(children.data() + OUT_SIZE, chunk.counter + subtreeChunks / 2);
+        }
+
+        chunk.counter += subtreeChunks;
+        data = data.subspan(subtreeSize);
+    }
+
+    if (!data.empty())
+    {
+        chunk.update(data);
+        mergeChainingValues(chunk.counter);
+    }
+}
+
+cch::hash::BLAKE3Hash cch::hash::BLAKE3::finalize()
+{
+    BLAKE3Hash result;
+    finalize(result.bytes);
+
+    return result;
+}
+
+void cch::hash::BLAKE3::finalize(std::span<cch::byte> output)
+{
+    Output root;
+
+    if (cvStackSize == 0)
+    {
+        root = chunkOutput(chunk);
+    }
+    else
+    {
+        // Subtrees on the stack are merged lazily, so either the buffered chunk or the top pair is the last node
+        size_t remaining;
+
+        if (chunk.length() > 0)
+        {
+            remaining = cvStackSize;
+            root = chunkOutput(chunk);
+        }
+        else
+        {
+            remaining = cvStackSize - 2;
+            root = parentOutput(cvStack.data() + remaining * OUT_SIZE, key, flags);
+        }
+
+        std::array<cch::byte, 2 * OUT_SIZE> children;
+
+        while (remaining > 0)
+        {
+            --remaining;
+            std::memcpy(children.data(), cvStack.data() + remaining * OUT_SIZE, OUT_SIZE);
+            root.chainingValue(children.data() + OUT_SIZE);
+            root = parentOutput(children.data(), key, flags);
+        }
+    }
+
+    root.rootBytes(output);
+    reset();
+}
+
+void cch::hash::BLAKE3::reset() noexcept
+{
+    chunk = ChunkState(key, 0, flags);
+    cvStackSize = 0;
+}
+
+std::array<std::uint32_t, 16> cch::hash::BLAKE3::compress(ChainingValue const &cv, std::array<std::uint32_t, 16> const &block,
+                                                          std::uint64_t counter, std::uint32_t blockLength, std::uint32_t flags)
+{
+    std::array<std::uint32_t, 16> v =
+    {
+        cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+        IV[0], IV[1], IV[2], IV[3],
+        static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32), blockLength, flags
+    };
+
+    auto const g = [&v](size_t a, size_t b, size_t c, size_t d, std::uint32_t x, std::uint32_t y)
+    {
+        v[a] = v[a] + v[b] + x;
+        v[d] = std::rotr(v[d] ^ v[a], 16);
+        v[c] = v[c] + v[d];
+        v[b] = std::rotr(v[b] ^ v[c], 12);
+        v[a] = v[a] + v[b] + y;
+        v[d] = std::rotr(v[d] ^ v[a], 8);
+        v[c] = v[c] + v[d];
+        v[b] = std::rotr(v[b] ^ v[c], 7);
+    };
+
+    for (auto const &s : MESSAGE_SCHEDULE)
+    {
+        // Columns, then diagonals
+        g(0, 4, 8, 12, block[s[0]], block[s[1]]);
+        g(1, 5, 9, 13, block[s[2]], block[s[3]]);
+        g(2, 6, 10, 14, block[s[4]], block[s[5]]);
+        g(3, 7, 11, 15, block[s[6]], block[s[7]]);
+        g(0, 5, 10, 15, block[s[8]], block[s[9]]);
+        g(1, 6, 11, 12, block[s[10]], block[s[11]]);
+        g(2, 7, 8, 13, block[s[12]], block[s[13]]);
+        g(3, 4, 9, 14, block[s[14]], block[s[15]]);
+    }
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        v[i] ^= v[i + 8];
+        v[i + 8] ^= cv[i];
+    }
+
+    return v;
+}
+
+void cch::hash::BLAKE3::hashManyScalar(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                       std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                       std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out)
+{
+    for (size_t i = 0; i < inputCount; ++i)
+    {
+        ChainingValue cv = key;
+        std::array<std::uint32_t, 16> words;
+
+        for (size_t block = 0; block < blocks; ++block)
+        {
+            for (size_t t = 0; t < words.size(); ++t)
+            {
+                words[t] = loadWord(inputs[i] + block * BLOCK_SIZE + t * 4);
+            }
+
+            std::uint8_t const blockFlags = flags | (block == 0 ? flagsStart : 0) | (block + 1 == blocks ? flagsEnd : 0);
+            auto const state = compress(cv, words, counter + (incrementCounter ? i : 0), BLOCK_SIZE, blockFlags);
+            std::copy_n(state.begin(), cv.size(), cv.begin());
+        }
+
+        for (size_t j = 0; j < cv.size(); ++j)
+        {
+            storeWord(out + i * OUT_SIZE + j * 4, cv[j]);
+        }
+    }
+}
+
+#if defined(CCH_ARCH_X86)
+void cch::hash::BLAKE3::hashManyAVX2(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                     std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                     std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out)
+{
+    hashManyLanes<8>(inputs, inputCount, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out,
+                     &compressLanesAVX2, &hashManyScalar);
+}
+
+void cch::hash::BLAKE3::hashManyAVX512(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                       std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                       std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out)
+{
+    // A group of up to 8 inputs left over takes the narrower kernel
+    size_t const wideCount = inputCount - inputCount % 16 + (inputCount % 16 > 8 ? 16 : 0);
+    size_t const wideInputs = std::min(wideCount, inputCount);
+
+    hashManyLanes<16>(inputs, wideInputs, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out,
+                      &compressLanesAVX512, &hashManyScalar);
+    hashManyAVX2(inputs + wideInputs, inputCount - wideInputs, blocks, key, counter + (incrementCounter ? wideInputs : 0),
+                 incrementCounter, flags, flagsStart, flagsEnd, out + wideInputs * OUT_SIZE);
+}
+#else
+void cch::hash::BLAKE3::hashManyAVX2(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                     std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                     std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out)
+{
+    // Never selected, BLAKE3::isSupported(Backend::AVX2) is false on other architectures
+    hashManyScalar(inputs, inputCount, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out);
+}
+
+void cch::hash::BLAKE3::hashManyAVX512(cch::byte const *const *inputs, size_t inputCount, size_t blocks, ChainingValue const &key,
+                                       std::uint64_t counter, bool incrementCounter, std::uint8_t flags,
+                                       std::uint8_t flagsStart, std::uint8_t flagsEnd, cch::byte *out)
+{
+    // Never selected, BLAKE3::isSupported(Backend::AVX512) is false on other architectures
+    hashManyScalar(inputs, inputCount, blocks, key, counter, incrementCounter, flags, flagsStart, flagsEnd, out);
+}
+#endif
+
+cch::hash::BLAKE3::ChunkState::ChunkState(ChainingValue const &key, std::uint64_t counter, std::uint8_t flags) :
+    cv(key), counter(counter), flags(flags) {}
+
+size_t cch::hash::BLAKE3::ChunkState::length() const
+{
+    return blocksCompressed * BLOCK_SIZE + blockLength;
+}
+
+void cch::hash::BLAKE3::ChunkState::update(std::span<cch::byte const> data)
+{
+    while (!data.empty())
+    {
+        // The last block of a chunk gets CHUNK_END, so a full block is only compressed when more data follows
+        if (blockLength == BLOCK_SIZE)
+        {
+            std::array<std::uint32_t, 16> words;
+
+            for (size_t t = 0; t < words.size(); ++t)
+            {
+                words[t] = loadWord(block.data() + t * 4);
+            }
+
+            auto const state = compress(cv, words, counter, BLOCK_SIZE, flags | (blocksCompressed == 0 ? CHUNK_START : 0));
+            std::copy_n(state.begin(), cv.size(), cv.begin());
+
+            ++blocksCompressed;
+            blockLength = 0;
+            block.fill(0);
+        }
+
+        size_t const take = std::min(BLOCK_SIZE - blockLength, data.size());
+        std::memcpy(block.data() + blockLength, data.data(), take);
+        blockLength += take;
+        data = data.subspan(take);
+    }
+}
+
+void cch::hash::BLAKE3::Output::chainingValue(cch::byte *out) const
+{
+    auto const state = compress(cv, block, counter, blockLength, flags);
+
+    for (size_t j = 0; j < 8; ++j)
+    {
+        storeWord(out + j * 4, state[j]);
+    }
+}
+
+void cch::hash::BLAKE3::Output::rootBytes(std::span<cch::byte> out) const
+{
+    // Every compression of the root node with the next counter gives the next 64 bytes of the output
+    for (std::uint64_t outputCounter = 0; !out.empty(); ++outputCounter)
+    {
+        auto const state = compress(cv, block, outputCounter, blockLength, flags | ROOT);
+        std::array<cch::byte, 64> bytes;
+
+        for (size_t j = 0; j < state.size(); ++j)
+        {
+            storeWord(bytes.data() + j * 4, state[j]);
+        }
+
+        size_t const take = std::min(bytes.size(), out.size());
+        std::memcpy(out.data(), bytes.data(), take);
+        out = out.subspan(take);
+    }
+}
+
+cch::hash::BLAKE3::Output cch::hash::BLAKE3::chunkOutput(ChunkState const &chunk)
+{
+    Output output{chunk.cv, {}, chunk.counter, static_cast<std::uint32_t>(chunk.blockLength),
+                  static_cast<std::uint8_t>(chunk.flags | (chunk.blocksCompressed == 0 ? CHUNK_START : 0) | CHUNK_END)};
+
+    for (size_t t = 0; t < output.block.size(); ++t)
+    {
+        output.block[t] = loadWord(chunk.block.data() + t * 4);
+    }
+
+    return output;
+}
+
+cch::hash::BLAKE3::Output cch::hash::BLAKE3::parentOutput(cch::byte const *children, ChainingValue const &key, std::uint8_t flags)
+{
+    Output output{key, {}, 0, BLOCK_SIZE, static_cast<std::uint8_t>(flags | PARENT)};
+
+    for (size_t t = 0; t < output.block.size(); ++t)
+    {
+        output.block[t] = loadWord(children + t * 4);
+    }
+
+    return output;
+}
+
+size_t cch::hash::BLAKE3::compressChunksParallel(std::span<cch::byte const> input, ChainingValue const &key, std::uint64_t counter,
+                                                 std::uint8_t flags, cch::byte *out)
+{
+    std::array<cch::byte const *, MAX_DEGREE> chunks;
+    size_t chunkCount = 0;
+
+    for (; (chunkCount + 1) * CHUNK_SIZE <= input.size(); ++chunkCount)
+    {
+        chunks[chunkCount] = input.data() + chunkCount * CHUNK_SIZE;
+    }
+
+    kernel().hashMany(chunks.data(), chunkCount, CHUNK_SIZE / BLOCK_SIZE, key, counter, true, flags, CHUNK_START, CHUNK_END, out);
+
+    // The partial chunk at the end, if any, is never the root here
+    if (input.size() > chunkCount * CHUNK_SIZE)
+    {
+        ChunkState partial(key, counter + chunkCount, flags);
+        partial.update(input.subspan(chunkCount * CHUNK_SIZE));
+        chunkOutput(partial).chainingValue(out + chunkCount * OUT_SIZE);
+
+        return chunkCount + 1;
+    }
+
+    return chunkCount;
+}
+
+size_t cch::hash::BLAKE3::compressParentsParallel(cch::byte const *childCVs, size_t childCount, ChainingValue const &key,
+                                                  std::uint8_t flags, cch::byte *out)
+{
+    std::array<cch::byte const *, MAX_DEGREE> parents;
+    size_t const parentCount = childCount / 2;
+
+    for (size_t i = 0; i < parentCount; ++i)
+    {
+        parents[i] = childCVs + i * 2 * OUT_SIZE;
+    }
+
+    kernel().hashMany(parents.data(), parentCount, 1, key, 0, false, flags | PARENT, 0, 0, out);
+
+    if (childCount % 2)
+    {
+        std::memcpy(out + parentCount * OUT_SIZE, childCVs + (childCount - 1) * OUT_SIZE, OUT_SIZE);
+        return parentCount + 1;
+    }
+
+    return parentCount;
+}
+
+size_t cch::hash::BLAKE3::compressSubtreeWide(std::span<cch::byte const> input, ChainingValue const &key, std::uint64_t counter,
+                                              std::uint8_t flags, cch::byte *out, size_t threadCount)
+{
+    if (input.size() <= kernel().degree * CHUNK_SIZE)
+    {
+        return compressChunksParallel(input, key, counter, flags, out);
+    }
+
+    // The left subtree takes the largest power of two number of chunks that leaves at least one byte to the right one
+    size_t const leftSize = std::bit_floor((input.size() - 1) / CHUNK_SIZE) * CHUNK_SIZE;
+    auto const left = input.first(leftSize);
+    auto const right = input.subspan(leftSize);
+    std::uint64_t const rightCounter = counter + leftSize / CHUNK_SIZE;
+
+    // Every half returns at most max(degree, 2) chaining values
+    std::array<cch::byte, 2 * MAX_DEGREE * OUT_SIZE> children;
+    cch::byte *rightChildren = children.data() + MAX_DEGREE * OUT_SIZE;
+    size_t leftCount;
+    size_t rightCount;
+
+    if (threadCount > 1 && input.size() >= MIN_PARALLEL_SIZE)
+    {
+        size_t const leftThreads = threadCount / 2;
+        auto leftResult = std::async(std::launch::async, [&]()
+        {
+            return compressSubtreeWide(left, key, counter, flags, children.data(), leftThreads);
+        });
+
+        rightCount = compressSubtreeWide(right, key, rightCounter, flags, rightChildren, threadCount - leftThreads);
+        leftCount = leftResult.get();
+    }
+    else
+    {
+        leftCount = compressSubtreeWide(left, key, counter, flags, children.data(), 1);
+        rightCount = compressSubtreeWide(right, key, rightCounter, flags, rightChildren, 1);
+    }
+
+    std::memmove(children.data() + leftCount * OUT_SIZE, rightChildren, rightCount * OUT_SIZE);
+
+    // With a single lane the children are returned as they are, so the caller still gets two of them
+    if (leftCount == 1)
+    {
+        std::memcpy(out, children.data(), 2 * OUT_SIZE);
+        return 2;
+    }
+
+    return compressParentsParallel(children.data(), leftCount + rightCount, key, flags, out);
+}
+
+void cch::hash::BLAKE3::compressSubtreeToParentNode(std::span<cch::byte const> input, ChainingValue const &key, std::uint64_t counter,
+                                                    std::uint8_t flags, cch::byte *out, size_t threadCount)
+{
+    std::array<cch::byte, MAX_DEGREE * OUT_SIZE> cvs;
+    std::array<cch::byte, MAX_DEGREE * OUT_SIZE / 2> parents;
+    size_t cvCount = compressSubtreeWide(input, key, counter, flags, cvs.data(), threadCount);
+
+    // Wide kernels return more than two chaining values, reduce them to the children of the root
+    while (cvCount > 2)
+    {
+        cvCount = compressParentsParallel(cvs.data(), cvCount, key, flags, parents.data());
+        std::memcpy(cvs.data(), parents.data(), cvCount * OUT_SIZE);
+    }
+
+    std::memcpy(out, cvs.data(), 2 * OUT_SIZE);
+}
+
+void cch::hash::BLAKE3::pushChainingValue(cch::byte const *cv, std::uint64_t chunkCounter)
+{
+    mergeChainingValues(chunkCounter);
+    std::memcpy(cvStack.data() + cvStackSize * OUT_SIZE, cv, OUT_SIZE);
+    ++cvStackSize;
+}
+
+void cch::hash::BLAKE3::mergeChainingValues(std::uint64_t totalChunks)
+{
+    // Every set bit of the chunk count is a complete subtree, the rest can be merged.
+    // The merge is done only when more data arrives, the last subtree may turn out to be the root
+    size_t const subtrees = std::popcount(totalChunks);
+
+    while (cvStackSize > subtrees)
+    {
+        cch::byte *children = cvStack.data() + (cvStackSize - 2) * OUT_SIZE;
+        parentOutput(children, key, flags).chainingValue(children);
+        --cvStackSize;
+    }
+}
+
+cch::hash::BLAKE3::Kernel const &cch::hash::BLAKE3::kernel()
+{
+    auto const *selected = selectedKernel.load(std::memory_order_relaxed);
+
+    if (selected == nullptr)
+    {
+        // Nothing has been hashed yet, pick the fastest backend
+        for (auto backend : {Backend::AVX512, Backend::AVX2, Backend::Scalar})
+        {
+            if (setBackend(backend))
+            {
+                break;
+            }
+        }
+
+        selected = selectedKernel.load(std::memory_order_relaxed);
+    }
+
+    return *selected;
+}
+
+bool cch::hash::BLAKE3::isSupported(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::Scalar:
+            return true;
+    #if defined(CCH_ARCH_X86)
+        case Backend::AVX2:
+            return CpuFeatures::get().avx2;
+        case Backend::AVX512:
+            // The AVX-512 backend hands the remainder of the inputs to the AVX2 kernel
+            return CpuFeatures::get().avx512f && CpuFeatures::get().avx2;
+    #else
+        default:
+            return false;
+    #endif
+    }
+
+    return false;
+}
+
+bool cch::hash::BLAKE3::setBackend(Backend backend)
+{
+    if (!isSupported(backend))
+    {
+        return false;
+    }
+
+    selectedKernel.store(&KERNELS[static_cast<size_t>(backend)], std::memory_order_relaxed);
+    return true;
+}
+
+cch::hash::BLAKE3::Backend cch::hash::BLAKE3::getBackend()
+{
+    return kernel().backend;
+}
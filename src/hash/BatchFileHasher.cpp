@@ -0,0 +1,569 @@
+#include "hash/BatchFileHasher.h"
+#include "hash/MD5.h"
+#include "hash/SHA256.h"
+#include "hash/SHA512.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+
+#if defined(_WIN32)
+    #include <fstream>
+#else
+    #include <cerrno>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#if defined(CCH_HAS_IO_URING)
+    #include "../utilities/IoUring.h"
+#endif
+
+namespace
+{
+    using Algorithm = cch::hash::BatchFileHasher::Algorithm;
+    using Hasher = std::variant<cch::hash::MD5, cch::hash::SHA256, cch::hash::SHA512>;
+
+    Hasher makeHasher(Algorithm algorithm)
+    {
+        switch (algorithm)
+        {
+            case Algorithm::MD5:
+                return cch::hash::MD5{};
+            case Algorithm::SHA256:
+                return cch::hash::SHA256{};
+            default:
+                return cch::hash::SHA512{};
+        }
+    }
+
+    void update(Hasher &hasher, std::span<cch::byte const> data)
+    {
+        std::visit([data](auto &h) { h.update(data); }, hasher);
+    }
+
+    std::vector<cch::byte> finalize(Hasher &hasher)
+    {
+        return std::visit([](auto &h)
+        {
+            auto const bytes = h.finalize().toBytes();
+            return std::vector<cch::byte>(bytes.begin(), bytes.end());
+        }, hasher);
+    }
+
+    std::string errorMessage(std::filesystem::path const &path, char const *what, int error)
+    {
+        return std::string(what) + " " + path.string() + ": " + std::generic_category().message(error);
+    }
+
+    /// Read buffers aligned to pages, so they can be registered and are usable for direct I/O
+    struct AlignedBuffer
+    {
+        static size_t const inline ALIGNMENT = 4096;
+
+        explicit AlignedBuffer(size_t size) :
+            data(static_cast<cch::byte *>(::operator new(size, std::align_val_t{ALIGNMENT}))) {}
+
+        AlignedBuffer(AlignedBuffer const &) = delete;
+        AlignedBuffer &operator=(AlignedBuffer const &) = delete;
+
+        ~AlignedBuffer()
+        {
+            ::operator delete(data, std::align_val_t{ALIGNMENT});
+        }
+
+        cch::byte *data;
+    };
+
+    /// Read a whole file with blocking reads and hash it
+    /// \return error message, empty on success
+    std::string hashFile(std::filesystem::path const &path, Hasher &hasher, std::span<cch::byte> buffer)
+    {
+    #if defined(_WIN32)
+        std::ifstream file(path, std::ios::binary);
+
+        if (!file)
+        {
+            return "Cannot open " + path.string();
+        }
+
+        while (file)
+        {
+            file.read(reinterpret_cast<char *>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+            update(hasher, buffer.first(static_cast<size_t>(file.gcount())));
+        }
+
+        return file.bad() ? "Cannot read " + path.string() : std::string();
+    #else
+        int const fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0)
+        {
+            return errorMessage(path, "Cannot open", errno);
+        }
+
+    #if defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    #endif
+
+        std::string error;
+
+        for (off_t offset = 0;;)
+        {
+            ssize_t const size = pread(fd, buffer.data(), buffer.size(), offset);
+
+            if (size < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+
+                error = errorMessage(path, "Cannot read", errno);
+                break;
+            }
+
+            if (size == 0)
+            {
+                break;
+            }
+
+            update(hasher, buffer.first(static_cast<size_t>(size)));
+            offset += size;
+        }
+
+        close(fd);
+        return error;
+    #endif
+    }
+}
+
+std::string cch::hash::FileDigest::toString() const
+{
+    std::stringstream ss;
+
+    for (auto x : digest)
+    {
+        ss << std::setw(2) << std::setfill('0') << std::hex << static_cast<int>(x);
+    }
+
+    return ss.str();
+}
+
+cch::hash::BatchFileHasher::BatchFileHasher(Algorithm algorithm, Options const &options) :
+    algorithm(algorithm), options(options)
+{
+    if (options.queueDepth == 0 || options.queueDepth > MAX_QUEUE_DEPTH)
+    {
+        throw std::invalid_argument("Queue depth must be between 1 and " + std::to_string(MAX_QUEUE_DEPTH));
+    }
+
+    if (options.bufferSize == 0 || options.bufferSize > MAX_BUFFER_SIZE)
+    {
+        throw std::invalid_argument("Buffer size must be between 1 byte and 1 GiB");
+    }
+
+    backend = isSupported(options.ioBackend) ? options.ioBackend : IoBackend::Pread;
+}
+
+cch::hash::BatchFileHasher::BatchFileHasher(Algorithm algorithm) :
+    BatchFileHasher(algorithm, Options{}) {}
+
+std::vector<cch::hash::FileDigest> cch::hash::BatchFileHasher::hash(std::span<std::filesystem::path const> paths) const
+{
+    std::vector<FileDigest> results(paths.size());
+
+    if (paths.empty())
+    {
+        return results;
+    }
+
+    size_t threadCount = options.threadCount;
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    threadCount = std::min(threadCount, paths.size());
+
+    if (backend == IoBackend::IoUring)
+    {
+        hashWithIoUring(paths, results, threadCount);
+    }
+    else
+    {
+        hashWithPread(paths, results, threadCount);
+    }
+
+    return results;
+}
+
+bool cch::hash::BatchFileHasher::isSupported(IoBackend backend)
+{
+    switch (backend)
+    {
+        case IoBackend::IoUring:
+        #if defined(CCH_HAS_IO_URING)
+            return cch::detail::IoUring::isSupported();
+        #else
+            return false;
+        #endif
+        case IoBackend::Pread:
+            return true;
+    }
+
+    return false;
+}
+
+void cch::hash::BatchFileHasher::hashWithPread(std::span<std::filesystem::path const> paths, std::vector<FileDigest> &results, size_t threadCount) const
+{
+    std::atomic<size_t> nextFile = 0;
+
+    auto const worker = [&]()
+    {
+        AlignedBuffer const buffer(options.bufferSize);
+
+        for (size_t file = nextFile++; file < paths.size(); file = nextFile++)
+        {
+            Hasher hasher = makeHasher(algorithm);
+            results[file].error = hashFile(paths[file], hasher, {buffer.data, options.bufferSize});
+
+            if (results[file].ok())
+            {
+                results[file].digest = finalize(hasher);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(threadCount - 1);
+
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+
+    worker();
+
+    for (auto &w : workers)
+    {
+        w.get();
+    }
+}
+
+#if defined(CCH_HAS_IO_URING)
+
+void cch::hash::BatchFileHasher::hashWithIoUring(std::span<std::filesystem::path const> paths, std::vector<FileDigest> &results, size_t threadCount) const
+{
+    // The calling thread opens the files and keeps queueDepth reads in flight. Every completed buffer goes to the
+    // worker owning the file; a file has one read in flight at a time and one worker, so its buffers are hashed in order
+    // while the next read of it is already running
+    static std::uint32_t const NO_BUFFER = 0xFFFFFFFF;
+
+    struct Work
+    {
+        size_t file;
+        std::uint32_t buffer;
+        std::uint32_t length;
+        bool last;
+        bool failed;
+    };
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<Work> items;
+        bool closed = false;
+    };
+
+    struct OpenFile
+    {
+        size_t file;
+        int fd;
+        std::uint64_t offset;
+    };
+
+    size_t const queueDepth = std::min(options.queueDepth, paths.size());
+    size_t const bufferCount = 2 * queueDepth;
+    size_t const bufferSize = options.bufferSize;
+
+    // The ring is declared after the buffers, so it is torn down before they are freed
+    AlignedBuffer const memory(bufferCount * bufferSize);
+    std::vector<iovec> buffers(bufferCount);
+    cch::detail::IoUring ring(static_cast<unsigned>(queueDepth));
+
+    for (size_t i = 0; i < bufferCount; ++i)
+    {
+        buffers[i] = {memory.data + i * bufferSize, bufferSize};
+    }
+
+    // Registered buffers are pinned once instead of on every read, without them the reads still work
+    bool const fixedBuffers = ring.registerBuffers(buffers);
+
+    std::mutex freeMutex;
+    std::condition_variable bufferFreed;
+    std::vector<std::uint32_t> freeBuffers(bufferCount);
+
+    for (size_t i = 0; i < bufferCount; ++i)
+    {
+        freeBuffers[i] = static_cast<std::uint32_t>(bufferCount - 1 - i);
+    }
+
+    auto const releaseBuffer = [&](std::uint32_t buffer)
+    {
+        {
+            std::lock_guard lock(freeMutex);
+            freeBuffers.push_back(buffer);
+        }
+
+        bufferFreed.notify_one();
+    };
+
+    std::vector<WorkQueue> queues(threadCount);
+
+    auto const send = [&](Work const &work)
+    {
+        auto &queue = queues[work.file % threadCount];
+
+        {
+            std::lock_guard lock(queue.mutex);
+            queue.items.push_back(work);
+        }
+
+        queue.ready.notify_one();
+    };
+
+    auto const worker = [&](WorkQueue &queue)
+    {
+        std::unordered_map<size_t, Hasher> hashers;
+
+        while (true)
+        {
+            Work work;
+
+            {
+                std::unique_lock lock(queue.mutex);
+                queue.ready.wait(lock, [&]() { return !queue.items.empty() || queue.closed; });
+
+                if (queue.items.empty())
+                {
+                    return;
+                }
+
+                work = queue.items.front();
+                queue.items.pop_front();
+            }
+
+            auto &hasher = hashers.try_emplace(work.file, makeHasher(algorithm)).first->second;
+
+            if (work.buffer != NO_BUFFER)
+            {
+                update(hasher, {static_cast<cch::byte const *>(buffers[work.buffer].iov_base), work.length});
+                releaseBuffer(work.buffer);
+            }
+
+            if (work.last && !work.failed)
+            {
+                results[work.file].digest = finalize(hasher);
+            }
+
+            if (work.last)
+            {
+                hashers.erase(work.file);
+            }
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(threadCount);
+
+    for (auto &queue : queues)
+    {
+        workers.push_back(std::async(std::launch::async, worker, std::ref(queue)));
+    }
+
+    auto const stopWorkers = [&]()
+    {
+        for (auto &queue : queues)
+        {
+            {
+                std::lock_guard lock(queue.mutex);
+                queue.closed = true;
+            }
+
+            queue.ready.notify_one();
+        }
+
+        for (auto &w : workers)
+        {
+            w.wait();
+        }
+    };
+
+    std::vector<OpenFile> slots(queueDepth);
+    std::vector<std::uint32_t> freeSlots(queueDepth);
+    // Open files waiting for a buffer to issue their next read
+    std::deque<std::uint32_t> readable;
+
+    for (size_t i = 0; i < queueDepth; ++i)
+    {
+        freeSlots[i] = static_cast<std::uint32_t>(queueDepth - 1 - i);
+    }
+
+    auto const closeSlot = [&](std::uint32_t slot)
+    {
+        close(slots[slot].fd);
+        freeSlots.push_back(slot);
+    };
+
+    size_t nextFile = 0;
+    size_t inFlight = 0;
+
+    try
+    {
+        while (true)
+        {
+            while (!freeSlots.empty() && nextFile < paths.size())
+            {
+                size_t const file = nextFile++;
+                int const fd = open(paths[file].c_str(), O_RDONLY | O_CLOEXEC);
+
+                if (fd < 0)
+                {
+                    results[file].error = errorMessage(paths[file], "Cannot open", errno);
+                    continue;
+                }
+
+                // As with pread, a file is read until a read returns nothing: procfs files report a size of 0
+                // and a file may grow while it is read
+                std::uint32_t const slot = freeSlots.back();
+                freeSlots.pop_back();
+                slots[slot] = {file, fd, 0};
+                readable.push_back(slot);
+            }
+
+            // Buffers come back from the workers concurrently
+            {
+                std::lock_guard lock(freeMutex);
+
+                while (!readable.empty() && !freeBuffers.empty())
+                {
+                    std::uint32_t const slot = readable.front();
+                    std::uint32_t const buffer = freeBuffers.back();
+                    auto const &current = slots[slot];
+
+                    if (!ring.queueRead(current.fd, buffers[buffer].iov_base, static_cast<unsigned>(bufferSize), current.offset, fixedBuffers ? static_cast<int>(buffer) : -1,
+                                        (static_cast<std::uint64_t>(slot) << 32) | buffer))
+                    {
+                        break;
+                    }
+
+                    readable.pop_front();
+                    freeBuffers.pop_back();
+                    ++inFlight;
+                }
+            }
+
+            if (inFlight == 0)
+            {
+                if (readable.empty())
+                {
+                    // Nothing open and nothing left to open
+                    break;
+                }
+
+                std::unique_lock lock(freeMutex);
+                bufferFreed.wait(lock, [&]() { return !freeBuffers.empty(); });
+                continue;
+            }
+
+            ring.submitAndWait(1);
+
+            cch::detail::IoUring::Completion completion;
+
+            while (ring.popCompletion(completion))
+            {
+                --inFlight;
+
+                auto const slot = static_cast<std::uint32_t>(completion.userData >> 32);
+                auto const buffer = static_cast<std::uint32_t>(completion.userData);
+                auto &current = slots[slot];
+
+                if (completion.result == -EINTR || completion.result == -EAGAIN)
+                {
+                    releaseBuffer(buffer);
+                    readable.push_back(slot);
+                    continue;
+                }
+
+                if (completion.result < 0)
+                {
+                    results[current.file].error = errorMessage(paths[current.file], "Cannot read", -completion.result);
+                    releaseBuffer(buffer);
+                    send({current.file, NO_BUFFER, 0, true, true});
+                    closeSlot(slot);
+                    continue;
+                }
+
+                current.offset += static_cast<std::uint64_t>(completion.result);
+
+                bool const last = completion.result == 0;
+                send({current.file, buffer, static_cast<std::uint32_t>(completion.result), last, false});
+
+                if (last)
+                {
+                    closeSlot(slot);
+                }
+                else
+                {
+                    readable.push_back(slot);
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        stopWorkers();
+
+        for (size_t i = 0; i < slots.size(); ++i)
+        {
+            if (std::find(freeSlots.begin(), freeSlots.end(), i) == freeSlots.end())
+            {
+                close(slots[i].fd);
+            }
+        }
+
+        throw;
+    }
+
+    stopWorkers();
+
+    for (auto &w : workers)
+    {
+        w.get();
+    }
+}
+
+#else
+
+void cch::hash::BatchFileHasher::hashWithIoUring(std::span<std::filesystem::path const> paths, std::vector<FileDigest> &results, size_t threadCount) const
+{
+    // Never selected, BatchFileHasher::isSupported(IoBackend::IoUring) is false without io_uring
+    hashWithPread(paths, results, threadCount);
+}
+
+#endif
@@ -0,0 +1,117 @@
+#include "../include/hash/CRC32C.h"
+#include "utilities/CpuFeatures.h"
+#include <bit>
+#include <cstring>
+
+constexpr std::array<std::array<std::uint32_t, 256>, 8> cch::hash::CRC32C::TABLES = generateTables();
+
+std::atomic<cch::hash::CRC32C::UpdateFunction> cch::hash::CRC32C::updateFunction = &cch::hash::CRC32C::updateDispatch;
+
+std::uint32_t cch::hash::CRC32C::hash(std::span<cch::byte const> data, std::uint32_t crc)
+{
+    // The standard checksum is computed on the inverted register and inverted at the end
+    return ~updateFunction.load(std::memory_order_relaxed)(~crc, data.data(), data.size());
+}
+
+std::uint32_t cch::hash::CRC32C::combine(std::uint32_t crc1, std::uint32_t crc2, std::uint64_t length2)
+{
+    // Appending length2 bytes multiplies the checksum of the first piece by x^(8 * length2),
+    // the conditioning of both pieces cancels out
+    return multiplyModP(xPowerModP(length2 * 8), crc1) ^ crc2;
+}
+
+void cch::hash::CRC32C::update(std::span<cch::byte const> data)
+{
+    state = updateFunction.load(std::memory_order_relaxed)(state, data.data(), data.size());
+}
+
+std::uint32_t cch::hash::CRC32C::finalize()
+{
+    auto const crc = ~state;
+    reset();
+
+    return crc;
+}
+
+void cch::hash::CRC32C::reset() noexcept
+{
+    state = 0xFFFFFFFF;
+}
+
+std::uint32_t cch::hash::CRC32C::updateScalar(std::uint32_t crc, cch::byte const *data, size_t size)
+{
+    // Slicing by 8, every byte of a word is looked up in the table that accounts for the bytes following it
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = std::byteswap(word);
+        }
+
+        word ^= crc;
+
+        crc = TABLES[7][word & 0xFF] ^ TABLES[6][(word >> 8) & 0xFF] ^
+              TABLES[5][(word >> 16) & 0xFF] ^ TABLES[4][(word >> 24) & 0xFF] ^
+              TABLES[3][(word >> 32) & 0xFF] ^ TABLES[2][(word >> 40) & 0xFF] ^
+              TABLES[1][(word >> 48) & 0xFF] ^ TABLES[0][word >> 56];
+    }
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc = (crc >> 8) ^ TABLES[0][(crc ^ data[i]) & 0xFF];
+    }
+
+    return crc;
+}
+
+std::uint32_t cch::hash::CRC32C::updateDispatch(std::uint32_t crc, cch::byte const *data, size_t size)
+{
+    setBackend(isSupported(Backend::SSE42) ? Backend::SSE42 : Backend::Scalar);
+    return updateFunction.load(std::memory_order_relaxed)(crc, data, size);
+}
+
+bool cch::hash::CRC32C::isSupported(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::Scalar:
+            return true;
+        case Backend::SSE42:
+        // The kernel relies on the 64-bit crc32 instruction
+        #if defined(CCH_ARCH_X86) && (defined(__x86_64__) || defined(_M_X64))
+            return CpuFeatures::get().sse42 && CpuFeatures::get().pclmul;
+        #else
+            return false;
+        #endif
+    }
+
+    return false;
+}
+
+bool cch::hash::CRC32C::setBackend(Backend backend)
+{
+    if (!isSupported(backend))
+    {
+        return false;
+    }
+
+    updateFunction.store(backend == Backend::SSE42 ? &updateSSE42 : &updateScalar, std::memory_order_relaxed);
+    return true;
+}
+
+cch::hash::CRC32C::Backend cch::hash::CRC32C::getBackend()
+{
+    auto const function = updateFunction.load(std::memory_order_relaxed);
+
+    if (function == &updateDispatch)
+    {
+        // Nothing has been checksummed yet, resolve the default backend now
+        setBackend(isSupported(Backend::SSE42) ? Backend::SSE42 : Backend::Scalar);
+        return getBackend();
+    }
+
+    return function == &updateSSE42 ? Backend::SSE42 : Backend::Scalar;
+}
@@ -0,0 +1,77 @@
+#include "../include/hash/CRC32C.h"
+#include "utilities/CpuFeatures.h"
+#include <cstring>
+
+#if defined(CCH_ARCH_X86) && (defined(__x86_64__) || defined(_M_X64))
+#include <immintrin.h>
+
+// Requires SSE4.2 and PCLMULQDQ, the file is compiled with the corresponding flags
+// and the kernel is only called when CRC32C::isSupported(Backend::SSE42) is true
+std::uint32_t cch::hash::CRC32C::updateSSE42(std::uint32_t crc, cch::byte const *data, size_t size)
+{
+    // crc32 has a latency of 3 cycles and a throughput of 1, so three independent streams keep the unit busy.
+    // The streams are merged by shifting the checksums of the first two over the data of the following ones:
+    // clmul(crc, x^(8n - 33)) reduced by crc32 is crc * x^(8n) mod P
+    static size_t const LONG_BLOCK = 8192;
+    static size_t const SHORT_BLOCK = 256;
+
+    static constexpr std::uint64_t LONG_SHIFT_1 = xPowerModP(LONG_BLOCK * 8 - 33);
+    static constexpr std::uint64_t LONG_SHIFT_2 = xPowerModP(2 * LONG_BLOCK * 8 - 33);
+    static constexpr std::uint64_t SHORT_SHIFT_1 = xPowerModP(SHORT_BLOCK * 8 - 33);
+    static constexpr std::uint64_t SHORT_SHIFT_2 = xPowerModP(2 * SHORT_BLOCK * 8 - 33);
+
+    auto const load = [](cch::byte const *ptr)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, ptr, sizeof(word));
+
+        return word;
+    };
+
+    std::uint64_t crc0 = crc;
+
+    auto const interleave = [&](size_t blockSize, std::uint64_t shift1, std::uint64_t shift2)
+    {
+        for (; size >= 3 * blockSize; data += 3 * blockSize, size -= 3 * blockSize)
+        {
+            std::uint64_t crc1 = 0;
+            std::uint64_t crc2 = 0;
+
+            for (size_t i = 0; i < blockSize; i += 8)
+            {
+                crc0 = _mm_crc32_u64(crc0, load(data + i));
+                crc1 = _mm_crc32_u64(crc1, load(data + blockSize + i));
+                crc2 = _mm_crc32_u64(crc2, load(data + 2 * blockSize + i));
+            }
+
+            __m128i const shifted0 = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc0), _mm_cvtsi64_si128(shift2), 0x00);
+            __m128i const shifted1 = _mm_clmulepi64_si128(_mm_cvtsi64_si128(crc1), _mm_cvtsi64_si128(shift1), 0x00);
+
+            crc0 = _mm_crc32_u64(0, _mm_cvtsi128_si64(_mm_xor_si128(shifted0, shifted1))) ^ crc2;
+        }
+    };
+
+    interleave(LONG_BLOCK, LONG_SHIFT_1, LONG_SHIFT_2);
+    interleave(SHORT_BLOCK, SHORT_SHIFT_1, SHORT_SHIFT_2);
+
+    for (; size >= 8; data += 8, size -= 8)
+    {
+        crc0 = _mm_crc32_u64(crc0, load(data));
+    }
+
+    auto crc32 = static_cast<std::uint32_t>(crc0);
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        crc32 = _mm_crc32_u8(crc32, data[i]);
+    }
+
+    return crc32;
+}
+#else
+std::uint32_t cch::hash::CRC32C::updateSSE42(std::uint32_t crc, cch::byte const *data, size_t size)
+{
+    // Never selected, CRC32C::isSupported(Backend::SSE42) is false on other architectures
+    return updateScalar(crc, data, size);
+}
+#endif
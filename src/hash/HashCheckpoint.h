@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+#include "config/types.h"
+
+namespace cch::hash::detail
+{
+    /// Serialized layout of an incremental hasher, identical on every platform:
+    ///   magic "CCHS" | format version (1 byte) | algorithm id (1 byte) |
+    ///   state words (little endian) | processed byte count (8 bytes, little endian) |
+    ///   pending bytes (processed byte count modulo the block size)
+    /// The length of the pending data is implied by the byte counter, so a checkpoint has exactly one valid size
+    namespace checkpoint
+    {
+        inline constexpr std::array<cch::byte, 4> MAGIC = {'C', 'C', 'H', 'S'};
+        inline constexpr cch::byte VERSION = 1;
+        inline constexpr size_t HEADER_SIZE = MAGIC.size() + 2;
+
+        enum class Algorithm : cch::byte
+        {
+            MD5 = 1,
+            SHA256 = 2,
+            SHA512 = 3
+        };
+
+        template <typename Word>
+        cch::byte *putWord(cch::byte *out, Word word)
+        {
+            for (size_t i = 0; i < sizeof(Word); ++i)
+            {
+                *out++ = static_cast<cch::byte>(word >> (i * 8));
+            }
+
+            return out;
+        }
+
+        template <typename Word>
+        Word getWord(cch::byte const *in)
+        {
+            Word word = 0;
+
+            for (size_t i = 0; i < sizeof(Word); ++i)
+            {
+                word |= static_cast<Word>(in[i]) << (i * 8);
+            }
+
+            return word;
+        }
+
+        /// \param algorithm algorithm of the hasher
+        /// \param state state words
+        /// \param processedBytes number of bytes passed to the hasher
+        /// \param pending data not hashed yet
+        /// \return serialized checkpoint
+        template <typename Word>
+        std::vector<cch::byte> save(Algorithm algorithm, std::span<Word const> state,
+                                    std::uint64_t processedBytes, std::span<cch::byte const> pending)
+        {
+            std::vector<cch::byte> out(HEADER_SIZE + state.size_bytes() + sizeof(processedBytes) + pending.size());
+
+            auto it = std::copy(MAGIC.begin(), MAGIC.end(), out.data());
+            *it++ = VERSION;
+            *it++ = static_cast<cch::byte>(algorithm);
+
+            for (Word word : state)
+            {
+                it = putWord(it, word);
+            }
+
+            it = putWord(it, processedBytes);
+            std::copy(pending.begin(), pending.end(), it);
+
+            return out;
+        }
+
+        /// Validate a checkpoint and unpack it
+        /// Nothing is written if the checkpoint is rejected
+        /// \param algorithm expected algorithm
+        /// \param data serialized checkpoint
+        /// \param state receives the state words
+        /// \param processedBytes receives the number of processed bytes
+        /// \param pending receives the pending data, its size is the block size
+        /// \return number of pending bytes
+        template <typename Word, size_t StateWords, size_t BlockSize>
+        size_t restore(Algorithm algorithm, std::span<cch::byte const> data, std::span<Word, StateWords> state,
+                       std::uint64_t &processedBytes, std::array<cch::byte, BlockSize> &pending)
+        {
+            size_t const fixedSize = HEADER_SIZE + StateWords * sizeof(Word) + sizeof(std::uint64_t);
+
+            if (data.size() < fixedSize || !std::equal(MAGIC.begin(), MAGIC.end(), data.begin()))
+            {
+                throw std::invalid_argument("Not a hash checkpoint");
+            }
+
+            if (data[MAGIC.size()] != VERSION)
+            {
+                throw std::invalid_argument("Unsupported hash checkpoint version");
+            }
+
+            if (data[MAGIC.size() + 1] != static_cast<cch::byte>(algorithm))
+            {
+                throw std::invalid_argument("Hash checkpoint belongs to a different algorithm");
+            }
+
+            auto const processed = getWord<std::uint64_t>(data.data() + fixedSize - sizeof(std::uint64_t));
+            size_t const pendingBytes = processed % BlockSize;
+
+            if (data.size() != fixedSize + pendingBytes)
+            {
+                throw std::invalid_argument("Hash checkpoint is truncated or corrupted");
+            }
+
+            for (size_t i = 0; i < StateWords; ++i)
+            {
+                state[i] = getWord<Word>(data.data() + HEADER_SIZE + i * sizeof(Word));
+            }
+
+            processedBytes = processed;
+            std::copy(data.begin() + fixedSize, data.end(), pending.begin());
+
+            return pendingBytes;
+        }
+    }
+}
@@ -1,51 +1,20 @@
 #include "../include/hash/MD5.h"
+#include "utilities/CpuFeatures.h"
+#include "MultiBuffer.h"
+#include "HashCheckpoint.h"
 #include <bit>
-#include <vector>
+#include <climits>
 #include <algorithm>
-#include <iterator>
+#include <cstring>
+#include <utility>
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
 #include <assert.h>
 
 using namespace cch::hash;
 
-std::array<unsigned char, 64> const constinit MD5::indexTable = MD5::generateIndexTable();
-
-std::array<std::uint_fast32_t, 64> const constinit MD5::K =
-{
-		0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
-		0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
-		0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
-		0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
-		0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
-		0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
-		0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
-		0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
-		0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
-		0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
-		0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
-		0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
-		0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
-		0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
-		0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
-		0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
-};
-
-std::array<unsigned char, 64> const constinit MD5::r =
-{
-		7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
-		5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
-		4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
-		6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
-};
-
-std::uint_fast32_t MD5::combine(std::uint_fast32_t A, std::uint_fast32_t B, std::uint_fast32_t C, std::uint_fast32_t D, std::uint32_t val, unsigned char i)
-{
-	std::uint_fast32_t res = f(B, C, D, i) + A + K[i] + val;
-	res = std::rotl(res, r[i]);
-	res += B;
-
-	return res;
-}
-
 MD5Hash MD5::hash(std::span<cch::byte> data)
 {
 	MD5Hash hashState;
@@ -54,97 +23,213 @@ MD5Hash MD5::hash(std::span<cch::byte> data)
 	return hashState;
 }
 
-void MD5::hash(std::span<cch::byte> data, MD5Hash &hashState, std::uint64_t inputDataSize)
+std::vector<MD5Hash> MD5::hashMany(std::span<std::span<cch::byte const> const> messages)
+{
+	return hashMany(MD5{}, messages);
+}
+
+std::vector<MD5Hash> MD5::hashMany(MD5 const &prefix, std::span<std::span<cch::byte const> const> messages)
 {
-	for (size_t i = 0; i < (data.size() * CHAR_BIT) / 512; ++i)
+	if (prefix.pendingBytes != 0)
 	{
-		_hashChunk({data.begin(), data.end()}, i, hashState);
+		throw std::invalid_argument("The prefix must end on a block boundary");
 	}
 
-	if ((data.size() * CHAR_BIT) % 512)
+#if defined(CCH_ARCH_X86)
+	if (CpuFeatures::get().avx512f && messages.size() > 8)
 	{
-		inputDataSize *= CHAR_BIT;
+		return detail::hashMany<MD5Hash, 16, std::endian::little, 8>(messages, &hashLanesAVX512, prefix.hashState, prefix.processedBytes);
+	}
 
-		std::vector<cch::byte> remainingBytes;
-		size_t chunkStartIdx = data.size() - data.size() % 64;
-		remainingBytes.reserve(data.size() - chunkStartIdx);
+	if (CpuFeatures::get().avx2 && messages.size() > 1)
+	{
+		return detail::hashMany<MD5Hash, 8, std::endian::little, 8>(messages, &hashLanesAVX2, prefix.hashState, prefix.processedBytes);
+	}
+#endif
 
-		std::copy(data.begin() + chunkStartIdx, data.end(), std::back_inserter(remainingBytes));
+	std::vector<MD5Hash> hashes(messages.size(), prefix.hashState);
 
-		remainingBytes.push_back(0x80);
+	for (size_t i = 0; i < messages.size(); ++i)
+	{
+		hash(messages[i], hashes[i], prefix.processedBytes + messages[i].size());
+	}
 
-		while (remainingBytes.size() * CHAR_BIT % 512 != 448)
-		{
-			remainingBytes.push_back(0x00);
-		}
+	return hashes;
+}
 
-		char const* dataSizePtr = reinterpret_cast<char const *>(&inputDataSize);
-		remainingBytes.insert(remainingBytes.end(), dataSizePtr, dataSizePtr + sizeof(inputDataSize));
+MD5MultipartHash MD5::hashMultipart(std::span<cch::byte const> data, size_t partSize, size_t threadCount)
+{
+	if (partSize == 0)
+	{
+		throw std::invalid_argument("part size must be positive");
+	}
+
+	// An empty upload still consists of one (empty) part
+	size_t const partCount = std::max<size_t>(1, (data.size() + partSize - 1) / partSize);
+
+	MD5MultipartHash result;
+	result.parts.resize(partCount);
+
+	if (threadCount == 0)
+	{
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	threadCount = std::min(threadCount, partCount);
 
-		for (size_t i = 0; i < (remainingBytes.size() * CHAR_BIT) / 512; ++i)
+	// Workers take the next part from a shared counter
+	std::atomic<size_t> nextPart = 0;
+
+	auto const worker = [&]()
+	{
+		for (size_t i = nextPart++; i < partCount; i = nextPart++)
 		{
-			_hashChunk({remainingBytes.begin(), remainingBytes.end()}, i, hashState);
+			size_t const offset = std::min(data.size(), i * partSize);
+			auto const part = data.subspan(offset, std::min(partSize, data.size() - offset));
+
+			hash(part, result.parts[i], part.size());
 		}
+	};
+
+	std::vector<std::future<void>> workers;
+	workers.reserve(threadCount - 1);
+
+	for (size_t i = 1; i < threadCount; ++i)
+	{
+		workers.push_back(std::async(std::launch::async, worker));
 	}
-}
 
-std::uint_fast32_t MD5::f(std::uint_fast32_t B, std::uint_fast32_t C, std::uint_fast32_t D, unsigned char i)
-{
-	if (i >= 0 && i <= 15)
+	worker();
+
+	for (auto &w : workers)
 	{
-		return (B & C) | ((~B) & D);
+		w.get();
 	}
 
-	if (i >= 16 && i <= 31)
+	// Digest of the concatenated binary part digests
+	std::vector<cch::byte> digests;
+	digests.reserve(partCount * 16);
+
+	for (auto const &part : result.parts)
 	{
-		return (B & D) | ((~D) & C);
+		auto const bytes = part.toBytes();
+		digests.insert(digests.end(), bytes.begin(), bytes.end());
 	}
 
-	if (i >= 32 && i <= 47)
+	hash(digests, result.hash, digests.size());
+	return result;
+}
+
+void MD5::update(std::span<cch::byte const> data)
+{
+	processedBytes += data.size();
+
+	// Complete the pending block first
+	if (pendingBytes > 0)
 	{
-		return B ^ C ^ D;
+		size_t const bytesToCopy = std::min(BLOCK_SIZE - pendingBytes, data.size());
+		std::copy_n(data.begin(), bytesToCopy, pendingBlock.begin() + pendingBytes);
+		pendingBytes += bytesToCopy;
+		data = data.subspan(bytesToCopy);
+
+		if (pendingBytes < BLOCK_SIZE)
+		{
+			return;
+		}
+
+		_hashChunk(pendingBlock, 0, hashState);
+		pendingBytes = 0;
 	}
 
-	if (i >= 48 && i <= 63)
+	// Hash the complete blocks in place
+	for (size_t i = 0; i < data.size() / BLOCK_SIZE; ++i)
 	{
-		return C ^ (B | (~D));
+		_hashChunk(data, i, hashState);
 	}
 
-	return 0x00000000;
+	// Keep the tail until more data arrives
+	pendingBytes = data.size() % BLOCK_SIZE;
+	std::copy(data.end() - pendingBytes, data.end(), pendingBlock.begin());
+}
+
+MD5Hash MD5::finalize()
+{
+	hash({pendingBlock.data(), pendingBytes}, hashState, processedBytes);
+
+	auto const result = hashState;
+	reset();
+
+	return result;
+}
+
+void MD5::reset() noexcept
+{
+	hashState = MD5Hash{};
+	pendingBytes = 0;
+	processedBytes = 0;
+}
+
+std::vector<cch::byte> MD5::saveState() const
+{
+	return detail::checkpoint::save(detail::checkpoint::Algorithm::MD5, std::span<std::uint32_t const>(hashState.parts),
+		processedBytes, std::span<cch::byte const>(pendingBlock.data(), pendingBytes));
+}
+
+void MD5::restoreState(std::span<cch::byte const> state)
+{
+	pendingBytes = detail::checkpoint::restore(detail::checkpoint::Algorithm::MD5, state,
+		std::span(hashState.parts), processedBytes, pendingBlock);
 }
 
-MD5Hash MD5::calculateHash(std::span<std::uint_fast32_t> data, MD5Hash& hashState)
+void MD5::hash(std::span<cch::byte const> data, MD5Hash &hashState, std::uint64_t inputDataSize)
 {
-	assert(data.size() * sizeof(std::uint_fast32_t) * CHAR_BIT == 512);
-
-	std::uint_fast32_t A = hashState.A;
-	std::uint_fast32_t B = hashState.B;
-	std::uint_fast32_t C = hashState.C;
-	std::uint_fast32_t D = hashState.D;
-
-	for (size_t i = 0; i < 64; ++i) {
-		std::uint_fast32_t Atmp = D;
-		std::uint_fast32_t Btmp = combine(A, B, C, D, data[indexTable[i]], i);
-		std::uint_fast32_t Ctmp = B;
-		std::uint_fast32_t Dtmp = C;
-
-		A = Atmp;
-		B = Btmp;
-		C = Ctmp;
-		D = Dtmp;
+	size_t const chunkCount = data.size() / BLOCK_SIZE;
+
+	for (size_t i = 0; i < chunkCount; ++i)
+	{
+		_hashChunk(data, i, hashState);
+	}
+
+	// The padding is always appended, even if the data is a multiple of the block size
+	// Together with the tail of the data it takes one or two blocks
+	std::array<cch::byte, 2 * BLOCK_SIZE> remainingBytes{};
+	size_t const tailSize = data.size() % BLOCK_SIZE;
+	std::copy(data.begin() + chunkCount * BLOCK_SIZE, data.end(), remainingBytes.begin());
+	remainingBytes[tailSize] = 0x80;
+
+	size_t const paddingChunks = tailSize + 1 + sizeof(inputDataSize) > BLOCK_SIZE ? 2 : 1;
+
+	// Message length in bits, little endian
+	inputDataSize *= CHAR_BIT;
+
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		inputDataSize = std::byteswap(inputDataSize);
 	}
 
-	return MD5Hash{ A, B, C, D};
+	std::memcpy(remainingBytes.data() + paddingChunks * BLOCK_SIZE - sizeof(inputDataSize), &inputDataSize, sizeof(inputDataSize));
+
+	for (size_t i = 0; i < paddingChunks; ++i)
+	{
+		_hashChunk(remainingBytes, i, hashState);
+	}
 }
 
-void MD5::_hashChunk(std::span<cch::byte> data, size_t chunkIdx, MD5Hash& hashState)
+void MD5::_hashChunk(std::span<cch::byte const> data, size_t chunkIdx, MD5Hash& hashState)
 {
-	std::vector<cch::byte> block;
-	block.reserve(64);
-	std::copy(data.begin() + chunkIdx * 64, data.begin() + (chunkIdx + 1) * 64, std::back_inserter(block));
+	assert(data.size() >= (chunkIdx + 1) * BLOCK_SIZE);
 
-	assert(block.size() == 64);
-	std::uint_fast32_t* int32Ptr = reinterpret_cast<std::uint_fast32_t*>(block.data());
+	// MD5 words are little endian
+	std::array<std::uint32_t, 16> block;
+	std::memcpy(block.data(), data.data() + chunkIdx * BLOCK_SIZE, BLOCK_SIZE);
 
-	hashState += calculateHash({ int32Ptr, block.size() / sizeof(std::uint_fast32_t)}, hashState);
-}
\ No newline at end of file
+	if constexpr (std::endian::native == std::endian::big)
+	{
+		for (auto &word : block)
+		{
+			word = std::byteswap(word);
+		}
+	}
+
+	hashState += calculateHash(block, hashState);
+}
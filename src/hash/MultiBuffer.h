@@ -0,0 +1,182 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <vector>
+#include "config/types.h"
+
+namespace cch::hash::detail
+{
+    /// Hash independent messages in SIMD lanes, the kernel processes one block of every lane per call
+    /// A lane takes the next message as soon as its current one is finished (including its own padding),
+    /// so messages of different lengths keep all the lanes busy
+    /// \tparam Hash hash type, a default constructed hash holds the initial state
+    /// \tparam Lanes number of messages processed at once
+    /// \tparam WordOrder byte order of the message words and of the length field
+    /// \tparam LengthBytes size of the message length field appended by the padding
+    /// \param messages messages to hash
+    /// \param kernel kernel(state, words) processes one block per lane, both arrays are in [word][lane] layout
+    /// \param initialState state every message starts from, either the initial state or the state after a common prefix
+    /// \param prefixBytes size of the common prefix, a whole number of blocks, counted in the length field of every message
+    /// \return hash of every message
+    template <typename Hash, size_t Lanes, std::endian WordOrder, size_t LengthBytes, typename Kernel>
+    std::vector<Hash> hashMany(std::span<std::span<cch::byte const> const> messages, Kernel kernel,
+        Hash const &initialState = Hash{}, std::uint64_t prefixBytes = 0)
+    {
+        using Word = std::remove_cvref_t<decltype(Hash{}.parts[0])>;
+        constexpr size_t StateWords = sizeof(Hash{}.parts) / sizeof(Word);
+        constexpr size_t BlockSize = 16 * sizeof(Word);
+        constexpr size_t NoMessage = static_cast<size_t>(-1);
+
+        struct Lane
+        {
+            size_t message = NoMessage;
+            /// Next complete block of the message
+            cch::byte const *data = nullptr;
+            /// Complete blocks of the message left
+            size_t blocks = 0;
+            /// The last incomplete block with the padding, spans one or two blocks
+            std::array<cch::byte, 2 * BlockSize> tail{};
+            size_t tailBlocks = 0;
+            size_t tailBlock = 0;
+        };
+
+        std::vector<Hash> result(messages.size());
+        std::array<Lane, Lanes> lanes;
+        alignas(64) std::array<std::array<Word, Lanes>, StateWords> state{};
+        alignas(64) std::array<std::array<Word, Lanes>, 16> words{};
+
+        size_t nextMessage = 0;
+
+        auto const assignMessage = [&](size_t laneIdx) -> bool
+        {
+            Lane &lane = lanes[laneIdx];
+
+            if (nextMessage == messages.size())
+            {
+                lane.message = NoMessage;
+                return false;
+            }
+
+            auto const message = messages[nextMessage];
+            lane.message = nextMessage++;
+            lane.data = message.data();
+            lane.blocks = message.size() / BlockSize;
+
+            size_t const tailSize = message.size() % BlockSize;
+            lane.tail.fill(0x00);
+
+            if (tailSize > 0)
+            {
+                std::memcpy(lane.tail.data(), message.data() + lane.blocks * BlockSize, tailSize);
+            }
+
+            lane.tail[tailSize] = 0x80;
+            lane.tailBlocks = tailSize + 1 + LengthBytes > BlockSize ? 2 : 1;
+            lane.tailBlock = 0;
+
+            // Length in bits, the upper bytes of a 128-bit length field stay zero
+            std::uint64_t const bitLength = (prefixBytes + message.size()) * 8;
+            cch::byte *lengthEnd = lane.tail.data() + lane.tailBlocks * BlockSize;
+
+            for (size_t i = 0; i < sizeof(bitLength); ++i)
+            {
+                cch::byte const lengthByte = static_cast<cch::byte>(bitLength >> (i * 8));
+
+                if constexpr (WordOrder == std::endian::big)
+                {
+                    *(lengthEnd - 1 - i) = lengthByte;
+                }
+                else
+                {
+                    *(lengthEnd - LengthBytes + i) = lengthByte;
+                }
+            }
+
+            for (size_t j = 0; j < StateWords; ++j)
+            {
+                state[j][laneIdx] = initialState.parts[j];
+            }
+
+            return true;
+        };
+
+        size_t activeLanes = 0;
+
+        for (size_t l = 0; l < Lanes; ++l)
+        {
+            activeLanes += assignMessage(l) ? 1 : 0;
+        }
+
+        while (activeLanes > 0)
+        {
+            // Gather the current block of every lane into [word][lane] layout, idle lanes hash zeros
+            for (size_t l = 0; l < Lanes; ++l)
+            {
+                Lane const &lane = lanes[l];
+
+                if (lane.message == NoMessage)
+                {
+                    for (size_t t = 0; t < 16; ++t)
+                    {
+                        words[t][l] = 0;
+                    }
+
+                    continue;
+                }
+
+                cch::byte const *block = lane.blocks > 0 ? lane.data : lane.tail.data() + lane.tailBlock * BlockSize;
+
+                for (size_t t = 0; t < 16; ++t)
+                {
+                    Word word;
+                    std::memcpy(&word, block + t * sizeof(Word), sizeof(Word));
+
+                    if constexpr (WordOrder != std::endian::native)
+                    {
+                        word = std::byteswap(word);
+                    }
+
+                    words[t][l] = word;
+                }
+            }
+
+            kernel(state, words);
+
+            for (size_t l = 0; l < Lanes; ++l)
+            {
+                Lane &lane = lanes[l];
+
+                if (lane.message == NoMessage)
+                {
+                    continue;
+                }
+
+                if (lane.blocks > 0)
+                {
+                    --lane.blocks;
+                    lane.data += BlockSize;
+                }
+                else
+                {
+                    ++lane.tailBlock;
+                }
+
+                if (lane.blocks == 0 && lane.tailBlock == lane.tailBlocks)
+                {
+                    for (size_t j = 0; j < StateWords; ++j)
+                    {
+                        result[lane.message].parts[j] = state[j][l];
+                    }
+
+                    activeLanes -= assignMessage(l) ? 0 : 1;
+                }
+            }
+        }
+
+        return result;
+    }
+}
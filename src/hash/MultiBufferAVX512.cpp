@@ -0,0 +1,32 @@
+#include "utilities/CpuFeatures.h"
+
+// Multi-buffer kernels compiled with -mavx512f, only called after a runtime cpuid check
+#if defined(CCH_ARCH_X86)
+#include "../include/hash/MD5.h"
+#include "../include/hash/SHA256.h"
+#include "../include/hash/SHA512.h"
+#include "../include/hash/BLAKE3.h"
+#include "MultiBufferKernels.h"
+
+void cch::hash::SHA256::hashLanesAVX512(std::array<std::array<std::uint32_t, 16>, 8> &state, std::array<std::array<std::uint32_t, 16>, 16> const &words)
+{
+    detail::sha256Lanes<detail::U32x16>(state, words, K);
+}
+
+void cch::hash::SHA512::hashLanesAVX512(std::array<std::array<std::uint64_t, 8>, 8> &state, std::array<std::array<std::uint64_t, 8>, 16> const &words)
+{
+    detail::sha512Lanes<detail::U64x8>(state, words, K);
+}
+
+void cch::hash::MD5::hashLanesAVX512(std::array<std::array<std::uint32_t, 16>, 4> &state, std::array<std::array<std::uint32_t, 16>, 16> const &words)
+{
+    detail::md5Lanes<detail::U32x16>(state, words, K, indexTable);
+}
+
+void cch::hash::BLAKE3::compressLanesAVX512(std::array<std::array<std::uint32_t, 16>, 8> &cv, std::array<std::array<std::uint32_t, 16>, 16> const &words,
+                                            std::array<std::uint32_t, 16> const &counterLow, std::array<std::uint32_t, 16> const &counterHigh,
+                                            std::uint32_t blockLength, std::uint32_t flags)
+{
+    detail::blake3Lanes<detail::U32x16>(cv, words, counterLow, counterHigh, blockLength, flags, IV, MESSAGE_SCHEDULE);
+}
+#endif
@@ -0,0 +1,268 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include "SimdVectors.h"
+
+// Round functions of the multi-buffer hash kernels written once for any SIMD vector wrapper from SimdVectors.h
+namespace cch::hash::detail
+{
+    /// Process one SHA256 block in every lane
+    /// \tparam V vector of 32-bit lanes
+    /// \param state hash state in [word][lane] layout
+    /// \param words message block in [word][lane] layout, already converted from big endian
+    /// \param K round constants
+    template <typename V>
+    void sha256Lanes(std::array<std::array<std::uint32_t, V::LANES>, 8> &state,
+                     std::array<std::array<std::uint32_t, V::LANES>, 16> const &words,
+                     std::array<std::uint32_t, 64> const &K)
+    {
+        std::array<V, 16> w;
+
+        for (size_t t = 0; t < 16; ++t)
+        {
+            w[t] = V::load(words[t].data());
+        }
+
+        V a = V::load(state[0].data());
+        V b = V::load(state[1].data());
+        V c = V::load(state[2].data());
+        V d = V::load(state[3].data());
+        V e = V::load(state[4].data());
+        V f = V::load(state[5].data());
+        V g = V::load(state[6].data());
+        V h = V::load(state[7].data());
+
+        for (size_t i = 0; i < 64; ++i)
+        {
+            // The schedule only needs the last 16 words, keep them in a ring
+            if (i >= 16)
+            {
+                V const w15 = w[(i + 1) % 16];
+                V const w2 = w[(i + 14) % 16];
+                V const s0 = rotr<7>(w15) ^ rotr<18>(w15) ^ shr<3>(w15);
+                V const s1 = rotr<17>(w2) ^ rotr<19>(w2) ^ shr<10>(w2);
+                w[i % 16] = w[i % 16] + s0 + w[(i + 9) % 16] + s1;
+            }
+
+            V const S1 = rotr<6>(e) ^ rotr<11>(e) ^ rotr<25>(e);
+            V const tmp1 = h + S1 + choose(e, f, g) + V::broadcast(K[i]) + w[i % 16];
+            V const S0 = rotr<2>(a) ^ rotr<13>(a) ^ rotr<22>(a);
+            V const tmp2 = S0 + majority(a, b, c);
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + tmp1;
+            d = c;
+            c = b;
+            b = a;
+            a = tmp1 + tmp2;
+        }
+
+        (V::load(state[0].data()) + a).store(state[0].data());
+        (V::load(state[1].data()) + b).store(state[1].data());
+        (V::load(state[2].data()) + c).store(state[2].data());
+        (V::load(state[3].data()) + d).store(state[3].data());
+        (V::load(state[4].data()) + e).store(state[4].data());
+        (V::load(state[5].data()) + f).store(state[5].data());
+        (V::load(state[6].data()) + g).store(state[6].data());
+        (V::load(state[7].data()) + h).store(state[7].data());
+    }
+
+    /// Process one SHA512 block in every lane, the message schedule is computed for all lanes at once
+    /// \tparam V vector of 64-bit lanes
+    /// \param state hash state in [word][lane] layout
+    /// \param words message block in [word][lane] layout, already converted from big endian
+    /// \param K round constants
+    template <typename V>
+    void sha512Lanes(std::array<std::array<std::uint64_t, V::LANES>, 8> &state,
+                     std::array<std::array<std::uint64_t, V::LANES>, 16> const &words,
+                     std::array<std::uint64_t, 80> const &K)
+    {
+        std::array<V, 16> w;
+
+        for (size_t t = 0; t < 16; ++t)
+        {
+            w[t] = V::load(words[t].data());
+        }
+
+        V a = V::load(state[0].data());
+        V b = V::load(state[1].data());
+        V c = V::load(state[2].data());
+        V d = V::load(state[3].data());
+        V e = V::load(state[4].data());
+        V f = V::load(state[5].data());
+        V g = V::load(state[6].data());
+        V h = V::load(state[7].data());
+
+        for (size_t i = 0; i < 80; ++i)
+        {
+            if (i >= 16)
+            {
+                V const w15 = w[(i + 1) % 16];
+                V const w2 = w[(i + 14) % 16];
+                V const s0 = rotr<1>(w15) ^ rotr<8>(w15) ^ shr<7>(w15);
+                V const s1 = rotr<19>(w2) ^ rotr<61>(w2) ^ shr<6>(w2);
+                w[i % 16] = w[i % 16] + s0 + w[(i + 9) % 16] + s1;
+            }
+
+            V const S1 = rotr<14>(e) ^ rotr<18>(e) ^ rotr<41>(e);
+            V const tmp1 = h + S1 + choose(e, f, g) + V::broadcast(K[i]) + w[i % 16];
+            V const S0 = rotr<28>(a) ^ rotr<34>(a) ^ rotr<39>(a);
+            V const tmp2 = S0 + majority(a, b, c);
+
+            h = g;
+            g = f;
+            f = e;
+            e = d + tmp1;
+            d = c;
+            c = b;
+            b = a;
+            a = tmp1 + tmp2;
+        }
+
+        (V::load(state[0].data()) + a).store(state[0].data());
+        (V::load(state[1].data()) + b).store(state[1].data());
+        (V::load(state[2].data()) + c).store(state[2].data());
+        (V::load(state[3].data()) + d).store(state[3].data());
+        (V::load(state[4].data()) + e).store(state[4].data());
+        (V::load(state[5].data()) + f).store(state[5].data());
+        (V::load(state[6].data()) + g).store(state[6].data());
+        (V::load(state[7].data()) + h).store(state[7].data());
+    }
+
+    /// Process one MD5 block in every lane
+    /// The round functions are bitwise selects instead of the per-round branches of the scalar path
+    /// \tparam V vector of 32-bit lanes
+    /// \param state hash state in [word][lane] layout
+    /// \param words message block in [word][lane] layout, little endian words
+    /// \param K round constants
+    /// \param indexTable message word used by every round
+    template <typename V>
+    void md5Lanes(std::array<std::array<std::uint32_t, V::LANES>, 4> &state,
+                  std::array<std::array<std::uint32_t, V::LANES>, 16> const &words,
+                  std::array<std::uint32_t, 64> const &K,
+                  std::array<unsigned char, 64> const &indexTable)
+    {
+        std::array<V, 16> m;
+
+        for (size_t t = 0; t < 16; ++t)
+        {
+            m[t] = V::load(words[t].data());
+        }
+
+        V a = V::load(state[0].data());
+        V b = V::load(state[1].data());
+        V c = V::load(state[2].data());
+        V d = V::load(state[3].data());
+
+        // a = b + ((a + f + K[i] + M[g(i)]) <<< S)
+        auto const step = [&]<int S>(V &a, V const &b, V const &f, size_t i)
+        {
+            a = b + rotr<32 - S>(a + f + V::broadcast(K[i]) + m[indexTable[i]]);
+        };
+
+        for (size_t i = 0; i < 16; i += 4)
+        {
+            step.template operator()<7>(a, b, choose(b, c, d), i);
+            step.template operator()<12>(d, a, choose(a, b, c), i + 1);
+            step.template operator()<17>(c, d, choose(d, a, b), i + 2);
+            step.template operator()<22>(b, c, choose(c, d, a), i + 3);
+        }
+
+        for (size_t i = 16; i < 32; i += 4)
+        {
+            step.template operator()<5>(a, b, choose(d, b, c), i);
+            step.template operator()<9>(d, a, choose(c, a, b), i + 1);
+            step.template operator()<14>(c, d, choose(b, d, a), i + 2);
+            step.template operator()<20>(b, c, choose(a, c, d), i + 3);
+        }
+
+        for (size_t i = 32; i < 48; i += 4)
+        {
+            step.template operator()<4>(a, b, xor3(b, c, d), i);
+            step.template operator()<11>(d, a, xor3(a, b, c), i + 1);
+            step.template operator()<16>(c, d, xor3(d, a, b), i + 2);
+            step.template operator()<23>(b, c, xor3(c, d, a), i + 3);
+        }
+
+        for (size_t i = 48; i < 64; i += 4)
+        {
+            step.template operator()<6>(a, b, xorOrNot(b, c, d), i);
+            step.template operator()<10>(d, a, xorOrNot(a, b, c), i + 1);
+            step.template operator()<15>(c, d, xorOrNot(d, a, b), i + 2);
+            step.template operator()<21>(b, c, xorOrNot(c, d, a), i + 3);
+        }
+
+        (V::load(state[0].data()) + a).store(state[0].data());
+        (V::load(state[1].data()) + b).store(state[1].data());
+        (V::load(state[2].data()) + c).store(state[2].data());
+        (V::load(state[3].data()) + d).store(state[3].data());
+    }
+
+    /// Compress one BLAKE3 block in every lane
+    /// \tparam V vector of 32-bit lanes
+    /// \param cv chaining value in [word][lane] layout, replaced with the chaining value after the block
+    /// \param words message block in [word][lane] layout, already converted from little endian
+    /// \param counterLow low halves of the counter of every lane
+    /// \param counterHigh high halves of the counter of every lane
+    /// \param blockLength number of bytes in the block, the same in every lane
+    /// \param flags domain flags, the same in every lane
+    /// \param IV initialization vector
+    /// \param schedule message word order of every round
+    template <typename V>
+    void blake3Lanes(std::array<std::array<std::uint32_t, V::LANES>, 8> &cv,
+                     std::array<std::array<std::uint32_t, V::LANES>, 16> const &words,
+                     std::array<std::uint32_t, V::LANES> const &counterLow,
+                     std::array<std::uint32_t, V::LANES> const &counterHigh,
+                     std::uint32_t blockLength, std::uint32_t flags,
+                     std::array<std::uint32_t, 8> const &IV,
+                     std::array<std::array<std::uint8_t, 16>, 7> const &schedule)
+    {
+        std::array<V, 16> m;
+
+        for (size_t t = 0; t < 16; ++t)
+        {
+            m[t] = V::load(words[t].data());
+        }
+
+        std::array<V, 16> v =
+        {
+            V::load(cv[0].data()), V::load(cv[1].data()), V::load(cv[2].data()), V::load(cv[3].data()),
+            V::load(cv[4].data()), V::load(cv[5].data()), V::load(cv[6].data()), V::load(cv[7].data()),
+            V::broadcast(IV[0]), V::broadcast(IV[1]), V::broadcast(IV[2]), V::broadcast(IV[3]),
+            V::load(counterLow.data()), V::load(counterHigh.data()), V::broadcast(blockLength), V::broadcast(flags)
+        };
+
+        auto const g = [&v](size_t a, size_t b, size_t c, size_t d, V x, V y)
+        {
+            v[a] = v[a] + v[b] + x;
+            v[d] = rotr<16>(v[d] ^ v[a]);
+            v[c] = v[c] + v[d];
+            v[b] = rotr<12>(v[b] ^ v[c]);
+            v[a] = v[a] + v[b] + y;
+            v[d] = rotr<8>(v[d] ^ v[a]);
+            v[c] = v[c] + v[d];
+            v[b] = rotr<7>(v[b] ^ v[c]);
+        };
+
+        for (auto const &s : schedule)
+        {
+            // Columns, then diagonals
+            g(0, 4, 8, 12, m[s[0]], m[s[1]]);
+            g(1, 5, 9, 13, m[s[2]], m[s[3]]);
+            g(2, 6, 10, 14, m[s[4]], m[s[5]]);
+            g(3, 7, 11, 15, m[s[6]], m[s[7]]);
+            g(0, 5, 10, 15, m[s[8]], m[s[9]]);
+            g(1, 6, 11, 12, m[s[10]], m[s[11]]);
+            g(2, 7, 8, 13, m[s[12]], m[s[13]]);
+            g(3, 4, 9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (size_t i = 0; i < 8; ++i)
+        {
+            (v[i] ^ v[i + 8]).store(cv[i].data());
+        }
+    }
+}
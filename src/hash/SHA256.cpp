@@ -1,18 +1,16 @@
 #include "../include/hash/SHA256.h"
+#include "utilities/CpuFeatures.h"
+#include "MultiBuffer.h"
+#include "HashCheckpoint.h"
 #include <bit>
+#include <climits>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <assert.h>
 
-std::array<std::uint_fast32_t, 64> cch::hash::SHA256::K =
-    {
-    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
+std::atomic<cch::hash::SHA256::BlockFunction> cch::hash::SHA256::hashBlocks = &cch::hash::SHA256::hashBlocksDispatch;
+std::atomic<bool> cch::hash::SHA256::backendSelected = false;
 
 cch::hash::SHA256Hash cch::hash::SHA256::hash(std::span<cch::byte> data)
 {
@@ -22,115 +20,211 @@ cch::hash::SHA256Hash cch::hash::SHA256::hash(std::span<cch::byte> data)
     return hashState;
 }
 
-void cch::hash::SHA256::hash(std::span<cch::byte> data, SHA256Hash &hash, std::uint64_t inputDataSize)
+std::vector<cch::hash::SHA256Hash> cch::hash::SHA256::hashMany(std::span<std::span<cch::byte const> const> messages)
+{
+    return hashMany(SHA256{}, messages);
+}
+
+std::vector<cch::hash::SHA256Hash> cch::hash::SHA256::hashMany(SHA256 const &prefix, std::span<std::span<cch::byte const> const> messages)
 {
-    for (size_t i = 0; i < (data.size() * CHAR_BIT) / 512; ++i)
+    if (prefix.pendingBytes != 0)
     {
-        hashChunk({data.begin(), data.end()}, i, hash);
+        throw std::invalid_argument("The prefix must end on a block boundary");
     }
 
-    if ((data.size() * CHAR_BIT) % 512)
+#if defined(CCH_ARCH_X86)
+    // A backend selected with setBackend() hashes the messages one at a time like everything else
+    if (!backendSelected.load(std::memory_order_relaxed))
     {
-        inputDataSize *= CHAR_BIT;
-
-        std::vector<cch::byte> remainingBytes;
-        size_t chunkStartIdx = data.size() - data.size() % 64;
-        remainingBytes.reserve(data.size() - chunkStartIdx);
-
-        std::copy(data.begin() + chunkStartIdx, data.end(), std::back_inserter(remainingBytes));
-
-        remainingBytes.push_back(0x80);
-
-        while (remainingBytes.size() * CHAR_BIT % 512 != 448)
+        if (CpuFeatures::get().avx512f && messages.size() > 8)
         {
-            remainingBytes.push_back(0x00);
+            return detail::hashMany<SHA256Hash, 16, std::endian::big, 8>(messages, &hashLanesAVX512, prefix.hashState, prefix.processedBytes);
         }
 
-        if constexpr (std::endian::native == std::endian::little)
+        // Hashing one message at a time with the SHA extensions is faster than 8 AVX2 lanes
+        if (CpuFeatures::get().avx2 && getBackend() != Backend::SHANI && messages.size() > 1)
         {
-            inputDataSize = std::byteswap(inputDataSize);
+            return detail::hashMany<SHA256Hash, 8, std::endian::big, 8>(messages, &hashLanesAVX2, prefix.hashState, prefix.processedBytes);
         }
+    }
+#endif
+
+    std::vector<SHA256Hash> hashes(messages.size(), prefix.hashState);
+
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        hash(messages[i], hashes[i], prefix.processedBytes + messages[i].size());
+    }
 
-        char const* dataSizePtr = reinterpret_cast<char const *>(&inputDataSize);
-        remainingBytes.insert(remainingBytes.end(), dataSizePtr, dataSizePtr + sizeof(inputDataSize));
+    return hashes;
+}
 
-        for (size_t i = 0; i < (remainingBytes.size() * CHAR_BIT) / 512; ++i)
+void cch::hash::SHA256::update(std::span<cch::byte const> data)
+{
+    processedBytes += data.size();
+
+    // Complete the pending block first
+    if (pendingBytes > 0)
+    {
+        size_t const bytesToCopy = std::min(BLOCK_SIZE - pendingBytes, data.size());
+        std::copy_n(data.begin(), bytesToCopy, pendingBlock.begin() + pendingBytes);
+        pendingBytes += bytesToCopy;
+        data = data.subspan(bytesToCopy);
+
+        if (pendingBytes < BLOCK_SIZE)
         {
-            hashChunk({remainingBytes.begin(), remainingBytes.end()}, i, hash);
+            return;
         }
+
+        hashChunk(pendingBlock, 0, hashState);
+        pendingBytes = 0;
     }
+
+    // Hash the complete blocks in place
+    hashChunk(data, 0, hashState, data.size() / BLOCK_SIZE);
+
+    // Keep the tail until more data arrives
+    pendingBytes = data.size() % BLOCK_SIZE;
+    std::copy(data.end() - pendingBytes, data.end(), pendingBlock.begin());
 }
 
-void cch::hash::SHA256::hashChunk(std::span<cch::byte> data, size_t chunkIdx, SHA256Hash &hashState)
+cch::hash::SHA256Hash cch::hash::SHA256::finalize()
 {
-    std::vector<cch::byte> block;
-    block.reserve(64);
-    std::copy(data.begin() + chunkIdx * 64, data.begin() + (chunkIdx + 1) * 64, std::back_inserter(block));
+    hash({pendingBlock.data(), pendingBytes}, hashState, processedBytes);
 
-    assert(block.size() == 64);
-    std::uint_fast32_t* int32Ptr = reinterpret_cast<std::uint_fast32_t*>(block.data());
+    auto const result = hashState;
+    reset();
+
+    return result;
+}
 
-    hashState += calculateHash({int32Ptr, block.size() / sizeof(std::uint_fast32_t)}, hashState);
+void cch::hash::SHA256::reset() noexcept
+{
+    hashState = SHA256Hash{};
+    pendingBytes = 0;
+    processedBytes = 0;
+}
+
+std::vector<cch::byte> cch::hash::SHA256::saveState() const
+{
+    return detail::checkpoint::save(detail::checkpoint::Algorithm::SHA256, std::span<std::uint32_t const>(hashState.parts),
+        processedBytes, std::span<cch::byte const>(pendingBlock.data(), pendingBytes));
+}
+
+void cch::hash::SHA256::restoreState(std::span<cch::byte const> state)
+{
+    pendingBytes = detail::checkpoint::restore(detail::checkpoint::Algorithm::SHA256, state,
+        std::span(hashState.parts), processedBytes, pendingBlock);
 }
 
-cch::hash::SHA256Hash cch::hash::SHA256::calculateHash(std::span<std::uint_fast32_t> data, SHA256Hash &hashState)
+void cch::hash::SHA256::hash(std::span<cch::byte const> data, SHA256Hash &hash, std::uint64_t inputDataSize)
 {
-    assert(data.size() * sizeof(std::uint_fast32_t) * CHAR_BIT == 512);
+    size_t const chunkCount = data.size() / BLOCK_SIZE;
+    hashChunk(data, 0, hash, chunkCount);
 
-    std::array<std::uint_fast32_t, 64> w;
-    std::copy(data.begin(), data.end(), w.begin());
+    // The padding is always appended, even if the data is a multiple of the block size
+    // Together with the tail of the data it takes one or two blocks
+    std::array<cch::byte, 2 * BLOCK_SIZE> remainingBytes{};
+    size_t const tailSize = data.size() % BLOCK_SIZE;
+    std::copy(data.begin() + chunkCount * BLOCK_SIZE, data.end(), remainingBytes.begin());
+    remainingBytes[tailSize] = 0x80;
 
-    for (size_t i = 0; i < 16; ++i)
+    size_t const paddingChunks = tailSize + 1 + sizeof(inputDataSize) > BLOCK_SIZE ? 2 : 1;
+
+    // Message length in bits, big endian
+    inputDataSize *= CHAR_BIT;
+
+    if constexpr (std::endian::native == std::endian::little)
     {
-        w[i] = std::byteswap(w[i]);
+        inputDataSize = std::byteswap(inputDataSize);
     }
 
-    for (size_t i = 16; i < w.size(); ++i)
+    std::memcpy(remainingBytes.data() + paddingChunks * BLOCK_SIZE - sizeof(inputDataSize), &inputDataSize, sizeof(inputDataSize));
+
+    hashChunk(remainingBytes, 0, hash, paddingChunks);
+}
+
+void cch::hash::SHA256::hashChunk(std::span<cch::byte const> data, size_t chunkIdx, SHA256Hash &hashState, size_t chunkCount)
+{
+    assert(data.size() >= (chunkIdx + chunkCount) * 64);
+
+    if (chunkCount > 0)
     {
-        auto s0 = std::rotr(w[i - 15], 7) ^ std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
-        auto s1 = std::rotr(w[i - 2], 17) ^ std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
-        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        hashBlocks.load(std::memory_order_relaxed)(hashState, data.data() + chunkIdx * 64, chunkCount);
     }
+}
 
-    auto t = hashState.parts;
+void cch::hash::SHA256::hashBlocksScalar(SHA256Hash &hashState, cch::byte const *data, size_t blockCount)
+{
+    std::array<std::uint32_t, 16> block;
+
+    for (size_t i = 0; i < blockCount; ++i, data += BLOCK_SIZE)
+    {
+        // SHA256 words are big endian
+        std::memcpy(block.data(), data, BLOCK_SIZE);
 
-    auto& A = t[0];
-    auto& B = t[1];
-    auto& C = t[2];
-    auto& D = t[3];
-    auto& E = t[4];
-    auto& F = t[5];
-    auto& G = t[6];
-    auto& H = t[7];
+        if constexpr (std::endian::native == std::endian::little)
+        {
+            for (auto &word : block)
+            {
+                word = std::byteswap(word);
+            }
+        }
 
-    for (size_t i = 0; i < 64; ++i)
+        hashState += calculateHash(block, hashState);
+    }
+}
+
+void cch::hash::SHA256::hashBlocksDispatch(SHA256Hash &hashState, cch::byte const *data, size_t blockCount)
+{
+    useBackend(isSupported(Backend::SHANI) ? Backend::SHANI : Backend::Scalar);
+    hashBlocks.load(std::memory_order_relaxed)(hashState, data, blockCount);
+}
+
+bool cch::hash::SHA256::isSupported(Backend backend)
+{
+    switch (backend)
     {
-        auto S1 = std::rotr(E, 6) ^ std::rotr(E, 11) ^ std::rotr(E, 25);
-        auto ch = (E & F) ^ ((~E) & G);
-        auto tmp1 = H + S1 + ch + K[i] + w[i];
-        auto S0 = std::rotr(A, 2) ^ std::rotr(A, 13) ^ std::rotr(A, 22);
-        auto maj = (A & B) ^ (A & C) ^ (B & C);
-        auto tmp2 = S0 + maj;
-
-        H = G;
-        G = F;
-        F = E;
-        E = D + tmp1;
-        D = C;
-        C = B;
-        B = A;
-        A = tmp1 + tmp2;
+        case Backend::Scalar:
+            return true;
+        case Backend::SHANI:
+        #if defined(CCH_ARCH_X86)
+            return CpuFeatures::get().sha && CpuFeatures::get().sse41;
+        #else
+            return false;
+        #endif
     }
 
-    return SHA256Hash{t};
+    return false;
 }
 
-std::uint_fast32_t cch::hash::SHA256::s0(std::uint_fast32_t x)
+bool cch::hash::SHA256::setBackend(Backend backend)
 {
-    return std::rotr(x, 7) ^ std::rotr(x, 18) ^ (x >> 3);
+    if (!isSupported(backend))
+    {
+        return false;
+    }
+
+    useBackend(backend);
+    backendSelected.store(true, std::memory_order_relaxed);
+    return true;
 }
 
-std::uint_fast32_t cch::hash::SHA256::s1(std::uint_fast32_t x)
+void cch::hash::SHA256::useBackend(Backend backend)
 {
-    return std::rotr(x, 17) ^ std::rotr(x, 19) ^ (x >> 10);
+    hashBlocks.store(backend == Backend::SHANI ? &hashBlocksSHANI : &hashBlocksScalar, std::memory_order_relaxed);
+}
+
+cch::hash::SHA256::Backend cch::hash::SHA256::getBackend()
+{
+    auto const function = hashBlocks.load(std::memory_order_relaxed);
+
+    if (function == &hashBlocksDispatch)
+    {
+        // Nothing has been hashed yet, resolve the default backend now
+        useBackend(isSupported(Backend::SHANI) ? Backend::SHANI : Backend::Scalar);
+        return getBackend();
+    }
+
+    return function == &hashBlocksSHANI ? Backend::SHANI : Backend::Scalar;
 }
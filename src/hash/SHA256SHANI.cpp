@@ -0,0 +1,75 @@
+#include "../include/hash/SHA256.h"
+#include "utilities/CpuFeatures.h"
+
+#if defined(CCH_ARCH_X86)
+#include <immintrin.h>
+#include <utility>
+
+// Requires SSE4.1 and SHA extensions, the file is compiled with the corresponding flags
+// and the kernel is only called when SHA256::isSupported(Backend::SHANI) is true
+void cch::hash::SHA256::hashBlocksSHANI(SHA256Hash &hashState, cch::byte const *data, size_t blockCount)
+{
+    // Converts big endian message words to the native order
+    __m128i const byteSwapMask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    // The rounds instruction expects the state as {A, B, E, F} and {C, D, G, H}
+    __m128i tmp = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&hashState.parts[0]));
+    __m128i state1 = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&hashState.parts[4]));
+
+    tmp = _mm_shuffle_epi32(tmp, 0xB1);
+    state1 = _mm_shuffle_epi32(state1, 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (size_t block = 0; block < blockCount; ++block, data += 64)
+    {
+        __m128i const abefSave = state0;
+        __m128i const cdghSave = state1;
+
+        __m128i msg[4];
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            msg[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i * 16)), byteSwapMask);
+        }
+
+        // 16 groups of 4 rounds, the schedule for the group I + 4 is computed while the group I is processed
+        auto const roundsGroup = [&]<size_t I>()
+        {
+            __m128i const wk = _mm_add_epi32(msg[I % 4], _mm_loadu_si128(reinterpret_cast<__m128i const*>(&K[I * 4])));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(wk, 0x0E));
+
+            if constexpr (I < 12)
+            {
+                __m128i const w = _mm_sha256msg1_epu32(msg[I % 4], msg[(I + 1) % 4]);
+                __m128i const w7 = _mm_alignr_epi8(msg[(I + 3) % 4], msg[(I + 2) % 4], 4);
+                msg[I % 4] = _mm_sha256msg2_epu32(_mm_add_epi32(w, w7), msg[(I + 3) % 4]);
+            }
+        };
+
+        [&]<size_t... I>(std::index_sequence<I...>)
+        {
+            (roundsGroup.template operator()<I>(), ...);
+        }(std::make_index_sequence<16>{});
+
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    // Restore {A, B, C, D} and {E, F, G, H}
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&hashState.parts[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&hashState.parts[4]), state1);
+}
+#else
+void cch::hash::SHA256::hashBlocksSHANI(SHA256Hash &hashState, cch::byte const *data, size_t blockCount)
+{
+    // Never selected, SHA256::isSupported(Backend::SHANI) is false on other architectures
+    hashBlocksScalar(hashState, data, blockCount);
+}
+#endif
@@ -0,0 +1,167 @@
+#include "../include/hash/SHA256Tree.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+cch::hash::SHA256TreeHash cch::hash::SHA256Tree::hash(std::span<cch::byte const> data, size_t leafSize, size_t threadCount)
+{
+    if (leafSize == 0)
+    {
+        throw std::invalid_argument("leaf size must be positive");
+    }
+
+    SHA256TreeHash tree;
+    tree.leafSize = leafSize;
+    tree.leaves.resize(leafCount(data.size(), leafSize));
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    threadCount = std::min(threadCount, tree.leaves.size());
+
+    // Workers take the next leaf from a shared counter, so a slow worker does not hold back the others
+    std::atomic<size_t> nextLeaf = 0;
+
+    auto const worker = [&]()
+    {
+        for (size_t i = nextLeaf++; i < tree.leaves.size(); i = nextLeaf++)
+        {
+            tree.leaves[i] = hashLeaf(leafData(data, leafSize, i));
+        }
+    };
+
+    std::vector<std::future<void>> workers;
+    workers.reserve(threadCount - 1);
+
+    for (size_t i = 1; i < threadCount; ++i)
+    {
+        workers.push_back(std::async(std::launch::async, worker));
+    }
+
+    worker();
+
+    for (auto &w : workers)
+    {
+        w.get();
+    }
+
+    tree.root = root(tree.leaves);
+    return tree;
+}
+
+void cch::hash::SHA256Tree::update(std::span<cch::byte const> data, SHA256TreeHash &tree, size_t offset, size_t length)
+{
+    auto const [first, last] = leafRange(tree, data.size(), offset, length);
+
+    for (size_t i = first; i < last; ++i)
+    {
+        tree.leaves[i] = hashLeaf(leafData(data, tree.leafSize, i));
+    }
+
+    tree.root = root(tree.leaves);
+}
+
+std::vector<size_t> cch::hash::SHA256Tree::verify(std::span<cch::byte const> data, SHA256TreeHash const &tree, size_t offset, size_t length)
+{
+    auto const [first, last] = leafRange(tree, data.size(), offset, length);
+    std::vector<size_t> mismatches;
+
+    for (size_t i = first; i < last; ++i)
+    {
+        if (!(hashLeaf(leafData(data, tree.leafSize, i)) == tree.leaves[i]))
+        {
+            mismatches.push_back(i);
+        }
+    }
+
+    return mismatches;
+}
+
+cch::hash::SHA256Hash cch::hash::SHA256Tree::hashLeaf(std::span<cch::byte const> leafData)
+{
+    SHA256 hasher;
+    hasher.update({&LEAF_PREFIX, 1});
+    hasher.update(leafData);
+
+    return hasher.finalize();
+}
+
+cch::hash::SHA256Hash cch::hash::SHA256Tree::root(std::span<SHA256Hash const> leaves)
+{
+    if (leaves.empty())
+    {
+        return hashLeaf({});
+    }
+
+    std::vector<SHA256Hash> level(leaves.begin(), leaves.end());
+    // Node messages of a level: prefix, left digest, right digest
+    size_t const nodeSize = 1 + 2 * 32;
+    std::vector<cch::byte> nodes;
+    std::vector<std::span<cch::byte const>> messages;
+
+    while (level.size() > 1)
+    {
+        size_t const pairs = level.size() / 2;
+        nodes.resize(pairs * nodeSize);
+        messages.clear();
+
+        for (size_t i = 0; i < pairs; ++i)
+        {
+            cch::byte *node = nodes.data() + i * nodeSize;
+            node[0] = NODE_PREFIX;
+
+            auto const left = level[2 * i].toBytes();
+            auto const right = level[2 * i + 1].toBytes();
+            std::copy(left.begin(), left.end(), node + 1);
+            std::copy(right.begin(), right.end(), node + 1 + left.size());
+
+            messages.emplace_back(node, nodeSize);
+        }
+
+        // All the nodes of a level are independent, hash them in SIMD lanes
+        auto parents = SHA256::hashMany(messages);
+
+        if (level.size() % 2)
+        {
+            parents.push_back(level.back());
+        }
+
+        level = std::move(parents);
+    }
+
+    return level.front();
+}
+
+size_t cch::hash::SHA256Tree::leafCount(size_t dataSize, size_t leafSize)
+{
+    // An empty buffer still has one (empty) leaf
+    return std::max<size_t>(1, (dataSize + leafSize - 1) / leafSize);
+}
+
+std::span<cch::byte const> cch::hash::SHA256Tree::leafData(std::span<cch::byte const> data, size_t leafSize, size_t leafIdx)
+{
+    size_t const offset = std::min(data.size(), leafIdx * leafSize);
+    return data.subspan(offset, std::min(leafSize, data.size() - offset));
+}
+
+std::pair<size_t, size_t> cch::hash::SHA256Tree::leafRange(SHA256TreeHash const &tree, size_t dataSize, size_t offset, size_t length)
+{
+    if (tree.leafSize == 0 || leafCount(dataSize, tree.leafSize) != tree.leaves.size())
+    {
+        throw std::invalid_argument("the tree does not match the data size");
+    }
+
+    if (offset > dataSize || length > dataSize - offset)
+    {
+        throw std::out_of_range("byte range is out of the data");
+    }
+
+    size_t const first = std::min(offset / tree.leafSize, tree.leaves.size() - 1);
+    size_t const last = length == 0 ? first : (offset + length - 1) / tree.leafSize + 1;
+
+    return {first, last};
+}
@@ -1,27 +1,14 @@
 #include "../include/hash/SHA512.h"
+#include "utilities/CpuFeatures.h"
+#include "MultiBuffer.h"
+#include "HashCheckpoint.h"
 #include <bit>
+#include <climits>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
 #include <assert.h>
 
-std::array<std::uint_fast64_t, 80> cch::hash::SHA512::K =
-    {
-    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
-            0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
-            0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
-            0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
-            0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
-            0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
-            0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
-            0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
-            0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
-            0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
-            0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
-            0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
-            0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
-            0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
-            0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
-            0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
-    };
-
 cch::hash::SHA512Hash cch::hash::SHA512::hash(std::span<cch::byte> data)
 {
     SHA512Hash hashState;
@@ -30,110 +17,151 @@ cch::hash::SHA512Hash cch::hash::SHA512::hash(std::span<cch::byte> data)
     return hashState;
 }
 
-void cch::hash::SHA512::hash(std::span<cch::byte> data, SHA512Hash &hash, std::uint64_t inputDataSize)
+std::vector<cch::hash::SHA512Hash> cch::hash::SHA512::hashMany(std::span<std::span<cch::byte const> const> messages)
+{
+    return hashMany(SHA512{}, messages);
+}
+
+std::vector<cch::hash::SHA512Hash> cch::hash::SHA512::hashMany(SHA512 const &prefix, std::span<std::span<cch::byte const> const> messages)
 {
-    for (size_t i = 0; i < (data.size() * CHAR_BIT) / 1024; ++i)
+    if (prefix.pendingBytes != 0)
     {
-        hashChunk({data.begin(), data.end()}, i, hash);
+        throw std::invalid_argument("The prefix must end on a block boundary");
     }
 
-    if ((data.size() * CHAR_BIT) % 1024)
+#if defined(CCH_ARCH_X86)
+    if (CpuFeatures::get().avx512f && messages.size() > 4)
     {
-        inputDataSize *= CHAR_BIT;
+        return detail::hashMany<SHA512Hash, 8, std::endian::big, 16>(messages, &hashLanesAVX512, prefix.hashState, prefix.processedBytes);
+    }
 
-        std::vector<cch::byte> remainingBytes;
-        size_t chunkStartIdx = data.size() - data.size() % 128;
-        remainingBytes.reserve(data.size() - chunkStartIdx);
+    if (CpuFeatures::get().avx2 && messages.size() > 1)
+    {
+        return detail::hashMany<SHA512Hash, 4, std::endian::big, 16>(messages, &hashLanesAVX2, prefix.hashState, prefix.processedBytes);
+    }
+#endif
 
-        std::copy(data.begin() + chunkStartIdx, data.end(), std::back_inserter(remainingBytes));
+    std::vector<SHA512Hash> hashes(messages.size(), prefix.hashState);
 
-        remainingBytes.push_back(0x80);
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        hash(messages[i], hashes[i], prefix.processedBytes + messages[i].size());
+    }
 
-        while (remainingBytes.size() * CHAR_BIT % 1024 != 896)
-        {
-            remainingBytes.push_back(0x00);
-        }
+    return hashes;
+}
 
-        for (size_t i = 0; i < 8; ++i)
-        {
-            remainingBytes.push_back(0x00);
-        }
+void cch::hash::SHA512::update(std::span<cch::byte const> data)
+{
+    processedBytes += data.size();
 
-        if constexpr (std::endian::native == std::endian::little)
+    // Complete the pending block first
+    if (pendingBytes > 0)
+    {
+        size_t const bytesToCopy = std::min(BLOCK_SIZE - pendingBytes, data.size());
+        std::copy_n(data.begin(), bytesToCopy, pendingBlock.begin() + pendingBytes);
+        pendingBytes += bytesToCopy;
+        data = data.subspan(bytesToCopy);
+
+        if (pendingBytes < BLOCK_SIZE)
         {
-            inputDataSize = std::byteswap(inputDataSize);
+            return;
         }
 
-        char const* dataSizePtr = reinterpret_cast<char const *>(&inputDataSize);
-        remainingBytes.insert(remainingBytes.end(), dataSizePtr, dataSizePtr + sizeof(inputDataSize));
+        hashChunk(pendingBlock, 0, hashState);
+        pendingBytes = 0;
+    }
 
-        for (size_t i = 0; i < (remainingBytes.size() * CHAR_BIT) / 1024; ++i)
-        {
-            hashChunk({remainingBytes.begin(), remainingBytes.end()}, i, hash);
-        }
+    // Hash the complete blocks in place
+    for (size_t i = 0; i < data.size() / BLOCK_SIZE; ++i)
+    {
+        hashChunk(data, i, hashState);
     }
+
+    // Keep the tail until more data arrives
+    pendingBytes = data.size() % BLOCK_SIZE;
+    std::copy(data.end() - pendingBytes, data.end(), pendingBlock.begin());
 }
 
-void cch::hash::SHA512::hashChunk(std::span<cch::byte> data, size_t chunkIdx, SHA512Hash &hashState)
+cch::hash::SHA512Hash cch::hash::SHA512::finalize()
 {
-    std::vector<cch::byte> block;
-    block.reserve(128);
-    std::copy(data.begin() + chunkIdx * 128, data.begin() + (chunkIdx + 1) * 128, std::back_inserter(block));
+    hash({pendingBlock.data(), pendingBytes}, hashState, processedBytes);
 
-    assert(block.size() == 128);
-    std::uint_fast64_t* int64Ptr = reinterpret_cast<std::uint_fast64_t*>(block.data());
+    auto const result = hashState;
+    reset();
 
-    hashState += calculateHash({int64Ptr, block.size() / sizeof(std::uint_fast64_t)}, hashState);
+    return result;
 }
 
-cch::hash::SHA512Hash cch::hash::SHA512::calculateHash(std::span<std::uint_fast64_t> data, SHA512Hash &hashState)
+void cch::hash::SHA512::reset() noexcept
 {
-    assert(data.size() * sizeof(std::uint_fast64_t) * CHAR_BIT == 1024);
+    hashState = SHA512Hash{};
+    pendingBytes = 0;
+    processedBytes = 0;
+}
 
-    std::array<std::uint_fast64_t, 80> w;
-    std::copy(data.begin(), data.end(), w.begin());
+std::vector<cch::byte> cch::hash::SHA512::saveState() const
+{
+    return detail::checkpoint::save(detail::checkpoint::Algorithm::SHA512, std::span<std::uint64_t const>(hashState.parts),
+        processedBytes, std::span<cch::byte const>(pendingBlock.data(), pendingBytes));
+}
 
-    for (size_t i = 0; i < 16; ++i)
+void cch::hash::SHA512::restoreState(std::span<cch::byte const> state)
+{
+    pendingBytes = detail::checkpoint::restore(detail::checkpoint::Algorithm::SHA512, state,
+        std::span(hashState.parts), processedBytes, pendingBlock);
+}
+
+void cch::hash::SHA512::hash(std::span<cch::byte const> data, SHA512Hash &hash, std::uint64_t inputDataSize)
+{
+    size_t const chunkCount = data.size() / BLOCK_SIZE;
+
+    for (size_t i = 0; i < chunkCount; ++i)
     {
-        w[i] = std::byteswap(w[i]);
+        hashChunk(data, i, hash);
     }
 
-    for (size_t i = 16; i < w.size(); ++i)
+    // The padding is always appended, even if the data is a multiple of the block size
+    // Together with the tail of the data it takes one or two blocks
+    std::array<cch::byte, 2 * BLOCK_SIZE> remainingBytes{};
+    size_t const tailSize = data.size() % BLOCK_SIZE;
+    std::copy(data.begin() + chunkCount * BLOCK_SIZE, data.end(), remainingBytes.begin());
+    remainingBytes[tailSize] = 0x80;
+
+    // The length field is 128-bit, its upper half stays zero
+    size_t const paddingChunks = tailSize + 1 + 2 * sizeof(inputDataSize) > BLOCK_SIZE ? 2 : 1;
+
+    // Message length in bits, big endian
+    inputDataSize *= CHAR_BIT;
+
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        inputDataSize = std::byteswap(inputDataSize);
+    }
+
+    std::memcpy(remainingBytes.data() + paddingChunks * BLOCK_SIZE - sizeof(inputDataSize), &inputDataSize, sizeof(inputDataSize));
+
+    for (size_t i = 0; i < paddingChunks; ++i)
     {
-        auto s0 = std::rotr(w[i - 15], 1) ^ std::rotr(w[i - 15], 8) ^ (w[i - 15] >> 7);
-        auto s1 = std::rotr(w[i - 2], 19) ^ std::rotr(w[i - 2], 61) ^ (w[i - 2] >> 6);
-        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        hashChunk(remainingBytes, i, hash);
     }
+}
 
-    auto t = hashState.parts;
+void cch::hash::SHA512::hashChunk(std::span<cch::byte const> data, size_t chunkIdx, SHA512Hash &hashState)
+{
+    assert(data.size() >= (chunkIdx + 1) * BLOCK_SIZE);
 
-    auto& A = t[0];
-    auto& B = t[1];
-    auto& C = t[2];
-    auto& D = t[3];
-    auto& E = t[4];
-    auto& F = t[5];
-    auto& G = t[6];
-    auto& H = t[7];
+    // SHA512 words are big endian
+    std::array<std::uint64_t, 16> block;
+    std::memcpy(block.data(), data.data() + chunkIdx * BLOCK_SIZE, BLOCK_SIZE);
 
-    for (size_t i = 0; i < 80; ++i)
+    if constexpr (std::endian::native == std::endian::little)
     {
-        auto S1 = std::rotr(E, 14) ^ std::rotr(E, 18) ^ std::rotr(E, 41);
-        auto ch = (E & F) ^ ((~E) & G);
-        auto tmp1 = H + S1 + ch + K[i] + w[i];
-        auto S0 = std::rotr(A, 28) ^ std::rotr(A, 34) ^ std::rotr(A, 39);
-        auto maj = (A & B) ^ (A & C) ^ (B & C);
-        auto tmp2 = S0 + maj;
-
-        H = G;
-        G = F;
-        F = E;
-        E = D + tmp1;
-        D = C;
-        C = B;
-        B = A;
-        A = tmp1 + tmp2;
+        for (auto &word : block)
+        {
+            word = std::byteswap(word);
+        }
     }
 
-    return SHA512Hash{t};
-}
\ No newline at end of file
+    hashState += calculateHash(block, hashState);
+}
@@ -0,0 +1,235 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <immintrin.h>
+
+// Thin wrappers over SIMD registers used by the multi-buffer hash kernels
+// Each wrapper is only visible in translation units compiled with the matching instruction set
+namespace cch::hash::detail
+{
+#if defined(__AVX2__)
+    /// 8 lanes of 32-bit words
+    struct U32x8
+    {
+        static size_t const inline LANES = 8;
+        __m256i v;
+
+        static U32x8 load(std::uint32_t const *ptr)
+        {
+            return {_mm256_load_si256(reinterpret_cast<__m256i const*>(ptr))};
+        }
+
+        void store(std::uint32_t *ptr) const
+        {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(ptr), v);
+        }
+
+        static U32x8 broadcast(std::uint32_t value)
+        {
+            return {_mm256_set1_epi32(static_cast<int>(value))};
+        }
+
+        friend U32x8 operator+(U32x8 a, U32x8 b) { return {_mm256_add_epi32(a.v, b.v)}; }
+        friend U32x8 operator^(U32x8 a, U32x8 b) { return {_mm256_xor_si256(a.v, b.v)}; }
+        friend U32x8 operator&(U32x8 a, U32x8 b) { return {_mm256_and_si256(a.v, b.v)}; }
+        friend U32x8 operator|(U32x8 a, U32x8 b) { return {_mm256_or_si256(a.v, b.v)}; }
+    };
+
+    /// (x & y) | (~x & z)
+    inline U32x8 choose(U32x8 x, U32x8 y, U32x8 z)
+    {
+        return {_mm256_xor_si256(_mm256_and_si256(x.v, _mm256_xor_si256(y.v, z.v)), z.v)};
+    }
+
+    /// (x & y) | (x & z) | (y & z)
+    inline U32x8 majority(U32x8 x, U32x8 y, U32x8 z)
+    {
+        return {_mm256_or_si256(_mm256_and_si256(x.v, y.v), _mm256_and_si256(z.v, _mm256_or_si256(x.v, y.v)))};
+    }
+
+    inline U32x8 xor3(U32x8 x, U32x8 y, U32x8 z)
+    {
+        return {_mm256_xor_si256(_mm256_xor_si256(x.v, y.v), z.v)};
+    }
+
+    /// y ^ (x | ~z)
+    inline U32x8 xorOrNot(U32x8 x, U32x8 y, U32x8 z)
+    {
+        return {_mm256_xor_si256(y.v, _mm256_or_si256(x.v, _mm256_xor_si256(z.v, _mm256_set1_epi32(-1))))};
+    }
+
+    template <int N>
+    U32x8 rotr(U32x8 x)
+    {
+        return {_mm256_or_si256(_mm256_srli_epi32(x.v, N), _mm256_slli_epi32(x.v, 32 - N))};
+    }
+
+    template <int N>
+    U32x8 shr(U32x8 x)
+    {
+        return {_mm256_srli_epi32(x.v, N)};
+    }
+
+    /// 4 lanes of 64-bit words
+    struct U64x4
+    {
+        static size_t const inline LANES = 4;
+        __m256i v;
+
+        static U64x4 load(std::uint64_t const *ptr)
+        {
+            return {_mm256_load_si256(reinterpret_cast<__m256i const*>(ptr))};
+        }
+
+        void store(std::uint64_t *ptr) const
+        {
+            _mm256_store_si256(reinterpret_cast<__m256i*>(ptr), v);
+        }
+
+        static U64x4 broadcast(std::uint64_t value)
+        {
+            return {_mm256_set1_epi64x(static_cast<long long>(value))};
+        }
+
+        friend U64x4 operator+(U64x4 a, U64x4 b) { return {_mm256_add_epi64(a.v, b.v)}; }
+        friend U64x4 operator^(U64x4 a, U64x4 b) { return {_mm256_xor_si256(a.v, b.v)}; }
+        friend U64x4 operator&(U64x4 a, U64x4 b) { return {_mm256_and_si256(a.v, b.v)}; }
+        friend U64x4 operator|(U64x4 a, U64x4 b) { return {_mm256_or_si256(a.v, b.v)}; }
+    };
+
+    inline U64x4 choose(U64x4 x, U64x4 y, U64x4 z)
+    {
+        return {_mm256_xor_si256(_mm256_and_si256(x.v, _mm256_xor_si256(y.v, z.v)), z.v)};
+    }
+
+    inline U64x4 majority(U64x4 x, U64x4 y, U64x4 z)
+    {
+        return {_mm256_or_si256(_mm256_and_si256(x.v, y.v), _mm256_and_si256(z.v, _mm256_or_si256(x.v, y.v)))};
+    }
+
+    template <int N>
+    U64x4 rotr(U64x4 x)
+    {
+        return {_mm256_or_si256(_mm256_srli_epi64(x.v, N), _mm256_slli_epi64(x.v, 64 - N))};
+    }
+
+    template <int N>
+    U64x4 shr(U64x4 x)
+    {
+        return {_mm256_srli_epi64(x.v, N)};
+    }
+#endif
+
+#if defined(__AVX512F__)
+    /// 16 lanes of 32-bit words
+    struct U32x16
+    {
+        static size_t const inline LANES = 16;
+        __m512i v;
+
+        static U32x16 load(std::uint32_t const *ptr)
+        {
+            return {_mm512_load_si512(ptr)};
+        }
+
+        void store(std::uint32_t *ptr) const
+        {
+            _mm512_store_si512(ptr, v);
+        }
+
+        static U32x16 broadcast(std::uint32_t value)
+        {
+            return {_mm512_set1_epi32(static_cast<int>(value))};
+        }
+
+        friend U32x16 operator+(U32x16 a, U32x16 b) { return {_mm512_add_epi32(a.v, b.v)}; }
+        friend U32x16 operator^(U32x16 a, U32x16 b) { return {_mm512_xor_si512(a.v, b.v)}; }
+        friend U32x16 operator&(U32x16 a, U32x16 b) { return {_mm512_and_si512(a.v, b.v)}; }
+        friend U32x16 operator|(U32x16 a, U32x16 b) { return {_mm512_or_si512(a.v, b.v)}; }
+    };
+
+    /// (x & y) | (~x & z), a single ternary logic instruction
+    inline U32x16 choose(U32x16 x, U32x16 y, U32x16 z)
+    {
+        return {_mm512_ternarylogic_epi32(x.v, y.v, z.v, 0xCA)};
+    }
+
+    /// (x & y) | (x & z) | (y & z), a single ternary logic instruction
+    inline U32x16 majority(U32x16 x, U32x16 y, U32x16 z)
+    {
+        return {_mm512_ternarylogic_epi32(x.v, y.v, z.v, 0xE8)};
+    }
+
+    inline U32x16 xor3(U32x16 x, U32x16 y, U32x16 z)
+    {
+        return {_mm512_ternarylogic_epi32(x.v, y.v, z.v, 0x96)};
+    }
+
+    /// y ^ (x | ~z), a single ternary logic instruction
+    inline U32x16 xorOrNot(U32x16 x, U32x16 y, U32x16 z)
+    {
+        return {_mm512_ternarylogic_epi32(x.v, y.v, z.v, 0x39)};
+    }
+
+    template <int N>
+    U32x16 rotr(U32x16 x)
+    {
+        return {_mm512_ror_epi32(x.v, N)};
+    }
+
+    template <int N>
+    U32x16 shr(U32x16 x)
+    {
+        return {_mm512_srli_epi32(x.v, N)};
+    }
+
+    /// 8 lanes of 64-bit words
+    struct U64x8
+    {
+        static size_t const inline LANES = 8;
+        __m512i v;
+
+        static U64x8 load(std::uint64_t const *ptr)
+        {
+            return {_mm512_load_si512(ptr)};
+        }
+
+        void store(std::uint64_t *ptr) const
+        {
+            _mm512_store_si512(ptr, v);
+        }
+
+        static U64x8 broadcast(std::uint64_t value)
+        {
+            return {_mm512_set1_epi64(static_cast<long long>(value))};
+        }
+
+        friend U64x8 operator+(U64x8 a, U64x8 b) { return {_mm512_add_epi64(a.v, b.v)}; }
+        friend U64x8 operator^(U64x8 a, U64x8 b) { return {_mm512_xor_si512(a.v, b.v)}; }
+        friend U64x8 operator&(U64x8 a, U64x8 b) { return {_mm512_and_si512(a.v, b.v)}; }
+        friend U64x8 operator|(U64x8 a, U64x8 b) { return {_mm512_or_si512(a.v, b.v)}; }
+    };
+
+    inline U64x8 choose(U64x8 x, U64x8 y, U64x8 z)
+    {
+        return {_mm512_ternarylogic_epi64(x.v, y.v, z.v, 0xCA)};
+    }
+
+    inline U64x8 majority(U64x8 x, U64x8 y, U64x8 z)
+    {
+        return {_mm512_ternarylogic_epi64(x.v, y.v, z.v, 0xE8)};
+    }
+
+    template <int N>
+    U64x8 rotr(U64x8 x)
+    {
+        return {_mm512_ror_epi64(x.v, N)};
+    }
+
+    template <int N>
+    U64x8 shr(U64x8 x)
+    {
+        return {_mm512_srli_epi64(x.v, N)};
+    }
+#endif
+}
@@ -0,0 +1,730 @@
+#include "../include/hash/XXH3.h"
+#include "utilities/CpuFeatures.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(CCH_ARCH_X86) && (defined(__SSE2__) || defined(_M_X64))
+    #include <emmintrin.h>
+    #define CCH_XXH3_SSE2 1
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+    #include <intrin.h>
+#endif
+
+namespace
+{
+    std::uint32_t const PRIME32_1 = 0x9E3779B1;
+    std::uint32_t const PRIME32_2 = 0x85EBCA77;
+    std::uint32_t const PRIME32_3 = 0xC2B2AE3D;
+    std::uint64_t const PRIME64_1 = 0x9E3779B185EBCA87;
+    std::uint64_t const PRIME64_2 = 0xC2B2AE3D27D4EB4F;
+    std::uint64_t const PRIME64_3 = 0x165667B19E3779F9;
+    std::uint64_t const PRIME64_4 = 0x85EBCA77C2B2AE63;
+    std::uint64_t const PRIME64_5 = 0x27D4EB2F165667C5;
+    std::uint64_t const PRIME_MX1 = 0x165667919E3779F9;
+    std::uint64_t const PRIME_MX2 = 0x9FB21C651E98DF25;
+
+    /// Offsets into the secret used by the different input sizes
+    size_t const SECRET_SIZE_MIN = 136;
+    size_t const MIDSIZE_START_OFFSET = 3;
+    size_t const MIDSIZE_LAST_OFFSET = 17;
+    size_t const SECRET_LASTACC_START = 7;
+    size_t const SECRET_MERGEACCS_START = 11;
+
+    template <typename Word>
+    Word read(cch::byte const *data)
+    {
+        Word word;
+        std::memcpy(&word, data, sizeof(Word));
+
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = std::byteswap(word);
+        }
+
+        return word;
+    }
+
+    template <typename Word>
+    void write(cch::byte *data, Word word)
+    {
+        if constexpr (std::endian::native == std::endian::big)
+        {
+            word = std::byteswap(word);
+        }
+
+        std::memcpy(data, &word, sizeof(Word));
+    }
+
+    struct U128
+    {
+        std::uint64_t low;
+        std::uint64_t high;
+    };
+
+    U128 multiply(std::uint64_t a, std::uint64_t b)
+    {
+    #if defined(__SIZEOF_INT128__)
+        auto const product = static_cast<unsigned __int128>(a) * b;
+        return {static_cast<std::uint64_t>(product), static_cast<std::uint64_t>(product >> 64)};
+    #elif defined(_MSC_VER) && defined(_M_X64)
+        std::uint64_t high;
+        std::uint64_t const low = _umul128(a, b, &high);
+        return {low, high};
+    #else
+        std::uint64_t const loLo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        std::uint64_t const hiLo = (a >> 32) * (b & 0xFFFFFFFF);
+        std::uint64_t const loHi = (a & 0xFFFFFFFF) * (b >> 32);
+        std::uint64_t const hiHi = (a >> 32) * (b >> 32);
+        std::uint64_t const cross = (loLo >> 32) + (hiLo & 0xFFFFFFFF) + loHi;
+        return {(cross << 32) | (loLo & 0xFFFFFFFF), hiHi + (hiLo >> 32) + (cross >> 32)};
+    #endif
+    }
+
+    std::uint64_t multiplyFold(std::uint64_t a, std::uint64_t b)
+    {
+        auto const product = multiply(a, b);
+        return product.low ^ product.high;
+    }
+
+    std::uint64_t avalanche(std::uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= PRIME_MX1;
+        return h ^ (h >> 32);
+    }
+
+    /// Final mix of XXH64, used by the shortest inputs
+    std::uint64_t avalancheXXH64(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= PRIME64_2;
+        h ^= h >> 29;
+        h *= PRIME64_3;
+        return h ^ (h >> 32);
+    }
+
+    std::uint64_t rrmxmx(std::uint64_t h, std::uint64_t length)
+    {
+        h ^= std::rotl(h, 49) ^ std::rotl(h, 24);
+        h *= PRIME_MX2;
+        h ^= (h >> 35) + length;
+        h *= PRIME_MX2;
+        return h ^ (h >> 28);
+    }
+
+    std::uint64_t mix16(cch::byte const *input, cch::byte const *secret, std::uint64_t seed)
+    {
+        return multiplyFold(read<std::uint64_t>(input) ^ (read<std::uint64_t>(secret) + seed),
+                            read<std::uint64_t>(input + 8) ^ (read<std::uint64_t>(secret + 8) - seed));
+    }
+
+    void mix32(U128 &acc, cch::byte const *input1, cch::byte const *input2, cch::byte const *secret, std::uint64_t seed)
+    {
+        acc.low += mix16(input1, secret, seed);
+        acc.low ^= read<std::uint64_t>(input2) + read<std::uint64_t>(input2 + 8);
+        acc.high += mix16(input2, secret + 16, seed);
+        acc.high ^= read<std::uint64_t>(input1) + read<std::uint64_t>(input1 + 8);
+    }
+}
+
+alignas(64) std::array<cch::byte, cch::hash::XXH3::SECRET_SIZE> const cch::hash::XXH3::DEFAULT_SECRET =
+{
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e
+};
+
+cch::hash::XXH3::Accumulators const cch::hash::XXH3::INITIAL_ACCUMULATORS =
+{
+    PRIME32_3, PRIME64_1, PRIME64_2, PRIME64_3, PRIME64_4, PRIME32_2, PRIME64_5, PRIME32_1
+};
+
+std::array<cch::hash::XXH3::Kernel, 4> const cch::hash::XXH3::KERNELS =
+{{
+    {Backend::Scalar, &accumulateScalar, &scrambleScalar},
+    {Backend::SSE2, &accumulateSSE2, &scrambleSSE2},
+    {Backend::AVX2, &accumulateAVX2, &scrambleAVX2},
+    {Backend::AVX512, &accumulateAVX512, &scrambleAVX512}
+}};
+
+std::atomic<cch::hash::XXH3::Kernel const *> cch::hash::XXH3::selectedKernel = nullptr;
+
+cch::hash::XXH3::XXH3(std::uint64_t seed) :
+    seed(seed)
+{
+    reset();
+}
+
+std::uint64_t cch::hash::XXH3::hash64(std::span<cch::byte const> data, std::uint64_t seed)
+{
+    if (data.size() <= MIDSIZE_MAX)
+    {
+        return hash64Short(data, seed);
+    }
+
+    alignas(64) Accumulators acc;
+
+    if (seed == 0)
+    {
+        hashLong(data, acc, DEFAULT_SECRET.data());
+        return longDigest64(acc, DEFAULT_SECRET.data(), data.size());
+    }
+
+    alignas(64) std::array<cch::byte, SECRET_SIZE> secret;
+    deriveSecret(seed, secret);
+    hashLong(data, acc, secret.data());
+
+    return longDigest64(acc, secret.data(), data.size());
+}
+
+cch::hash::XXH3Hash128 cch::hash::XXH3::hash128(std::span<cch::byte const> data, std::uint64_t seed)
+{
+    if (data.size() <= MIDSIZE_MAX)
+    {
+        return hash128Short(data, seed);
+    }
+
+    alignas(64) Accumulators acc;
+
+    if (seed == 0)
+    {
+        hashLong(data, acc, DEFAULT_SECRET.data());
+        return longDigest128(acc, DEFAULT_SECRET.data(), data.size());
+    }
+
+    alignas(64) std::array<cch::byte, SECRET_SIZE> secret;
+    deriveSecret(seed, secret);
+    hashLong(data, acc, secret.data());
+
+    return longDigest128(acc, secret.data(), data.size());
+}
+
+void cch::hash::XXH3::update(std::span<cch::byte const> data)
+{
+    totalBytes += data.size();
+
+    if (bufferedBytes + data.size() <= BUFFER_SIZE)
+    {
+        std::copy(data.begin(), data.end(), buffer.begin() + bufferedBytes);
+        bufferedBytes += data.size();
+        return;
+    }
+
+    // The last byte is never accumulated here, the digest needs the final stripe
+    // Complete the buffered data first
+    if (bufferedBytes > 0)
+    {
+        size_t const bytesToCopy = BUFFER_SIZE - bufferedBytes;
+        std::copy_n(data.begin(), bytesToCopy, buffer.begin() + bufferedBytes);
+        data = data.subspan(bytesToCopy);
+
+        consumeStripes(acc, stripesInBlock, buffer.data(), BUFFER_SIZE / STRIPE_SIZE, secret.data());
+        bufferedBytes = 0;
+    }
+
+    // Accumulate the long inputs in place
+    if (data.size() > BUFFER_SIZE)
+    {
+        size_t const stripeCount = (data.size() - 1) / STRIPE_SIZE;
+        consumeStripes(acc, stripesInBlock, data.data(), stripeCount, secret.data());
+
+        // Keep the last accumulated stripe, the final stripe of the digest may overlap it
+        std::copy_n(data.begin() + (stripeCount - 1) * STRIPE_SIZE, STRIPE_SIZE, buffer.end() - STRIPE_SIZE);
+        data = data.subspan(stripeCount * STRIPE_SIZE);
+    }
+
+    std::copy(data.begin(), data.end(), buffer.begin());
+    bufferedBytes = data.size();
+}
+
+std::uint64_t cch::hash::XXH3::digest64() const
+{
+    if (totalBytes <= MIDSIZE_MAX)
+    {
+        return hash64Short({buffer.data(), bufferedBytes}, seed);
+    }
+
+    alignas(64) Accumulators finalAcc;
+    finalAccumulators(finalAcc);
+
+    return longDigest64(finalAcc, secret.data(), totalBytes);
+}
+
+cch::hash::XXH3Hash128 cch::hash::XXH3::digest128() const
+{
+    if (totalBytes <= MIDSIZE_MAX)
+    {
+        return hash128Short({buffer.data(), bufferedBytes}, seed);
+    }
+
+    alignas(64) Accumulators finalAcc;
+    finalAccumulators(finalAcc);
+
+    return longDigest128(finalAcc, secret.data(), totalBytes);
+}
+
+void cch::hash::XXH3::reset() noexcept
+{
+    acc = INITIAL_ACCUMULATORS;
+    bufferedBytes = 0;
+    stripesInBlock = 0;
+    totalBytes = 0;
+
+    if (seed == 0)
+    {
+        secret = DEFAULT_SECRET;
+    }
+    else
+    {
+        deriveSecret(seed, secret);
+    }
+}
+
+std::uint64_t cch::hash::XXH3::hash64Short(std::span<cch::byte const> data, std::uint64_t seed)
+{
+    cch::byte const *input = data.data();
+    cch::byte const *secret = DEFAULT_SECRET.data();
+    std::uint64_t const length = data.size();
+
+    if (length == 0)
+    {
+        return avalancheXXH64(seed ^ read<std::uint64_t>(secret + 56) ^ read<std::uint64_t>(secret + 64));
+    }
+
+    if (length <= 3)
+    {
+        std::uint32_t const combined = (static_cast<std::uint32_t>(input[0]) << 16) | (static_cast<std::uint32_t>(input[length >> 1]) << 24) |
+                                       static_cast<std::uint32_t>(input[length - 1]) | static_cast<std::uint32_t>(length << 8);
+        std::uint64_t const bitflip = (read<std::uint32_t>(secret) ^ read<std::uint32_t>(secret + 4)) + seed;
+
+        return avalancheXXH64(combined ^ bitflip);
+    }
+
+    if (length <= 8)
+    {
+        seed ^= static_cast<std::uint64_t>(std::byteswap(static_cast<std::uint32_t>(seed))) << 32;
+        std::uint64_t const bitflip = (read<std::uint64_t>(secret + 8) ^ read<std::uint64_t>(secret + 16)) - seed;
+        std::uint64_t const input64 = read<std::uint32_t>(input + length - 4) + (static_cast<std::uint64_t>(read<std::uint32_t>(input)) << 32);
+
+        return rrmxmx(input64 ^ bitflip, length);
+    }
+
+    if (length <= 16)
+    {
+        std::uint64_t const bitflip1 = (read<std::uint64_t>(secret + 24) ^ read<std::uint64_t>(secret + 32)) + seed;
+        std::uint64_t const bitflip2 = (read<std::uint64_t>(secret + 40) ^ read<std::uint64_t>(secret + 48)) - seed;
+        std::uint64_t const inputLow = read<std::uint64_t>(input) ^ bitflip1;
+        std::uint64_t const inputHigh = read<std::uint64_t>(input + length - 8) ^ bitflip2;
+
+        return avalanche(length + std::byteswap(inputLow) + inputHigh + multiplyFold(inputLow, inputHigh));
+    }
+
+    std::uint64_t acc = length * PRIME64_1;
+
+    if (length <= 128)
+    {
+        // Pairs of 16-byte lanes from both ends of the input
+        if (length > 32)
+        {
+            if (length > 64)
+            {
+                if (length > 96)
+                {
+                    acc += mix16(input + 48, secret + 96, seed);
+                    acc += mix16(input + length - 64, secret + 112, seed);
+                }
+
+                acc += mix16(input + 32, secret + 64, seed);
+                acc += mix16(input + length - 48, secret + 80, seed);
+            }
+
+            acc += mix16(input + 16, secret + 32, seed);
+            acc += mix16(input + length - 32, secret + 48, seed);
+        }
+
+        acc += mix16(input, secret, seed);
+        acc += mix16(input + length - 16, secret + 16, seed);
+
+        return avalanche(acc);
+    }
+
+    size_t const rounds = length / 16;
+
+    for (size_t i = 0; i < 8; ++i)
+    {
+        acc += mix16(input + 16 * i, secret + 16 * i, seed);
+    }
+
+    acc = avalanche(acc);
+
+    for (size_t i = 8; i < rounds; ++i)
+    {
+        acc += mix16(input + 16 * i, secret + 16 * (i - 8) + MIDSIZE_START_OFFSET, seed);
+    }
+
+    acc += mix16(input + length - 16, secret + SECRET_SIZE_MIN - MIDSIZE_LAST_OFFSET, seed);
+
+    return avalanche(acc);
+}
+
+cch::hash::XXH3Hash128 cch::hash::XXH3::hash128Short(std::span<cch::byte const> data, std::uint64_t seed)
+{
+    cch::byte const *input = data.data();
+    cch::byte const *secret = DEFAULT_SECRET.data();
+    std::uint64_t const length = data.size();
+
+    if (length == 0)
+    {
+        return {avalancheXXH64(seed ^ read<std::uint64_t>(secret + 64) ^ read<std::uint64_t>(secret + 72)),
+                avalancheXXH64(seed ^ read<std::uint64_t>(secret + 80) ^ read<std::uint64_t>(secret + 88))};
+    }
+
+    if (length <= 3)
+    {
+        std::uint32_t const combinedLow = (static_cast<std::uint32_t>(input[0]) << 16) | (static_cast<std::uint32_t>(input[length >> 1]) << 24) |
+                                          static_cast<std::uint32_t>(input[length - 1]) | static_cast<std::uint32_t>(length << 8);
+        std::uint32_t const combinedHigh = std::rotl(std::byteswap(combinedLow), 13);
+        std::uint64_t const bitflipLow = (read<std::uint32_t>(secret) ^ read<std::uint32_t>(secret + 4)) + seed;
+        std::uint64_t const bitflipHigh = (read<std::uint32_t>(secret + 8) ^ read<std::uint32_t>(secret + 12)) - seed;
+
+        return {avalancheXXH64(combinedLow ^ bitflipLow), avalancheXXH64(combinedHigh ^ bitflipHigh)};
+    }
+
+    if (length <= 8)
+    {
+        seed ^= static_cast<std::uint64_t>(std::byteswap(static_cast<std::uint32_t>(seed))) << 32;
+        std::uint64_t const input64 = read<std::uint32_t>(input) + (static_cast<std::uint64_t>(read<std::uint32_t>(input + length - 4)) << 32);
+        std::uint64_t const bitflip = (read<std::uint64_t>(secret + 16) ^ read<std::uint64_t>(secret + 24)) + seed;
+
+        auto m = multiply(input64 ^ bitflip, PRIME64_1 + (length << 2));
+        m.high += m.low << 1;
+        m.low ^= m.high >> 3;
+        m.low ^= m.low >> 35;
+        m.low *= PRIME_MX2;
+        m.low ^= m.low >> 28;
+
+        return {m.low, avalanche(m.high)};
+    }
+
+    if (length <= 16)
+    {
+        std::uint64_t const bitflipLow = (read<std::uint64_t>(secret + 32) ^ read<std::uint64_t>(secret + 40)) - seed;
+        std::uint64_t const bitflipHigh = (read<std::uint64_t>(secret + 48) ^ read<std::uint64_t>(secret + 56)) + seed;
+        std::uint64_t const inputLow = read<std::uint64_t>(input);
+        std::uint64_t inputHigh = read<std::uint64_t>(input + length - 8);
+
+        auto m = multiply(inputLow ^ inputHigh ^ bitflipLow, PRIME64_1);
+        m.low += (length - 1) << 54;
+        inputHigh ^= bitflipHigh;
+        m.high += inputHigh + static_cast<std::uint64_t>(static_cast<std::uint32_t>(inputHigh)) * (PRIME32_2 - 1);
+        m.low ^= std::byteswap(m.high);
+
+        auto h = multiply(m.low, PRIME64_2);
+        h.high += m.high * PRIME64_2;
+
+        return {avalanche(h.low), avalanche(h.high)};
+    }
+
+    U128 acc = {length * PRIME64_1, 0};
+
+    if (length <= 128)
+    {
+        if (length > 32)
+        {
+            if (length > 64)
+            {
+                if (length > 96)
+                {
+                    mix32(acc, input + 48, input + length - 64, secret + 96, seed);
+                }
+
+                mix32(acc, input + 32, input + length - 48, secret + 64, seed);
+            }
+
+            mix32(acc, input + 16, input + length - 32, secret + 32, seed);
+        }
+
+        mix32(acc, input, input + length - 16, secret, seed);
+    }
+    else
+    {
+        size_t const rounds = length / 32;
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            mix32(acc, input + 32 * i, input + 32 * i + 16, secret + 32 * i, seed);
+        }
+
+        acc.low = avalanche(acc.low);
+        acc.high = avalanche(acc.high);
+
+        for (size_t i = 4; i < rounds; ++i)
+        {
+            mix32(acc, input + 32 * i, input + 32 * i + 16, secret + MIDSIZE_START_OFFSET + 32 * (i - 4), seed);
+        }
+
+        mix32(acc, input + length - 16, input + length - 32, secret + SECRET_SIZE_MIN - MIDSIZE_LAST_OFFSET - 16, 0 - seed);
+    }
+
+    std::uint64_t const low = acc.low + acc.high;
+    std::uint64_t const high = acc.low * PRIME64_1 + acc.high * PRIME64_4 + (length - seed) * PRIME64_2;
+
+    return {avalanche(low), 0 - avalanche(high)};
+}
+
+void cch::hash::XXH3::hashLong(std::span<cch::byte const> data, Accumulators &acc, cch::byte const *secret)
+{
+    acc = INITIAL_ACCUMULATORS;
+
+    size_t stripesInBlock = 0;
+    consumeStripes(acc, stripesInBlock, data.data(), (data.size() - 1) / STRIPE_SIZE, secret);
+
+    // The final stripe always ends at the last byte, it may overlap the previous one
+    kernel().accumulate(acc.data(), data.data() + data.size() - STRIPE_SIZE, secret + SECRET_SIZE - STRIPE_SIZE - SECRET_LASTACC_START, 1);
+}
+
+void cch::hash::XXH3::finalAccumulators(Accumulators &finalAcc) const
+{
+    finalAcc = acc;
+    size_t finalStripesInBlock = stripesInBlock;
+
+    // Accumulate the buffered data except the final stripe
+    if (bufferedBytes > STRIPE_SIZE)
+    {
+        consumeStripes(finalAcc, finalStripesInBlock, buffer.data(), (bufferedBytes - 1) / STRIPE_SIZE, secret.data());
+    }
+
+    // The final stripe always ends at the last byte, it may overlap data accumulated before
+    std::array<cch::byte, STRIPE_SIZE> lastStripe;
+
+    if (bufferedBytes >= STRIPE_SIZE)
+    {
+        std::copy_n(buffer.begin() + bufferedBytes - STRIPE_SIZE, STRIPE_SIZE, lastStripe.begin());
+    }
+    else
+    {
+        size_t const catchUp = STRIPE_SIZE - bufferedBytes;
+        std::copy_n(buffer.end() - catchUp, catchUp, lastStripe.begin());
+        std::copy_n(buffer.begin(), bufferedBytes, lastStripe.begin() + catchUp);
+    }
+
+    kernel().accumulate(finalAcc.data(), lastStripe.data(), secret.data() + SECRET_SIZE - STRIPE_SIZE - SECRET_LASTACC_START, 1);
+}
+
+void cch::hash::XXH3::consumeStripes(Accumulators &acc, size_t &stripesInBlock, cch::byte const *input, size_t stripeCount, cch::byte const *secret)
+{
+    auto const &k = kernel();
+
+    while (stripeCount > 0)
+    {
+        size_t const stripes = std::min(stripeCount, STRIPES_PER_BLOCK - stripesInBlock);
+        k.accumulate(acc.data(), input, secret + stripesInBlock * 8, stripes);
+
+        input += stripes * STRIPE_SIZE;
+        stripeCount -= stripes;
+        stripesInBlock += stripes;
+
+        if (stripesInBlock == STRIPES_PER_BLOCK)
+        {
+            k.scramble(acc.data(), secret + SECRET_SIZE - STRIPE_SIZE);
+            stripesInBlock = 0;
+        }
+    }
+}
+
+std::uint64_t cch::hash::XXH3::mergeAccumulators(Accumulators const &acc, cch::byte const *secret, std::uint64_t start)
+{
+    std::uint64_t result = start;
+
+    for (size_t i = 0; i < acc.size(); i += 2)
+    {
+        result += multiplyFold(acc[i] ^ read<std::uint64_t>(secret + 8 * i), acc[i + 1] ^ read<std::uint64_t>(secret + 8 * i + 8));
+    }
+
+    return avalanche(result);
+}
+
+std::uint64_t cch::hash::XXH3::longDigest64(Accumulators const &acc, cch::byte const *secret, std::uint64_t length)
+{
+    return mergeAccumulators(acc, secret + SECRET_MERGEACCS_START, length * PRIME64_1);
+}
+
+cch::hash::XXH3Hash128 cch::hash::XXH3::longDigest128(Accumulators const &acc, cch::byte const *secret, std::uint64_t length)
+{
+    return {mergeAccumulators(acc, secret + SECRET_MERGEACCS_START, length * PRIME64_1),
+            mergeAccumulators(acc, secret + SECRET_SIZE - STRIPE_SIZE - SECRET_MERGEACCS_START, ~(length * PRIME64_2))};
+}
+
+void cch::hash::XXH3::deriveSecret(std::uint64_t seed, std::array<cch::byte, SECRET_SIZE> &secret)
+{
+    for (size_t i = 0; i < SECRET_SIZE; i += 16)
+    {
+        write<std::uint64_t>(secret.data() + i, read<std::uint64_t>(DEFAULT_SECRET.data() + i) + seed);
+        write<std::uint64_t>(secret.data() + i + 8, read<std::uint64_t>(DEFAULT_SECRET.data() + i + 8) - seed);
+    }
+}
+
+void cch::hash::XXH3::accumulateScalar(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    for (size_t s = 0; s < stripeCount; ++s, input += STRIPE_SIZE, secret += 8)
+    {
+        for (size_t i = 0; i < 8; ++i)
+        {
+            std::uint64_t const dataValue = read<std::uint64_t>(input + 8 * i);
+            std::uint64_t const dataKey = dataValue ^ read<std::uint64_t>(secret + 8 * i);
+
+            acc[i ^ 1] += dataValue;
+            acc[i] += static_cast<std::uint64_t>(static_cast<std::uint32_t>(dataKey)) * (dataKey >> 32);
+        }
+    }
+}
+
+void cch::hash::XXH3::scrambleScalar(std::uint64_t *acc, cch::byte const *secret)
+{
+    for (size_t i = 0; i < 8; ++i)
+    {
+        std::uint64_t value = acc[i];
+        value ^= value >> 47;
+        value ^= read<std::uint64_t>(secret + 8 * i);
+        acc[i] = value * PRIME32_1;
+    }
+}
+
+#if defined(CCH_XXH3_SSE2)
+void cch::hash::XXH3::accumulateSSE2(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    __m128i a0 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(acc) + 0);
+    __m128i a1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(acc) + 1);
+    __m128i a2 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(acc) + 2);
+    __m128i a3 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(acc) + 3);
+
+    // The accumulators stay in registers for all the stripes
+    auto const step = [&input, &secret](__m128i &a, size_t i)
+    {
+        __m128i const dataValue = _mm_loadu_si128(reinterpret_cast<__m128i const *>(input) + i);
+        __m128i const dataKey = _mm_xor_si128(dataValue, _mm_loadu_si128(reinterpret_cast<__m128i const *>(secret) + i));
+        // 32x32->64 bit product of the low and high halves of every key
+        __m128i const product = _mm_mul_epu32(dataKey, _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+        // acc[i ^ 1] += data[i]
+        __m128i const swapped = _mm_shuffle_epi32(dataValue, _MM_SHUFFLE(1, 0, 3, 2));
+
+        a = _mm_add_epi64(a, _mm_add_epi64(product, swapped));
+    };
+
+    for (size_t s = 0; s < stripeCount; ++s, input += STRIPE_SIZE, secret += 8)
+    {
+        step(a0, 0);
+        step(a1, 1);
+        step(a2, 2);
+        step(a3, 3);
+    }
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(acc) + 0, a0);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(acc) + 1, a1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(acc) + 2, a2);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(acc) + 3, a3);
+}
+
+void cch::hash::XXH3::scrambleSSE2(std::uint64_t *acc, cch::byte const *secret)
+{
+    __m128i const prime = _mm_set1_epi32(static_cast<int>(PRIME32_1));
+
+    for (size_t i = 0; i < 4; ++i)
+    {
+        __m128i value = _mm_loadu_si128(reinterpret_cast<__m128i const *>(acc) + i);
+        value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+        value = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<__m128i const *>(secret) + i));
+
+        // 64x32 bit multiplication from two 32x32 bit products
+        __m128i const productLow = _mm_mul_epu32(value, prime);
+        __m128i const productHigh = _mm_mul_epu32(_mm_srli_epi64(value, 32), prime);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(acc) + i, _mm_add_epi64(productLow, _mm_slli_epi64(productHigh, 32)));
+    }
+}
+#else
+void cch::hash::XXH3::accumulateSSE2(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    accumulateScalar(acc, input, secret, stripeCount);
+}
+
+void cch::hash::XXH3::scrambleSSE2(std::uint64_t *acc, cch::byte const *secret)
+{
+    scrambleScalar(acc, secret);
+}
+#endif
+
+cch::hash::XXH3::Kernel const &cch::hash::XXH3::kernel()
+{
+    auto const *selected = selectedKernel.load(std::memory_order_relaxed);
+
+    if (selected == nullptr)
+    {
+        // Nothing has been hashed yet, pick the fastest backend
+        for (auto backend : {Backend::AVX512, Backend::AVX2, Backend::SSE2, Backend::Scalar})
+        {
+            if (setBackend(backend))
+            {
+                break;
+            }
+        }
+
+        selected = selectedKernel.load(std::memory_order_relaxed);
+    }
+
+    return *selected;
+}
+
+bool cch::hash::XXH3::isSupported(Backend backend)
+{
+    switch (backend)
+    {
+        case Backend::Scalar:
+            return true;
+    #if defined(CCH_ARCH_X86)
+        case Backend::SSE2:
+        #if defined(CCH_XXH3_SSE2)
+            return true;
+        #else
+            return false;
+        #endif
+        case Backend::AVX2:
+            return CpuFeatures::get().avx2;
+        case Backend::AVX512:
+            return CpuFeatures::get().avx512f;
+    #else
+        default:
+            return false;
+    #endif
+    }
+
+    return false;
+}
+
+bool cch::hash::XXH3::setBackend(Backend backend)
+{
+    if (!isSupported(backend))
+    {
+        return false;
+    }
+
+    selectedKernel.store(&KERNELS[static_cast<size_t>(backend)], std::memory_order_relaxed);
+    return true;
+}
+
+cch::hash::XXH3::Backend cch::hash::XXH3::getBackend()
+{
+    return kernel().backend;
+}
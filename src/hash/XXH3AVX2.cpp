@@ -0,0 +1,64 @@
+#include "utilities/CpuFeatures.h"
+#include "../include/hash/XXH3.h"
+
+// XXH3 kernels compiled with -mavx2, only called after a runtime cpuid check
+#if defined(CCH_ARCH_X86)
+#include <immintrin.h>
+#include <array>
+
+void cch::hash::XXH3::accumulateAVX2(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    __m256i a0 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(acc) + 0);
+    __m256i a1 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(acc) + 1);
+
+    // The accumulators stay in registers for all the stripes
+    auto const step = [&input, &secret](__m256i &a, size_t i)
+    {
+        __m256i const dataValue = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(input) + i);
+        __m256i const dataKey = _mm256_xor_si256(dataValue, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(secret) + i));
+        // 32x32->64 bit product of the low and high halves of every key
+        __m256i const product = _mm256_mul_epu32(dataKey, _mm256_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1)));
+        // acc[i ^ 1] += data[i]
+        __m256i const swapped = _mm256_shuffle_epi32(dataValue, _MM_SHUFFLE(1, 0, 3, 2));
+
+        a = _mm256_add_epi64(a, _mm256_add_epi64(product, swapped));
+    };
+
+    for (size_t s = 0; s < stripeCount; ++s, input += STRIPE_SIZE, secret += 8)
+    {
+        step(a0, 0);
+        step(a1, 1);
+    }
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc) + 0, a0);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc) + 1, a1);
+}
+
+void cch::hash::XXH3::scrambleAVX2(std::uint64_t *acc, cch::byte const *secret)
+{
+    __m256i const prime = _mm256_set1_epi32(static_cast<int>(0x9E3779B1));
+
+    for (size_t i = 0; i < 2; ++i)
+    {
+        __m256i value = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(acc) + i);
+        value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+        value = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<__m256i const *>(secret) + i));
+
+        // 64x32 bit multiplication from two 32x32 bit products
+        __m256i const productLow = _mm256_mul_epu32(value, prime);
+        __m256i const productHigh = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc) + i, _mm256_add_epi64(productLow, _mm256_slli_epi64(productHigh, 32)));
+    }
+}
+#else
+void cch::hash::XXH3::accumulateAVX2(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    accumulateScalar(acc, input, secret, stripeCount);
+}
+
+void cch::hash::XXH3::scrambleAVX2(std::uint64_t *acc, cch::byte const *secret)
+{
+    scrambleScalar(acc, secret);
+}
+#endif
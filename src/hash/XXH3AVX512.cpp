@@ -0,0 +1,52 @@
+#include "utilities/CpuFeatures.h"
+#include "../include/hash/XXH3.h"
+
+// XXH3 kernels compiled with -mavx512f, only called after a runtime cpuid check
+#if defined(CCH_ARCH_X86)
+#include <immintrin.h>
+
+void cch::hash::XXH3::accumulateAVX512(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    // A whole stripe fits into one register
+    __m512i a = _mm512_loadu_si512(acc);
+
+    for (size_t s = 0; s < stripeCount; ++s, input += STRIPE_SIZE, secret += 8)
+    {
+        __m512i const dataValue = _mm512_loadu_si512(input);
+        __m512i const dataKey = _mm512_xor_si512(dataValue, _mm512_loadu_si512(secret));
+        // 32x32->64 bit product of the low and high halves of every key
+        __m512i const product = _mm512_mul_epu32(dataKey, _mm512_shuffle_epi32(dataKey, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(0, 3, 0, 1))));
+        // acc[i ^ 1] += data[i]
+        __m512i const swapped = _mm512_shuffle_epi32(dataValue, static_cast<_MM_PERM_ENUM>(_MM_SHUFFLE(1, 0, 3, 2)));
+
+        a = _mm512_add_epi64(a, _mm512_add_epi64(product, swapped));
+    }
+
+    _mm512_storeu_si512(acc, a);
+}
+
+void cch::hash::XXH3::scrambleAVX512(std::uint64_t *acc, cch::byte const *secret)
+{
+    __m512i const prime = _mm512_set1_epi32(static_cast<int>(0x9E3779B1));
+    __m512i value = _mm512_loadu_si512(acc);
+
+    // value ^ (value >> 47) ^ secret in one instruction
+    value = _mm512_ternarylogic_epi32(value, _mm512_srli_epi64(value, 47), _mm512_loadu_si512(secret), 0x96);
+
+    // 64x32 bit multiplication from two 32x32 bit products
+    __m512i const productLow = _mm512_mul_epu32(value, prime);
+    __m512i const productHigh = _mm512_mul_epu32(_mm512_srli_epi64(value, 32), prime);
+
+    _mm512_storeu_si512(acc, _mm512_add_epi64(productLow, _mm512_slli_epi64(productHigh, 32)));
+}
+#else
+void cch::hash::XXH3::accumulateAVX512(std::uint64_t *acc, cch::byte const *input, cch::byte const *secret, size_t stripeCount)
+{
+    accumulateScalar(acc, input, secret, stripeCount);
+}
+
+void cch::hash::XXH3::scrambleAVX512(std::uint64_t *acc, cch::byte const *secret)
+{
+    scrambleScalar(acc, secret);
+}
+#endif
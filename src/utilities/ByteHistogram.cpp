@@ -0,0 +1,112 @@
+#include "utilities/ByteHistogram.h"
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <thread>
+#include <vector>
+
+cch::ByteHistogram::Counts cch::ByteHistogram::count(std::span<cch::byte const> data, size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    threadCount = std::max<size_t>(1, std::min(threadCount, data.size() / PARALLEL_MIN_SIZE));
+
+    Counts counts{};
+
+    if (threadCount == 1)
+    {
+        countRange(data, counts);
+        return counts;
+    }
+
+    // Every thread counts a contiguous part, the calling thread takes the first one
+    size_t const partSize = (data.size() + threadCount - 1) / threadCount;
+    std::vector<std::future<Counts>> workers;
+    workers.reserve(threadCount - 1);
+
+    for (size_t part = 1; part < threadCount; ++part)
+    {
+        auto const partData = data.subspan(part * partSize, std::min(partSize, data.size() - part * partSize));
+
+        workers.push_back(std::async(std::launch::async, [partData]()
+        {
+            Counts partCounts{};
+            countRange(partData, partCounts);
+            return partCounts;
+        }));
+    }
+
+    countRange(data.first(partSize), counts);
+
+    for (auto &w : workers)
+    {
+        auto const partCounts = w.get();
+
+        for (size_t byte = 0; byte < counts.size(); ++byte)
+        {
+            counts[byte] += partCounts[byte];
+        }
+    }
+
+    return counts;
+}
+
+void cch::ByteHistogram::countRange(std::span<cch::byte const> data, Counts &counts)
+{
+    std::uint32_t tables[TABLE_COUNT][256];
+
+    while (!data.empty())
+    {
+        auto const chunk = data.first(std::min(data.size(), FLUSH_SIZE));
+        data = data.subspan(chunk.size());
+
+        std::memset(tables, 0, sizeof(tables));
+
+        cch::byte const *ptr = chunk.data();
+        cch::byte const *const end = ptr + chunk.size();
+
+        // Two words per iteration, byte k of a word goes to table k
+        while (end - ptr >= 16)
+        {
+            std::uint64_t first;
+            std::uint64_t second;
+            std::memcpy(&first, ptr, sizeof(first));
+            std::memcpy(&second, ptr + 8, sizeof(second));
+            ptr += 16;
+
+            ++tables[0][first & 0xFF];
+            ++tables[1][(first >> 8) & 0xFF];
+            ++tables[2][(first >> 16) & 0xFF];
+            ++tables[3][(first >> 24) & 0xFF];
+            ++tables[4][(first >> 32) & 0xFF];
+            ++tables[5][(first >> 40) & 0xFF];
+            ++tables[6][(first >> 48) & 0xFF];
+            ++tables[7][first >> 56];
+
+            ++tables[0][second & 0xFF];
+            ++tables[1][(second >> 8) & 0xFF];
+            ++tables[2][(second >> 16) & 0xFF];
+            ++tables[3][(second >> 24) & 0xFF];
+            ++tables[4][(second >> 32) & 0xFF];
+            ++tables[5][(second >> 40) & 0xFF];
+            ++tables[6][(second >> 48) & 0xFF];
+            ++tables[7][second >> 56];
+        }
+
+        while (ptr != end)
+        {
+            ++tables[0][*ptr++];
+        }
+
+        for (size_t byte = 0; byte < counts.size(); ++byte)
+        {
+            for (size_t table = 0; table < TABLE_COUNT; ++table)
+            {
+                counts[byte] += tables[table][byte];
+            }
+        }
+    }
+}
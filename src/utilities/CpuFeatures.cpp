@@ -0,0 +1,100 @@
+#include "utilities/CpuFeatures.h"
+#include <cstdint>
+
+#if defined(CCH_ARCH_X86)
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+
+namespace
+{
+#if defined(CCH_ARCH_X86)
+    void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int (&regs)[4])
+    {
+    #if defined(_MSC_VER)
+        int r[4];
+        __cpuidex(r, static_cast<int>(leaf), static_cast<int>(subleaf));
+
+        for (size_t i = 0; i < 4; ++i)
+        {
+            regs[i] = static_cast<unsigned int>(r[i]);
+        }
+    #else
+        __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+    #endif
+    }
+
+    /// Read the XCR0 register to find out which register files the OS saves on context switch
+    std::uint64_t xgetbv()
+    {
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        unsigned int eax = 0;
+        unsigned int edx = 0;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+
+        return (static_cast<std::uint64_t>(edx) << 32) | eax;
+    #endif
+    }
+
+    cch::CpuFeatures detectFeatures()
+    {
+        cch::CpuFeatures features;
+        unsigned int regs[4] = {};
+
+        cpuid(0, 0, regs);
+        unsigned int const maxLeaf = regs[0];
+
+        if (maxLeaf < 1)
+        {
+            return features;
+        }
+
+        cpuid(1, 0, regs);
+        unsigned int const ecx1 = regs[2];
+
+        features.ssse3 = ecx1 & (1u << 9);
+        features.sse41 = ecx1 & (1u << 19);
+        features.sse42 = ecx1 & (1u << 20);
+        features.pclmul = ecx1 & (1u << 1);
+
+        bool const osxsave = ecx1 & (1u << 27);
+        std::uint64_t const xcr0 = osxsave ? xgetbv() : 0;
+        // XMM and YMM state
+        bool const avxEnabled = (xcr0 & 0x06) == 0x06;
+        // Opmask, upper halves of ZMM0-15 and ZMM16-31
+        bool const avx512Enabled = avxEnabled && (xcr0 & 0xE0) == 0xE0;
+
+        if (maxLeaf < 7)
+        {
+            return features;
+        }
+
+        cpuid(7, 0, regs);
+        unsigned int const ebx7 = regs[1];
+
+        features.avx2 = avxEnabled && (ebx7 & (1u << 5));
+        features.avx512f = avx512Enabled && (ebx7 & (1u << 16));
+        features.avx512bw = avx512Enabled && (ebx7 & (1u << 30));
+        features.avx512vl = avx512Enabled && (ebx7 & (1u << 31));
+        features.sha = ebx7 & (1u << 29);
+
+        return features;
+    }
+#else
+    cch::CpuFeatures detectFeatures()
+    {
+        return {};
+    }
+#endif
+}
+
+cch::CpuFeatures const& cch::CpuFeatures::get()
+{
+    static CpuFeatures const features = detectFeatures();
+    return features;
+}
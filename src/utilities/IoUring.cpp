@@ -0,0 +1,186 @@
+#include "IoUring.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace
+{
+    int setup(unsigned entries, io_uring_params &params)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    }
+
+    template <typename T>
+    T *at(void *base, std::uint32_t offset)
+    {
+        return reinterpret_cast<T *>(static_cast<char *>(base) + offset);
+    }
+}
+
+cch::detail::IoUring::IoUring(unsigned entries)
+{
+    io_uring_params params{};
+    ringFd = setup(entries, params);
+
+    if (ringFd < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "Cannot create an io_uring");
+    }
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // Since Linux 5.4 both rings live in a single mapping
+    bool const singleMapping = params.features & IORING_FEAT_SINGLE_MMAP;
+
+    if (singleMapping)
+    {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+    cqRing = singleMapping || sqRing == MAP_FAILED ? sqRing : mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+    sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    void *const sqeMapping = cqRing == MAP_FAILED ? MAP_FAILED : mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+
+    if (sqeMapping == MAP_FAILED)
+    {
+        int const error = errno;
+
+        if (cqRing != MAP_FAILED && cqRing != sqRing)
+        {
+            munmap(cqRing, cqRingSize);
+        }
+
+        if (sqRing != MAP_FAILED)
+        {
+            munmap(sqRing, sqRingSize);
+        }
+
+        close(ringFd);
+        throw std::system_error(error, std::generic_category(), "Cannot map the io_uring");
+    }
+
+    sqes = static_cast<io_uring_sqe *>(sqeMapping);
+
+    sqHead = at<unsigned>(sqRing, params.sq_off.head);
+    sqTail = at<unsigned>(sqRing, params.sq_off.tail);
+    sqMask = *at<unsigned>(sqRing, params.sq_off.ring_mask);
+    sqEntries = *at<unsigned>(sqRing, params.sq_off.ring_entries);
+    sqArray = at<unsigned>(sqRing, params.sq_off.array);
+
+    cqHead = at<unsigned>(cqRing, params.cq_off.head);
+    cqTail = at<unsigned>(cqRing, params.cq_off.tail);
+    cqMask = *at<unsigned>(cqRing, params.cq_off.ring_mask);
+    cqes = at<io_uring_cqe>(cqRing, params.cq_off.cqes);
+}
+
+cch::detail::IoUring::~IoUring()
+{
+    munmap(sqes, sqesSize);
+
+    if (cqRing != sqRing)
+    {
+        munmap(cqRing, cqRingSize);
+    }
+
+    munmap(sqRing, sqRingSize);
+    close(ringFd);
+}
+
+bool cch::detail::IoUring::isSupported()
+{
+    static bool const supported = []()
+    {
+        io_uring_params params{};
+        int const fd = setup(1, params);
+
+        if (fd < 0)
+        {
+            // ENOSYS on kernels before 5.1, EPERM if disabled by the administrator or a seccomp filter
+            return false;
+        }
+
+        close(fd);
+
+        // Reading at the current position came together with IORING_OP_READ
+        return (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+    }();
+
+    return supported;
+}
+
+bool cch::detail::IoUring::registerBuffers(std::span<iovec const> buffers)
+{
+    return syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_BUFFERS, buffers.data(), static_cast<unsigned>(buffers.size())) == 0;
+}
+
+bool cch::detail::IoUring::queueRead(int fd, void *buffer, unsigned length, std::uint64_t offset, int bufferIndex, std::uint64_t userData)
+{
+    // The kernel advances the head, only this thread the tail
+    unsigned const tail = *sqTail;
+
+    if (tail - std::atomic_ref(*sqHead).load(std::memory_order_acquire) == sqEntries)
+    {
+        return false;
+    }
+
+    unsigned const index = tail & sqMask;
+    io_uring_sqe &sqe = sqes[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = bufferIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer);
+    sqe.len = length;
+    sqe.off = offset;
+    sqe.buf_index = static_cast<std::uint16_t>(bufferIndex >= 0 ? bufferIndex : 0);
+    sqe.user_data = userData;
+    sqArray[index] = index;
+
+    std::atomic_ref(*sqTail).store(tail + 1, std::memory_order_release);
+    ++toSubmit;
+
+    return true;
+}
+
+void cch::detail::IoUring::submitAndWait(unsigned minComplete)
+{
+    while (true)
+    {
+        long const submitted = syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, minComplete != 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+
+        if (submitted >= 0)
+        {
+            toSubmit -= static_cast<unsigned>(submitted);
+            return;
+        }
+
+        if (errno != EINTR)
+        {
+            throw std::system_error(errno, std::generic_category(), "io_uring_enter failed");
+        }
+    }
+}
+
+bool cch::detail::IoUring::popCompletion(Completion &completion)
+{
+    // The kernel advances the tail, only this thread the head
+    unsigned const head = *cqHead;
+
+    if (head == std::atomic_ref(*cqTail).load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    io_uring_cqe const &cqe = cqes[head & cqMask];
+    completion = {cqe.user_data, cqe.res};
+    std::atomic_ref(*cqHead).store(head + 1, std::memory_order_release);
+
+    return true;
+}
+
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstdint>
+#include <span>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+namespace cch::detail
+{
+    /// Minimal io_uring submission/completion ring on top of the raw system calls, so no liburing is needed
+    /// Only compiled when CMake finds linux/io_uring.h (CCH_HAS_IO_URING). Only the calling thread may use a ring
+    class IoUring
+    {
+    public:
+        struct Completion
+        {
+            std::uint64_t userData;
+            /// Bytes transferred or a negated errno
+            std::int32_t result;
+        };
+
+        /// Create a ring
+        /// \param entries minimal number of submission queue entries
+        /// \throw std::system_error if the kernel refuses to create the ring
+        explicit IoUring(unsigned entries);
+
+        IoUring(IoUring const &) = delete;
+        IoUring &operator=(IoUring const &) = delete;
+        ~IoUring();
+
+        /// \return true if the kernel supports the rings and the plain read operation (Linux 5.6+)
+        static bool isSupported();
+
+        /// Register buffers for the fixed reads, pinning them in memory
+        /// \param buffers buffers to register, referenced by their index afterwards
+        /// \return false if the kernel refused, e.g. because of the locked memory limit
+        bool registerBuffers(std::span<iovec const> buffers);
+
+        /// Queue a read, it is passed to the kernel by the next submitAndWait()
+        /// \param fd file to read
+        /// \param buffer destination
+        /// \param length number of bytes to read
+        /// \param offset position in the file
+        /// \param bufferIndex index of the registered buffer containing the destination, -1 if the buffers are not registered
+        /// \param userData value returned with the completion
+        /// \return false if the submission queue is full
+        bool queueRead(int fd, void *buffer, unsigned length, std::uint64_t offset, int bufferIndex, std::uint64_t userData);
+
+        /// Submit the queued operations and wait for completions
+        /// \param minComplete number of completions to wait for
+        /// \throw std::system_error if the kernel rejects the submission
+        void submitAndWait(unsigned minComplete);
+
+        /// Take the next completion
+        /// \param completion receives the completion
+        /// \return false if there are no completions
+        bool popCompletion(Completion &completion);
+
+    private:
+        int ringFd = -1;
+        unsigned toSubmit = 0;
+
+        void *sqRing = nullptr;
+        size_t sqRingSize = 0;
+        void *cqRing = nullptr;
+        size_t cqRingSize = 0;
+        io_uring_sqe *sqes = nullptr;
+        size_t sqesSize = 0;
+
+        unsigned *sqHead = nullptr;
+        unsigned *sqTail = nullptr;
+        unsigned sqMask = 0;
+        unsigned sqEntries = 0;
+        unsigned *sqArray = nullptr;
+
+        unsigned *cqHead = nullptr;
+        unsigned *cqTail = nullptr;
+        unsigned cqMask = 0;
+        io_uring_cqe *cqes = nullptr;
+    };
+}
@@ -0,0 +1,146 @@
+#include "utilities/MappedFile.h"
+#include <stdexcept>
+#include <utility>
+
+#if defined(_WIN32)
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+cch::MappedFile::MappedFile(std::filesystem::path const &path)
+{
+    HANDLE const file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot get the size of " + path.string());
+    }
+
+    length = static_cast<size_t>(fileSize.QuadPart);
+
+    // Empty files cannot be mapped, they are represented by an empty span
+    if (length > 0)
+    {
+        mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        address = mapping ? static_cast<cch::byte const *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    }
+
+    CloseHandle(file);
+
+    if (length > 0 && address == nullptr)
+    {
+        unmap();
+        throw std::runtime_error("Cannot map " + path.string());
+    }
+}
+
+void cch::MappedFile::unmap() noexcept
+{
+    if (address != nullptr)
+    {
+        UnmapViewOfFile(address);
+    }
+
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+
+    address = nullptr;
+    mapping = nullptr;
+    length = 0;
+}
+#else
+cch::MappedFile::MappedFile(std::filesystem::path const &path)
+{
+    int const fd = open(path.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+
+    struct stat status;
+
+    if (fstat(fd, &status) != 0)
+    {
+        close(fd);
+        throw std::runtime_error("Cannot get the size of " + path.string());
+    }
+
+    length = static_cast<size_t>(status.st_size);
+
+    // Empty files cannot be mapped, they are represented by an empty span
+    if (length > 0)
+    {
+        void *const mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (mapped == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error("Cannot map " + path.string());
+        }
+
+        // Readers go through the file front to back, let the OS read ahead aggressively
+        madvise(mapped, length, MADV_SEQUENTIAL);
+        address = static_cast<cch::byte const *>(mapped);
+    }
+
+    // The mapping keeps its own reference to the file
+    close(fd);
+}
+
+void cch::MappedFile::unmap() noexcept
+{
+    if (address != nullptr)
+    {
+        munmap(const_cast<cch::byte *>(address), length);
+    }
+
+    address = nullptr;
+    length = 0;
+}
+#endif
+
+cch::MappedFile::MappedFile(MappedFile &&other) noexcept :
+    address(std::exchange(other.address, nullptr)), length(std::exchange(other.length, 0))
+#if defined(_WIN32)
+    , mapping(std::exchange(other.mapping, nullptr))
+#endif
+{
+}
+
+cch::MappedFile &cch::MappedFile::operator=(MappedFile &&other) noexcept
+{
+    if (this != &other)
+    {
+        unmap();
+        address = std::exchange(other.address, nullptr);
+        length = std::exchange(other.length, 0);
+    #if defined(_WIN32)
+        mapping = std::exchange(other.mapping, nullptr);
+    #endif
+    }
+
+    return *this;
+}
+
+cch::MappedFile::~MappedFile()
+{
+    unmap();
+}